@@ -1,8 +1,118 @@
 #include "windowbuilder.h"
 #include "windowbuilder_imgui.h"
 #include <iostream>
+#include <chrono>
+#include <string>
+#include <cstdio>
+
+static std::chrono::steady_clock::time_point launchTime;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Result of one way of finding a target among candidates and showing an overlay on it
+struct AttachRun {
+	const char* process = nullptr;
+	double missedMs = 0.0;     // Spent on candidates that were not running, including cleanup
+	double firstFrameMs = 0.0; // From the start of the search to the first rendered frame
+};
+
+static std::chrono::steady_clock::time_point searchStart;
+static double firstFrameMs = 0.0;
+
+// Records when the first frame is rendered and leaves the message loop
+static void RenderOneFrame(Window&) {
+	firstFrameMs = MillisecondsSince(searchStart);
+	PostQuitMessage(0);
+}
+
+// The way overlays attached before Probe(): a full Build() per candidate, creating the window,
+// device, swap chain and plugins, then checking whether it ended up attached
+static AttachRun AttachByBuilding(const char* const* processes, size_t count) {
+	AttachRun run;
+	searchStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count && !run.process; ++i) {
+		auto candidateStart = std::chrono::steady_clock::now();
+		{
+			auto window = WindowBuilder()
+				.Name("Attach Benchmark", "AttachBenchmarkClass")
+				.Plugin<WindowBuilderImGui>()
+				.AttachToProcessName(processes[i], false, true)
+				.OnRender(RenderOneFrame)
+				.Build();
+			if (window && window->IsOverlay() && window->GetTargetWindow()) {
+				run.process = processes[i];
+				window->Show();
+				run.firstFrameMs = firstFrameMs;
+				break;
+			}
+		}
+		run.missedMs += MillisecondsSince(candidateStart);
+	}
+	return run;
+}
+
+// Probe() per candidate, then TryAttach() with the device created by the first Show()
+static AttachRun AttachByProbing(const char* const* processes, size_t count) {
+	AttachRun run;
+	searchStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count && !run.process; ++i) {
+		auto candidateStart = std::chrono::steady_clock::now();
+		if (WindowBuilder().AttachToProcessName(processes[i]).Probe()) {
+			auto window = WindowBuilder()
+				.Name("Attach Benchmark", "AttachBenchmarkClass")
+				.Plugin<WindowBuilderImGui>()
+				.AttachToProcessName(processes[i], false, true)
+				.OnRender(RenderOneFrame)
+				.DeferGraphics()
+				.TryAttach();
+			if (window) {
+				run.process = processes[i];
+				window->Show();
+				run.firstFrameMs = firstFrameMs;
+				break;
+			}
+		}
+		run.missedMs += MillisecondsSince(candidateStart);
+	}
+	return run;
+}
+
+// Runs both ways over the same candidates and prints them side by side. Each attaches, renders
+// one frame and closes, so an overlay flashes up when a target is running. Both run once before
+// the measured round, so neither pays for loading the D3D11 and DXGI DLLs.
+static void CompareAttachPaths(const char* const* processes, size_t count) {
+	AttachByBuilding(processes, count);
+	AttachByProbing(processes, count);
+	AttachRun built = AttachByBuilding(processes, count);
+	AttachRun probed = AttachByProbing(processes, count);
+
+	auto ms = [](double value) {
+		char text[32];
+		snprintf(text, sizeof(text), "%.1f ms", value);
+		return std::string(text);
+	};
+	auto firstFrame = [&ms](const AttachRun& run) {
+		return run.process ? ms(run.firstFrameMs) : std::string("no target");
+	};
+	char line[160];
+	std::cout << "Attach comparison over " << count << " candidates\n";
+	snprintf(line, sizeof(line), "  %-22s %-24s %s\n", "", "Build() per candidate", "Probe() + TryAttach()");
+	std::cout << line;
+	snprintf(line, sizeof(line), "  %-22s %-24s %s\n", "missed candidates", ms(built.missedMs).c_str(), ms(probed.missedMs).c_str());
+	std::cout << line;
+	snprintf(line, sizeof(line), "  %-22s %-24s %s\n\n", "time to first frame", firstFrame(built).c_str(), firstFrame(probed).c_str());
+	std::cout << line;
+}
 
 static void RenderAdvancedOverlay(Window& window) {
+	static bool firstFrame = true;
+	if (firstFrame) {
+		std::cout << "Time to first frame: " << MillisecondsSince(launchTime) << " ms\n";
+		firstFrame = false;
+	}
+
 	// Create a comprehensive overlay UI
 	ImGui::Begin("WindowBuilder Overlay", nullptr, 
 		ImGuiWindowFlags_NoCollapse | 
@@ -54,28 +164,36 @@ int main() {
 		"calculator.exe",
 		"cmd.exe"
 	};
+	const size_t targetCount = sizeof(targetProcesses) / sizeof(targetProcesses[0]);
+
+	CompareAttachPaths(targetProcesses, targetCount);
 	
 	std::unique_ptr<Window> overlayWindow = nullptr;
 	const char* attachedProcess = nullptr;
+	launchTime = std::chrono::steady_clock::now();
 	
-	// Try to find a target process
+	// Probe for a target process: only resolves the target, no window or device is created
 	for (const char* processName : targetProcesses) {
-		std::cout << "Attempting to attach to " << processName << "... ";
+		std::cout << "Probing " << processName << "... ";
+		auto probeStart = std::chrono::steady_clock::now();
+		HWND target = WindowBuilder()
+			.AttachToProcessName(processName)
+			.Probe();
+		std::cout << (target ? "found" : "not found") << " (" << MillisecondsSince(probeStart) << " ms)\n";
 		
-		auto testWindow = WindowBuilder()
-			.Name("Test Overlay", "TestOverlayClass")
-			.Plugin<WindowBuilderImGui>()
-			.AttachToProcessName(processName, false, true)
-			.OnRender(RenderAdvancedOverlay)
-			.Build();
-			
-		if (testWindow && testWindow->IsOverlay() && testWindow->GetTargetWindow()) {
-			overlayWindow = std::move(testWindow);
+		if (target) {
+			// Fails instead of falling back to a plain window if the target went away meanwhile
+			overlayWindow = WindowBuilder()
+				.Name("Test Overlay", "TestOverlayClass")
+				.Plugin<WindowBuilderImGui>()
+				.AttachToProcessName(processName, false, true)
+				.OnRender(RenderAdvancedOverlay)
+				.DeferGraphics()
+				.TryAttach();
+		}
+		if (overlayWindow) {
 			attachedProcess = processName;
-			std::cout << "SUCCESS!\n";
 			break;
-		} else {
-			std::cout << "not found.\n";
 		}
 	}
 	
@@ -96,6 +214,7 @@ int main() {
 			.Plugin<WindowBuilderImGui>()
 			.AttachToWindow(desktop, false, true)
 			.OnRender(RenderAdvancedOverlay)
+			.DeferGraphics()
 			.Build();
 			
 		if (fallbackWindow) {
@@ -0,0 +1,44 @@
+#include "windowbuilder_framering.h"
+#include <iostream>
+#include <thread>
+
+// Reference consumer for WindowBuilder::PublishFrames. Runs as a separate process and only
+// touches the tiles that changed, which is where a recorder or encoder would do its work.
+
+int main(int argc, char** argv) {
+	const char* name = argc > 1 ? argv[1] : "WindowBuilderFrames";
+
+	WBFrameRingConsumer consumer;
+	while (!consumer.Open(name)) {
+		std::cout << "Waiting for frame ring " << name << "...\n";
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	const uint32_t totalTiles = consumer.GetTilesX() * consumer.GetTilesY();
+	uint64_t frames = 0, tiles = 0, skipped = 0, overruns = 0;
+	auto reportTime = std::chrono::steady_clock::now();
+
+	WBConsumedFrame frame;
+	for (;;) {
+		if (!consumer.Poll(frame)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// consumer.GetPixels() now holds the full frame; frame.dirty says which tiles to encode
+		++frames;
+		tiles += frame.dirtyTiles;
+		skipped += frame.skipped;
+		overruns += frame.overrun ? 1 : 0;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - reportTime >= std::chrono::seconds(1)) {
+			std::cout << frames << " frames/s, "
+				<< (frames ? 100.0 * tiles / (double(frames) * totalTiles) : 0.0) << "% tiles dirty, "
+				<< skipped << " skipped, " << overruns << " overruns, "
+				<< frame.width << "x" << frame.height << std::endl;
+			frames = tiles = skipped = overruns = 0;
+			reportTime = now;
+		}
+	}
+}
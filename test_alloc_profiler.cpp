@@ -0,0 +1,157 @@
+#define WB_ALLOC_PROFILER_IMPLEMENTATION
+#include "windowbuilder_allocprof.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs a simulated frame loop under the allocation profiler: phase and plugin attribution,
+// per-frame counts, peak live bytes, call sites, and the steady-state assertion mode.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static WBAllocProfiler& profiler = WBAllocProfiler::Instance();
+
+static const WBAllocPhaseStats& Phase(const WBAllocReport& report, WBAllocPhase phase) {
+	return report.phases[static_cast<size_t>(phase)];
+}
+
+// Kept out of line so it shows up as its own call site
+WB_NOINLINE static std::unique_ptr<char[]> AllocateInRender(size_t bytes) {
+	return std::unique_ptr<char[]>(new char[bytes]);
+}
+
+static void TestAttribution() {
+	WBAllocReport before = profiler.GetReport();
+	CHECK(before.hooked);
+
+	{
+		WB_ALLOC_PHASE(WBAllocPhase::Render);
+		for (int i = 0; i < 10; ++i)
+			AllocateInRender(100);
+		{
+			WB_ALLOC_PHASE(WBAllocPhase::PreRender, "Minimap");
+			std::vector<int> scratch(256);
+		}
+		// The previous tag is restored when a scope ends
+		CHECK(WBCurrentAllocTag().phase == WBAllocPhase::Render && WBCurrentAllocTag().plugin == nullptr);
+	}
+	CHECK(WBCurrentAllocTag().phase == WBAllocPhase::Other);
+
+	// Other threads carry their own tag
+	std::thread worker([] {
+		WB_ALLOC_PHASE(WBAllocPhase::Update);
+		static int* volatile sink; // Keeps the compiler from eliding the pair
+		sink = new int[8];
+		delete[] sink;
+	});
+	worker.join();
+
+	WBAllocReport after = profiler.GetReport();
+	const WBAllocPhaseStats& render = Phase(after, WBAllocPhase::Render);
+	CHECK(render.allocations - Phase(before, WBAllocPhase::Render).allocations == 10);
+	CHECK(render.bytes - Phase(before, WBAllocPhase::Render).bytes == 1000);
+	CHECK(render.frees - Phase(before, WBAllocPhase::Render).frees == 10);
+	CHECK(Phase(after, WBAllocPhase::PreRender).bytes - Phase(before, WBAllocPhase::PreRender).bytes == 256 * sizeof(int));
+	CHECK(Phase(after, WBAllocPhase::Update).allocations - Phase(before, WBAllocPhase::Update).allocations == 1);
+
+	bool minimap = false;
+	for (const WBAllocPluginStats& plugin : after.plugins)
+		minimap |= std::string(plugin.plugin) == "Minimap" && plugin.bytes == 256 * sizeof(int);
+	CHECK(minimap);
+
+	// All ten render allocations come from one call site
+	const std::vector<WBAllocSite>& sites = after.topSites[static_cast<size_t>(WBAllocPhase::Render)];
+	CHECK(!sites.empty() && sites[0].allocations >= 10 && sites[0].bytes >= 1000 && sites[0].phase == WBAllocPhase::Render);
+}
+
+static void TestLiveAndPeak() {
+	WBAllocReport before = profiler.GetReport();
+	{
+		std::vector<std::unique_ptr<char[]>> blocks;
+		for (int i = 0; i < 8; ++i)
+			blocks.emplace_back(new char[1 << 20]);
+		CHECK(profiler.GetReport().liveBytes - before.liveBytes >= 8 << 20);
+	}
+	WBAllocReport after = profiler.GetReport();
+	CHECK(after.liveBytes == before.liveBytes);
+	CHECK(after.peakLiveBytes >= before.liveBytes + (8 << 20));
+
+	// Aligned allocations are tracked and honour their alignment
+	struct alignas(64) Line { char bytes[64]; };
+	std::unique_ptr<Line> line(new Line());
+	CHECK(reinterpret_cast<uintptr_t>(line.get()) % 64 == 0);
+	CHECK(profiler.GetReport().liveBytes - after.liveBytes == static_cast<int64_t>(sizeof(Line)));
+}
+
+static uint64_t handled = 0;
+static WBAllocPhase handledPhase = WBAllocPhase::Other;
+
+// A frame loop that reuses its buffers allocates only while warming up
+static void RunFrames(int frames, bool leakyRender) {
+	static std::vector<float> vertices;
+	for (int frame = 0; frame < frames; ++frame) {
+		profiler.BeginFrame();
+		{
+			WB_ALLOC_PHASE(WBAllocPhase::PreRender, "Batch");
+			vertices.clear();
+			for (int i = 0; i < 1000; ++i)
+				vertices.push_back(float(i));
+		}
+		{
+			WB_ALLOC_PHASE(WBAllocPhase::Render);
+			if (leakyRender && frame == frames - 1) {
+				std::string label = "this string is too long for the small string buffer";
+				(void)label;
+			}
+		}
+	}
+}
+
+static void TestSteadyState() {
+	uint64_t violations = profiler.GetReport().violations;
+	profiler.ExpectNoAllocationsAfter(profiler.GetReport().frames + 2, [](const WBAllocViolation& violation) {
+		++handled;
+		handledPhase = violation.phase;
+	});
+
+	RunFrames(50, false);
+	WBAllocReport steady = profiler.GetReport();
+	CHECK(steady.violations == violations);
+	CHECK(steady.lastFrameAllocations == 0);
+
+	RunFrames(5, true);
+	WBAllocReport leaky = profiler.GetReport();
+	CHECK(leaky.violations == violations + 1);
+	CHECK(handled == 1 && handledPhase == WBAllocPhase::Render);
+	profiler.BeginFrame();
+	CHECK(profiler.GetReport().lastFrameAllocations == 1);
+
+	// Untagged threads may allocate, a no-allocation scope may not
+	delete new int(1);
+	CHECK(profiler.GetReport().violations == violations + 1);
+	{
+		WBNoAllocScope noAlloc;
+		delete new int(2);
+	}
+	CHECK(profiler.GetReport().violations == violations + 2);
+	profiler.ExpectNoAllocationsAfter(0);
+}
+
+int main(void) {
+	TestAttribution();
+	TestLiveAndPeak();
+	TestSteadyState();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		WBPrintAllocReport(profiler.GetReport(), std::cerr);
+		return 1;
+	}
+	std::cout << "All allocation profiler tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include "windowbuilder_batch2d.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
+
+// Records primitives into a WBBatcher2D and checks the batches Build() produces: layer order,
+// first-use order of textures inside a layer, submission order inside a group, the single group
+// fast path and the counting scatter with many interleaved groups. Ends with a primitives/ms
+// benchmark of recording plus building.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static void* Texture(uintptr_t id) {
+	return reinterpret_cast<void*>(id);
+}
+
+// Images carry their submission index in the color, so instance order can be checked after the sort
+static void Tagged(WBBatcher2D& batcher, void* texture, uint32_t tag) {
+	batcher.Image(texture, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, tag);
+}
+
+// Every batch holds one group in submission order, and batches are in layer order
+static bool Consistent(const WBBatcher2D& batcher) {
+	const auto& batches = batcher.GetBatches();
+	const auto& instances = batcher.GetInstances();
+	uint32_t expectedFirst = 0;
+	for (size_t i = 0; i < batches.size(); ++i) {
+		if (batches[i].firstInstance != expectedFirst || batches[i].instanceCount == 0)
+			return false;
+		if (i > 0 && batches[i].layer < batches[i - 1].layer)
+			return false;
+		for (uint32_t j = 1; j < batches[i].instanceCount; ++j)
+			if (instances[batches[i].firstInstance + j].color <= instances[batches[i].firstInstance + j - 1].color)
+				return false;
+		expectedFirst += batches[i].instanceCount;
+	}
+	return expectedFirst == instances.size();
+}
+
+static void TestLayerOrder() {
+	WBBatcher2D batcher;
+	uint32_t tag = 0;
+	batcher.SetLayer(2);
+	Tagged(batcher, nullptr, tag++);
+	batcher.SetLayer(0);
+	Tagged(batcher, nullptr, tag++);
+	batcher.SetLayer(1);
+	Tagged(batcher, nullptr, tag++);
+	batcher.SetLayer(-5);
+	Tagged(batcher, nullptr, tag++);
+	batcher.Build();
+
+	const auto& batches = batcher.GetBatches();
+	CHECK(batches.size() == 4);
+	if (batches.size() == 4) {
+		CHECK(batches[0].layer == -5 && batches[1].layer == 0 && batches[2].layer == 1 && batches[3].layer == 2);
+		const auto& instances = batcher.GetInstances();
+		CHECK(instances[0].color == 3 && instances[1].color == 1 && instances[2].color == 2 && instances[3].color == 0);
+	}
+	CHECK(Consistent(batcher));
+}
+
+static void TestFirstUseOrderAndStability() {
+	// Within a layer, textures keep the order they were first used in, whatever their pointer values
+	WBBatcher2D batcher;
+	uint32_t tag = 0;
+	for (int round = 0; round < 5; ++round) {
+		Tagged(batcher, Texture(30), tag++);
+		Tagged(batcher, Texture(10), tag++);
+		Tagged(batcher, Texture(10), tag++);
+		Tagged(batcher, Texture(20), tag++);
+	}
+	batcher.SetLayer(1);
+	Tagged(batcher, Texture(10), tag++);
+	batcher.SetLayer(0);
+	Tagged(batcher, Texture(30), tag++); // Back to an existing group after a layer change
+	batcher.Build();
+
+	const auto& batches = batcher.GetBatches();
+	CHECK(batches.size() == 4);
+	if (batches.size() == 4) {
+		CHECK(batches[0].texture == Texture(30) && batches[0].instanceCount == 6 && batches[0].layer == 0);
+		CHECK(batches[1].texture == Texture(10) && batches[1].instanceCount == 10);
+		CHECK(batches[2].texture == Texture(20) && batches[2].instanceCount == 5);
+		CHECK(batches[3].texture == Texture(10) && batches[3].layer == 1 && batches[3].instanceCount == 1);
+		CHECK(batcher.GetInstances()[5].color == 21); // The late one goes last in its group
+	}
+	CHECK(Consistent(batcher));
+	CHECK(batcher.GetPrimitiveCount() == 22);
+}
+
+static void TestSingleGroup() {
+	WBBatcher2D batcher;
+	batcher.Rect(5.0f, 6.0f, 1.0f, 2.0f, 7); // Corners are normalized
+	batcher.Line(0.0f, 0.0f, 4.0f, 4.0f, 8, 2.0f);
+	batcher.Circle(1.0f, 1.0f, 3.0f, 9);
+	const float points[] = { 0, 0, 1, 0, 1, 1 };
+	batcher.Polyline(points, 3, 10, 1.0f, true);
+	batcher.Build();
+
+	CHECK(batcher.GetBatches().size() == 1);
+	CHECK(batcher.GetBatches()[0].instanceCount == 6 && batcher.GetBatches()[0].texture == nullptr);
+	const auto& instances = batcher.GetInstances();
+	CHECK(instances.size() == 6);
+	if (instances.size() == 6) {
+		CHECK(instances[0].kind == WBPrim2D::Rect && instances[0].a[0] == 1.0f && instances[0].b[1] == 6.0f);
+		CHECK(instances[1].kind == WBPrim2D::Line && instances[2].kind == WBPrim2D::Circle);
+		CHECK(instances[5].a[0] == 1.0f && instances[5].a[1] == 1.0f && instances[5].b[0] == 0.0f); // Closing segment
+	}
+
+	// Clear drops everything, including the layer
+	batcher.SetLayer(3);
+	batcher.Clear();
+	CHECK(batcher.GetLayer() == 0 && batcher.GetPrimitiveCount() == 0);
+	batcher.Build();
+	CHECK(batcher.GetBatches().empty() && batcher.GetInstances().empty());
+}
+
+static void TestScatter() {
+	// Many interleaved groups: every instance lands in its group, in submission order
+	WBBatcher2D batcher;
+	std::mt19937 rng(5);
+	std::vector<uint32_t> perGroup(4 * 300, 0);
+	for (uint32_t tag = 0; tag < 200000; ++tag) {
+		int layer = static_cast<int>(rng() % 4);
+		uintptr_t texture = rng() % 300;
+		batcher.SetLayer(layer);
+		Tagged(batcher, Texture(texture + 1), tag);
+		++perGroup[layer * 300 + texture];
+	}
+	batcher.Build();
+	CHECK(Consistent(batcher));
+	CHECK(batcher.GetBatches().size() == 1200);
+	for (const WBBatch2D& batch : batcher.GetBatches())
+		CHECK(batch.instanceCount == perGroup[batch.layer * 300 + reinterpret_cast<uintptr_t>(batch.texture) - 1]);
+
+	// Building again after Clear reuses the buffers and gives the same result
+	std::vector<WBInstance2D> first = batcher.GetInstances();
+	batcher.Clear();
+	rng.seed(5);
+	for (uint32_t tag = 0; tag < 200000; ++tag) {
+		batcher.SetLayer(static_cast<int>(rng() % 4));
+		Tagged(batcher, Texture(rng() % 300 + 1), tag);
+	}
+	batcher.Build();
+	CHECK(batcher.GetInstances().size() == first.size()
+		&& memcmp(batcher.GetInstances().data(), first.data(), first.size() * sizeof(WBInstance2D)) == 0);
+}
+
+// Records and builds a frame of primitives, returning primitives per millisecond over the best of several frames
+template<typename Record>
+static double Measure(size_t primitives, Record record) {
+	WBBatcher2D batcher;
+	double best = 1e9;
+	for (int frame = 0; frame < 10; ++frame) {
+		auto start = std::chrono::steady_clock::now();
+		batcher.Clear();
+		record(batcher);
+		batcher.Build();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return primitives / best;
+}
+
+static void Benchmark() {
+	const size_t primitives = 1000000;
+	double single = Measure(primitives, [&](WBBatcher2D& batcher) {
+		for (size_t i = 0; i < primitives; ++i)
+			batcher.Rect(float(i % 1920), float(i % 1080), float(i % 1920 + 8), float(i % 1080 + 8), 0xFF00FF00u);
+	});
+
+	// Icons from 8 textures, every fifth one on a second layer, so the group changes every primitive or two
+	double mixed = Measure(primitives, [&](WBBatcher2D& batcher) {
+		for (size_t i = 0; i < primitives; ++i) {
+			batcher.SetLayer(i % 5 == 0);
+			batcher.Image(Texture(1 + (i / 4) % 8), float(i % 1920), float(i % 1080), float(i % 1920 + 16), float(i % 1080 + 16));
+		}
+	});
+	std::cout << "record + build: " << single << " primitives/ms in one group, "
+		<< mixed << " primitives/ms across 16 interleaved groups" << std::endl;
+}
+
+int main(void) {
+	TestLayerOrder();
+	TestFirstUseOrderAndStability();
+	TestSingleGroup();
+	TestScatter();
+	Benchmark();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All 2D batching tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include "windowbuilder_dynres.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+
+// Runs the dynamic resolution controller against frame time traces. A trace holds what each frame
+// would cost at full resolution; the simulated GPU time of a frame is a fixed part plus that cost
+// times the square of the scale the controller picked, with seeded noise, so runs are reproducible.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+struct Run {
+	std::vector<float> scales;      // Scale each frame was rendered at
+	std::vector<double> frameMs;
+	WBDynamicResolutionStats stats;
+
+	size_t Changes() const {
+		size_t changes = 0;
+		for (size_t i = 1; i < scales.size(); ++i)
+			changes += scales[i] != scales[i - 1];
+		return changes;
+	}
+
+	// Fraction of frames in [begin, end) over the budget
+	double OverBudget(size_t begin, size_t end, double budgetMs) const {
+		size_t over = 0;
+		for (size_t i = begin; i < end; ++i)
+			over += frameMs[i] > budgetMs;
+		return static_cast<double>(over) / static_cast<double>(end - begin);
+	}
+};
+
+static Run Simulate(const std::vector<double>& fullCostMs, const WBDynamicResolutionConfig& config,
+	double fixedMs = 1.0, double noise = 0.05, unsigned seed = 1) {
+	WBDynamicResolution controller(config);
+	std::mt19937 rng(seed);
+	std::normal_distribution<double> jitter(1.0, noise);
+	Run run;
+	float scale = controller.GetScale();
+	for (double cost : fullCostMs) {
+		double ms = (fixedMs + cost * scale * scale) * std::max(0.5, jitter(rng));
+		run.scales.push_back(scale);
+		run.frameMs.push_back(ms);
+		scale = controller.Update(ms);
+	}
+	run.stats = controller.GetStats();
+	return run;
+}
+
+static std::vector<double> Constant(size_t frames, double ms) {
+	return std::vector<double>(frames, ms);
+}
+
+static void Append(std::vector<double>& trace, const std::vector<double>& part) {
+	trace.insert(trace.end(), part.begin(), part.end());
+}
+
+static void TestLightLoadStaysAtFullResolution() {
+	WBDynamicResolutionConfig config;
+	Run run = Simulate(Constant(3000, 9.0), config);
+	CHECK(run.Changes() == 0 && run.scales.back() == 1.0f);
+	CHECK(run.stats.lowered == 0 && run.stats.raised == 0);
+}
+
+static void TestHeavyLoadConvergesAndHolds() {
+	// 4K overlay on an integrated GPU: 30 ms at full resolution against a 14 ms budget
+	WBDynamicResolutionConfig config;
+	Run run = Simulate(Constant(3000, 30.0), config);
+	CHECK(run.scales.back() < 0.75f && run.scales.back() >= config.minScale);
+
+	// Settles within a few windows and then stays put
+	size_t settled = 0;
+	for (size_t i = 1; i < run.scales.size(); ++i)
+		if (run.scales[i] != run.scales[i - 1])
+			settled = i;
+	CHECK(settled <= static_cast<size_t>(config.windowFrames) * 4);
+	CHECK(run.Changes() <= 3);
+	CHECK(run.OverBudget(settled, run.frameMs.size(), config.budgetMs) < 0.02);
+
+	// Every scale is a multiple of the step
+	for (float scale : run.scales) {
+		float steps = scale / config.step;
+		CHECK(std::abs(steps - std::round(steps)) < 1e-4f);
+	}
+}
+
+static void TestSpikesAreIgnored() {
+	// A fine load with a long frame every 40 frames (shader compile, texture upload)
+	std::vector<double> trace = Constant(4000, 8.0);
+	for (size_t i = 0; i < trace.size(); i += 40)
+		trace[i] = 40.0;
+	Run run = Simulate(trace, WBDynamicResolutionConfig());
+	CHECK(run.Changes() == 0 && run.scales.back() == 1.0f);
+}
+
+static void TestRecoversWhenLoadDrops() {
+	WBDynamicResolutionConfig config;
+	std::vector<double> trace;
+	Append(trace, Constant(600, 8.0));
+	Append(trace, Constant(1200, 28.0)); // Heavy scene
+	Append(trace, Constant(2000, 6.0));  // Back to light
+	Run run = Simulate(trace, config);
+	CHECK(run.scales[599] == 1.0f);
+	CHECK(run.scales[1799] < 0.8f);
+	CHECK(run.scales.back() == 1.0f);
+	CHECK(run.stats.lowered >= 1 && run.stats.raised >= 1);
+
+	// Reacts to the heavy scene within two windows
+	size_t firstDrop = 600;
+	while (firstDrop < run.scales.size() && run.scales[firstDrop] == 1.0f)
+		++firstDrop;
+	CHECK(firstDrop <= 600 + 2 * static_cast<size_t>(config.windowFrames));
+}
+
+static void TestHysteresisAtTheEdge() {
+	// Full resolution lands right at the budget, with 15% noise: without hysteresis this flips every window
+	WBDynamicResolutionConfig config;
+	Run run = Simulate(Constant(6000, config.budgetMs - 1.0), config, 1.0, 0.15, 7);
+	CHECK(run.Changes() <= 4);
+	std::cout << "edge trace: " << run.Changes() << " scale changes in 6000 frames, final scale " << run.scales.back() << std::endl;
+}
+
+static void TestSlowRampAndLimits() {
+	// Load growing steadily past what the minimum scale can absorb
+	WBDynamicResolutionConfig config;
+	config.minScale = 0.6f;
+	std::vector<double> trace;
+	for (int i = 0; i < 3000; ++i)
+		trace.push_back(6.0 + i * 0.02);
+	Run run = Simulate(trace, config);
+	for (size_t i = 1; i < run.scales.size(); ++i)
+		CHECK(run.scales[i] <= run.scales[i - 1]); // Never raised while the load only grows
+	CHECK(run.scales.back() == 0.6f);
+	CHECK(run.stats.raised == 0);
+
+	// maxScale below 1 is where it starts and the highest it goes
+	config = WBDynamicResolutionConfig();
+	config.maxScale = 0.75f;
+	Run capped = Simulate(Constant(1000, 4.0), config);
+	CHECK(capped.Changes() == 0 && capped.scales.back() == 0.75f);
+}
+
+static void TestDeterministic() {
+	std::vector<double> trace;
+	Append(trace, Constant(500, 25.0));
+	Append(trace, Constant(500, 5.0));
+	Append(trace, Constant(500, 18.0));
+	Run a = Simulate(trace, WBDynamicResolutionConfig(), 1.0, 0.1, 42);
+	Run b = Simulate(trace, WBDynamicResolutionConfig(), 1.0, 0.1, 42);
+	CHECK(a.scales == b.scales);
+
+	// Reset goes back to the top
+	WBDynamicResolution controller;
+	for (int i = 0; i < 100; ++i)
+		controller.Update(40.0);
+	CHECK(controller.GetScale() < 1.0f);
+	controller.Reset();
+	CHECK(controller.GetScale() == 1.0f);
+}
+
+static void Benchmark() {
+	WBDynamicResolution controller;
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<double> ms(5.0, 25.0);
+	std::vector<double> samples(1 << 16);
+	for (double& sample : samples)
+		sample = ms(rng);
+	const int iterations = 10000000;
+	float sink = 0.0f;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		sink += controller.Update(samples[i & (samples.size() - 1)]);
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+	std::cout << "controller update " << ns << " ns per frame (" << sink / iterations << " mean scale)" << std::endl;
+}
+
+int main(void) {
+	TestLightLoadStaysAtFullResolution();
+	TestHeavyLoadConvergesAndHolds();
+	TestSpikesAreIgnored();
+	TestRecoversWhenLoadDrops();
+	TestHysteresisAtTheEdge();
+	TestSlowRampAndLimits();
+	TestDeterministic();
+	Benchmark();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All dynamic resolution tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "windowbuilder_framering.h"
+#include <iostream>
+#include <thread>
+#include <random>
+#include <chrono>
+
+// Exercises the frame ring in one process: dirty tile reporting, a consumer that lags inside
+// the ring, one that falls behind by more than the ring holds, and a concurrent slow reader.
+// Ends with publish + consume throughput at 1920x1080 for static, sparse and fully changing frames.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+// Publishes and consumes frames in lockstep, returning frames per second. change(i) edits the
+// image before frame i; it runs outside the timing.
+template<typename Change>
+static double Measure(WBFrameRingProducer& producer, WBFrameRingConsumer& consumer, std::vector<uint8_t>& image,
+	uint32_t width, uint32_t height, int frames, Change change) {
+	WBConsumedFrame frame;
+	producer.Publish(image.data(), width, height, width * 4);
+	consumer.Poll(frame);
+	std::chrono::steady_clock::duration spent = {};
+	for (int i = 0; i < frames; ++i) {
+		change(i);
+		auto start = std::chrono::steady_clock::now();
+		producer.Publish(image.data(), width, height, width * 4);
+		consumer.Poll(frame);
+		spent += std::chrono::steady_clock::now() - start;
+	}
+	CHECK(memcmp(consumer.GetPixels(), image.data(), image.size()) == 0);
+	return frames / std::chrono::duration<double>(spent).count();
+}
+
+static void Benchmark() {
+	const uint32_t width = 1920, height = 1080;
+	const double frameGB = width * height * 4 / 1e9;
+	std::vector<uint8_t> image(size_t(width) * height * 4);
+	std::mt19937 rng(2);
+	for (uint8_t& value : image)
+		value = static_cast<uint8_t>(rng());
+
+	WBSharedMemory::Remove("WindowBuilderBench");
+	WBFrameRingProducer producer;
+	WBFrameRingConsumer consumer;
+	CHECK(producer.Create("WindowBuilderBench", width, height, 3, 32));
+	CHECK(consumer.Open("WindowBuilderBench"));
+
+	auto report = [&](const char* name, double fps) {
+		std::cout << "1920x1080 " << name << ": " << fps << " frames/s, " << fps * frameGB << " GB/s frame-equivalent" << std::endl;
+	};
+	report("static", Measure(producer, consumer, image, width, height, 300, [](int) {}));
+	report("20 pixels changed", Measure(producer, consumer, image, width, height, 300, [&](int) {
+		for (int i = 0; i < 20; ++i)
+			image[((rng() % height) * width + rng() % width) * 4] ^= 0x5A;
+	}));
+	report("every pixel changed", Measure(producer, consumer, image, width, height, 30, [&](int) {
+		for (size_t i = 0; i < image.size(); i += 4)
+			image[i] ^= 0x01;
+	}));
+}
+
+int main(void) {
+	const uint32_t width = 640, height = 360;
+	std::vector<uint8_t> image(width * height * 4, 0);
+	std::mt19937 rng(1);
+	auto scribble = [&](int pixels) {
+		for (int i = 0; i < pixels; ++i)
+			image[((rng() % height) * width + rng() % width) * 4] ^= 0x5A;
+	};
+	auto publish = [&](WBFrameRingProducer& producer) {
+		return producer.Publish(image.data(), width, height, width * 4);
+	};
+
+	WBSharedMemory::Remove("WindowBuilderTest"); // Left behind if an earlier run crashed
+	WBFrameRingProducer producer;
+	WBFrameRingConsumer consumer;
+	CHECK(producer.Create("WindowBuilderTest", width, height, 3, 32));
+	CHECK(consumer.Open("WindowBuilderTest"));
+
+	WBConsumedFrame frame;
+	CHECK(!consumer.Poll(frame));
+
+	// First frame is reported fully dirty
+	publish(producer);
+	CHECK(consumer.Poll(frame) && frame.full && frame.frame == 0);
+
+	// Only changed tiles are reported
+	scribble(4);
+	uint32_t dirty = publish(producer);
+	CHECK(dirty >= 1 && dirty <= 4);
+	CHECK(consumer.Poll(frame) && !frame.full && frame.dirtyTiles == dirty);
+	CHECK(memcmp(consumer.GetPixels(), image.data(), image.size()) == 0);
+
+	publish(producer);
+	CHECK(consumer.Poll(frame) && frame.dirtyTiles == 0);
+
+	// Lagging by less than the ring merges the skipped bitmaps
+	scribble(3);
+	publish(producer);
+	scribble(3);
+	publish(producer);
+	CHECK(consumer.Poll(frame) && frame.skipped == 1 && !frame.overrun);
+	CHECK(memcmp(consumer.GetPixels(), image.data(), image.size()) == 0);
+
+	// Falling behind by more than the ring holds forces a full refresh
+	for (int i = 0; i < 10; ++i) {
+		scribble(2);
+		publish(producer);
+	}
+	CHECK(consumer.Poll(frame) && frame.overrun && frame.full && frame.skipped == 9);
+	CHECK(memcmp(consumer.GetPixels(), image.data(), image.size()) == 0);
+	CHECK(!consumer.Poll(frame));
+
+	// A reader much slower than the writer always ends up with an untorn copy of the newest frame
+	std::atomic<bool> done = false;
+	std::vector<uint8_t> finalImage;
+	std::thread reader([&] {
+		WBFrameRingConsumer slow;
+		slow.Open("WindowBuilderTest");
+		WBConsumedFrame slowFrame;
+		while (!done) {
+			slow.Poll(slowFrame);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		slow.Poll(slowFrame);
+		finalImage.assign(slow.GetPixels(), slow.GetPixels() + image.size());
+	});
+	for (int i = 0; i < 500; ++i) {
+		scribble(50);
+		publish(producer);
+	}
+	done = true;
+	reader.join();
+	CHECK(finalImage == image);
+
+	// A second producer cannot take over a name in use
+	WBFrameRingProducer intruder;
+	CHECK(!intruder.Create("WindowBuilderTest", width, height));
+	publish(producer);
+	CHECK(consumer.Poll(frame));
+
+	// Frames larger than the capacity are cropped, and the slot says so
+	std::vector<uint8_t> large(size_t(width + 40) * (height + 20) * 4, 0x33);
+	producer.Publish(large.data(), width + 40, height + 20, size_t(width + 40) * 4);
+	CHECK(consumer.Poll(frame) && frame.width == width && frame.height == height);
+	CHECK(consumer.GetPixels()[(size_t(height - 1) * width + width - 1) * 4] == 0x33);
+
+	// Consumers reject headers that do not match the mapping
+	auto forge = [&](size_t bytes, auto edit) {
+		WBSharedMemory memory;
+		CHECK(memory.Create("WindowBuilderForged", bytes));
+		memcpy(memory.Data(), producer.Header(), sizeof(WBFrameRingHeader) - sizeof(uint64_t));
+		edit(*reinterpret_cast<WBFrameRingHeader*>(memory.Data()));
+		WBFrameRingConsumer forged;
+		return forged.Open("WindowBuilderForged");
+	};
+	const WBFrameRingHeader* header = producer.Header();
+	const size_t ringBytes = WBFrameRingView::SlotsOffset() + header->slotBytes * header->slotCount;
+	CHECK(forge(ringBytes, [](WBFrameRingHeader&) {}));
+	CHECK(!forge(ringBytes - 64, [](WBFrameRingHeader&) {}));                                // Last slot cut short
+	CHECK(!forge(ringBytes, [](WBFrameRingHeader& h) { h.slotCount = 1000; }));             // Slots past the end
+	CHECK(!forge(ringBytes, [](WBFrameRingHeader& h) { h.capacityHeight *= 2; }));          // Frame larger than a slot
+	CHECK(!forge(ringBytes, [](WBFrameRingHeader& h) { h.tileSize = 0; }));
+	CHECK(!forge(ringBytes, [](WBFrameRingHeader& h) { h.tilesX = 1; }));                   // Bitmap smaller than the grid
+	CHECK(!forge(ringBytes, [](WBFrameRingHeader& h) { h.capacityWidth = h.capacityHeight = 0xFFFFFFFFu; }));
+
+	Benchmark();
+
+	std::cout << (failures ? "Frame ring test failed" : "Frame ring test passed") << std::endl;
+	return failures ? 1 : 0;
+}
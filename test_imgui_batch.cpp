@@ -0,0 +1,203 @@
+#include "windowbuilder_imgui_batch.h"
+#include <iostream>
+#include <random>
+#include <memory>
+
+// Exercises the GPU-independent half of the ImGui renderer: the fenced ring allocator that
+// backs the vertex and index buffers, and draw command merging with and without index rebasing.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static void TestRingBasics() {
+	WBRingAllocator ring(100);
+	CHECK(ring.Allocate(40) == 0);
+	CHECK(ring.Allocate(40) == 40);
+	CHECK(ring.Allocate(30) == WBRingAllocator::invalid);
+	ring.EndFrame(1);
+
+	CHECK(ring.Allocate(20) == 80);
+	ring.EndFrame(2);
+	CHECK(ring.Allocate(1) == WBRingAllocator::invalid);
+
+	// Frame 1 done: the start of the buffer is free again
+	ring.Retire(1);
+	CHECK(ring.GetUsed() == 20);
+	CHECK(ring.Allocate(50) == 0);
+	CHECK(ring.Allocate(40) == WBRingAllocator::invalid);
+	ring.EndFrame(3);
+
+	ring.Retire(2);
+	CHECK(ring.Allocate(40) == 50);
+	ring.EndFrame(4);
+
+	// Wrapping skips the unusable tail of the buffer and releases it with the frame
+	ring.Retire(3);
+	CHECK(ring.Allocate(30) == 0);
+	CHECK(ring.GetUsed() == 40 + 10 + 30);
+	ring.EndFrame(5);
+	ring.Retire(5);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+}
+
+// Random frames with GPU latency: no allocation may overlap one the GPU can still be reading
+static void TestRingRandom() {
+	std::mt19937 rng(7);
+	const size_t capacity = 1000;
+	WBRingAllocator ring(capacity);
+	std::vector<int> owner(capacity, 0); // Frame owning each unit, 0 = free
+	const int latency = 3;
+	int failed = 0;
+
+	for (int frame = 1; frame <= 5000; ++frame) {
+		int allocations = 1 + rng() % 4;
+		for (int a = 0; a < allocations; ++a) {
+			size_t count = 1 + rng() % 120;
+			size_t offset = ring.Allocate(count);
+			if (offset == WBRingAllocator::invalid) {
+				++failed;
+				continue;
+			}
+			CHECK(offset + count <= capacity);
+			for (size_t i = offset; i < offset + count && i < capacity; ++i) {
+				if (owner[i] != 0) {
+					CHECK(owner[i] == 0);
+					return;
+				}
+				owner[i] = frame;
+			}
+		}
+		ring.EndFrame(frame);
+
+		int completed = frame - latency;
+		if (completed <= 0)
+			continue;
+		ring.Retire(completed);
+		for (int& unit : owner)
+			if (unit != 0 && unit <= completed)
+				unit = 0;
+	}
+	CHECK(failed > 0 && failed < 5000);
+}
+
+// ImDrawList has no default constructor and owns its buffers, so the lists are held by pointer
+using Lists = std::vector<std::unique_ptr<ImDrawList>>;
+
+static ImDrawList* MakeList(Lists& storage, int vertices) {
+	storage.push_back(std::make_unique<ImDrawList>(nullptr));
+	ImDrawList* list = storage.back().get();
+	for (int i = 0; i < vertices; ++i)
+		list->VtxBuffer.push_back(ImDrawVert{ ImVec2(float(i), 0.0f), ImVec2(), 0xFFFFFFFF });
+	return list;
+}
+
+static void AddCommand(ImDrawList* list, ImTextureID texture, ImVec4 clip, int triangles, int firstVertex = 0) {
+	ImDrawCmd cmd;
+	cmd.ClipRect = clip;
+	cmd.TextureId = texture;
+	cmd.IdxOffset = list->IdxBuffer.Size;
+	cmd.ElemCount = triangles * 3;
+	for (int i = 0; i < triangles * 3; ++i)
+		list->IdxBuffer.push_back(static_cast<ImDrawIdx>(firstVertex + i % 3));
+	list->CmdBuffer.push_back(cmd);
+}
+
+// ImDrawData starts out with a zero framebuffer scale, which would scale every clip rect to nothing
+static void Finish(ImDrawData& data, Lists& lists) {
+	data.Clear();
+	for (auto& list : lists) {
+		data.CmdLists.push_back(list.get());
+		data.CmdListsCount++;
+		data.TotalVtxCount += list->VtxBuffer.Size;
+		data.TotalIdxCount += list->IdxBuffer.Size;
+	}
+	data.Valid = true;
+	data.DisplaySize = ImVec2(800, 600);
+	data.FramebufferScale = ImVec2(1.0f, 1.0f);
+}
+
+static void TestMerging() {
+	ImTextureID font = (ImTextureID)1, image = (ImTextureID)2;
+	const ImVec4 full(0, 0, 800, 600), panel(10, 10, 200, 200);
+
+	Lists lists;
+	ImDrawList* a = MakeList(lists, 10);
+	AddCommand(a, font, full, 2);
+	AddCommand(a, font, full, 3);       // Merges with the previous
+	AddCommand(a, font, ImVec4(50, 50, 50, 80), 1); // Empty clip, dropped
+	AddCommand(a, image, full, 1);      // New texture
+	AddCommand(a, image, panel, 1);     // New clip rect
+	ImDrawList* b = MakeList(lists, 10);
+	AddCommand(b, image, panel, 2, 4);  // Next list, same state: merges across lists once rebased
+	ImDrawCmd callback;
+	callback.UserCallback = ImDrawCallback_ResetRenderState;
+	b->CmdBuffer.push_back(callback);
+	AddCommand(b, image, panel, 1);     // A callback always splits
+
+	ImDrawData data;
+	Finish(data, lists);
+
+	WBImGuiBatcher batcher;
+	batcher.Build(&data, 800, 600);
+	CHECK(batcher.IsRebased());
+	CHECK(batcher.GetCommandCount() == 8);
+	const std::vector<WBImGuiDraw>& draws = batcher.GetDraws();
+	CHECK(draws.size() == 5);
+	if (draws.size() != 5)
+		return;
+	CHECK(draws[0].indexOffset == 0 && draws[0].indexCount == 15 && draws[0].texture == font);
+	CHECK(draws[1].indexCount == 3 && draws[1].clip[2] == 800);
+	CHECK(draws[2].indexCount == 3 + 6 && draws[2].clip[0] == 10 && draws[2].clip[3] == 200);
+	CHECK(draws[3].callback != nullptr);
+	CHECK(draws[4].indexOffset == 30 && draws[4].baseVertex == 0);
+
+	// Indices of the second list are rebased past the first list's vertices
+	std::vector<ImDrawVert> vertices(batcher.GetVertexCount());
+	std::vector<ImDrawIdx> indices(batcher.GetIndexCount());
+	batcher.Write(&data, vertices.data(), indices.data());
+	CHECK(indices[0] == 0 && indices[1] == 1);
+	CHECK(indices[24] == 10 + 4 && indices[25] == 10 + 5);
+	CHECK(vertices[12].pos.x == 2.0f);
+}
+
+static void TestLargeFrameKeepsBaseVertices() {
+	// More vertices than 16-bit indices can address: every list keeps its own base vertex
+	Lists lists;
+	const int count = sizeof(ImDrawIdx) == 2 ? 40000 : 10;
+	ImDrawList* a = MakeList(lists, count);
+	AddCommand(a, (ImTextureID)1, ImVec4(0, 0, 800, 600), 1);
+	ImDrawList* b = MakeList(lists, count);
+	AddCommand(b, (ImTextureID)1, ImVec4(0, 0, 800, 600), 1);
+
+	ImDrawData data;
+	Finish(data, lists);
+	WBImGuiBatcher batcher;
+	batcher.Build(&data, 800, 600);
+	if (sizeof(ImDrawIdx) != 2)
+		return;
+	CHECK(!batcher.IsRebased());
+	CHECK(batcher.GetDraws().size() == 2);
+	CHECK(batcher.GetDraws()[1].baseVertex == count);
+
+	std::vector<ImDrawVert> vertices(batcher.GetVertexCount());
+	std::vector<ImDrawIdx> indices(batcher.GetIndexCount());
+	batcher.Write(&data, vertices.data(), indices.data());
+	CHECK(indices[3] == 0 && indices[4] == 1);
+}
+
+int main(void) {
+	TestRingBasics();
+	TestRingRandom();
+	TestMerging();
+	TestLargeFrameKeepsBaseVertices();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All imgui batch tests passed" << std::endl;
+	return 0;
+}
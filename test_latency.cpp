@@ -0,0 +1,179 @@
+#include "windowbuilder_latency.h"
+#include <iostream>
+
+// Drives WBLatencyTracker with a virtual clock: input attribution to frames, late latching,
+// the distributions and the sample window.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static uint64_t now = 0;
+static const uint64_t ms = 1000000;
+
+static WBLatencyTracker MakeTracker(size_t window = 1024) {
+	now = 1000 * ms;
+	return WBLatencyTracker([] { return now; }, window);
+}
+
+static void TestAttribution() {
+	WBLatencyTracker tracker = MakeTracker();
+
+	// Two inputs before the frame are consumed by it
+	tracker.InputReceived();
+	now += 5 * ms;
+	tracker.InputReceived();
+	now += 1 * ms;
+	tracker.BeginFrame();
+	now += 4 * ms;
+	tracker.Submit();
+	now += 2 * ms;
+	tracker.Present();
+
+	const WBFrameTiming& first = tracker.GetLastFrame();
+	CHECK(first.frame == 0 && first.inputCount == 2);
+	CHECK(first.submit - first.simulation == 4 * ms);
+	CHECK(first.present - first.oldestInput == 12 * ms);
+	CHECK(first.present - first.newestInput == 7 * ms);
+	CHECK(first.latch == 0);
+
+	// Input arriving during a frame without a late latch waits for the next frame
+	tracker.BeginFrame();
+	now += 1 * ms;
+	tracker.InputReceived();
+	now += 3 * ms;
+	tracker.Submit();
+	tracker.Present();
+	CHECK(tracker.GetLastFrame().inputCount == 0);
+
+	now += 10 * ms;
+	tracker.BeginFrame();
+	now += 4 * ms;
+	tracker.Present(); // Submit defaults to present
+	const WBFrameTiming& third = tracker.GetLastFrame();
+	CHECK(third.inputCount == 1 && third.present - third.oldestInput == 17 * ms);
+	CHECK(third.submit == third.present);
+
+	// A late latch picks up input received during the frame
+	tracker.BeginFrame();
+	now += 3 * ms;
+	tracker.InputReceived();
+	now += 1 * ms;
+	tracker.LateLatch();
+	now += 1 * ms;
+	tracker.Submit();
+	now += 1 * ms;
+	tracker.Present();
+	const WBFrameTiming& fourth = tracker.GetLastFrame();
+	CHECK(fourth.inputCount == 1 && fourth.latch - fourth.simulation == 4 * ms);
+	CHECK(fourth.present - fourth.newestInput == 3 * ms);
+
+	WBLatencyStats stats = tracker.GetStats();
+	CHECK(stats.frames == 4 && stats.framesWithInput == 3);
+	CHECK(stats.oldestInputToPresent.count == 3 && stats.simulationToPresent.count == 4);
+
+	// Stamps outside a frame are ignored
+	tracker.Submit();
+	tracker.Present();
+	CHECK(tracker.GetStats().frames == 4);
+}
+
+static void TestDistribution() {
+	WBLatencyTracker tracker = MakeTracker();
+	for (int i = 1; i <= 100; ++i) {
+		tracker.BeginFrame();
+		now += i * ms;
+		tracker.Present();
+	}
+	WBLatencySummary frame = tracker.GetStats().simulationToPresent;
+	CHECK(frame.count == 100);
+	CHECK(frame.mean == 50.5);
+	CHECK(frame.p50 == 51.0 && frame.p90 == 91.0 && frame.p99 == 100.0 && frame.max == 100.0);
+	CHECK(tracker.GetStats().oldestInputToPresent.count == 0);
+
+	// Only the most recent frames are kept
+	WBLatencyTracker recent = MakeTracker(10);
+	for (int i = 1; i <= 100; ++i) {
+		recent.BeginFrame();
+		now += i * ms;
+		recent.Present();
+	}
+	WBLatencySummary last = recent.GetStats().simulationToPresent;
+	CHECK(last.count == 10 && last.max == 100.0 && last.p50 == 96.0);
+	CHECK(recent.GetStats().frames == 100);
+}
+
+// A pointer that moves once per frame, halfway through it: latching it right before submission
+// shows the movement one frame earlier.
+static double RunPointerLoop(bool lateLatch) {
+	WBLatencyTracker tracker = MakeTracker();
+	for (int i = 0; i < 200; ++i) {
+		tracker.BeginFrame();
+		now += 8 * ms;
+		tracker.InputReceived();
+		now += 6 * ms;
+		if (lateLatch)
+			tracker.LateLatch();
+		tracker.Submit();
+		now += 2 * ms;
+		tracker.Present();
+	}
+	return tracker.GetStats().newestInputToPresent.p50;
+}
+
+static void TestLateLatchSavesAFrame() {
+	double without = RunPointerLoop(false);
+	double with = RunPointerLoop(true);
+	CHECK(without == 24.0);
+	CHECK(with == 8.0);
+}
+
+static void TestEventTime() {
+	const uint64_t clockNs = 5000 * ms;
+	CHECK(WBEventTimeNs(clockNs, 1000, 1000) == clockNs);
+	CHECK(WBEventTimeNs(clockNs, 1000, 990) == clockNs - 10 * ms);
+	CHECK(WBEventTimeNs(clockNs, 5, 0xFFFFFFFBu) == clockNs - 10 * ms); // Tick count wrapped in between
+	CHECK(WBEventTimeNs(clockNs, 1000, 1003) == clockNs);               // Newer than the reading: now
+	CHECK(WBEventTimeNs(clockNs, 100000, 0) == 0);                      // Older than the clock's epoch
+}
+
+// As Window::Show() does it: the move happens at 8 ms into the frame but is only sampled by the
+// late latch at 14 ms. Stamping it with its event time, taken from a millisecond tick count,
+// measures from the move; stamping it when sampled would leave out the 6 ms it waited.
+static double RunLatchedEventLoop(bool eventTime) {
+	WBLatencyTracker tracker = MakeTracker();
+	for (int i = 0; i < 200; ++i) {
+		tracker.BeginFrame();
+		now += 8 * ms;
+		const uint32_t eventTick = static_cast<uint32_t>(now / ms) + 0xFFFFF000u; // Tick count near its wrap
+		now += 6 * ms;
+		const uint32_t nowTick = static_cast<uint32_t>(now / ms) + 0xFFFFF000u;
+		tracker.InputReceived(eventTime ? WBEventTimeNs(tracker.Now(), nowTick, eventTick) : tracker.Now());
+		tracker.LateLatch();
+		tracker.Submit();
+		now += 2 * ms;
+		tracker.Present();
+	}
+	return tracker.GetStats().newestInputToPresent.p50;
+}
+
+static void TestLatchedInputKeepsItsEventTime() {
+	CHECK(RunLatchedEventLoop(true) == 8.0);
+	CHECK(RunLatchedEventLoop(false) == 2.0);
+}
+
+int main(void) {
+	TestAttribution();
+	TestDistribution();
+	TestLateLatchSavesAFrame();
+	TestEventTime();
+	TestLatchedInputKeepsItsEventTime();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All latency tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include "windowbuilder_layered.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+
+// Checks the RGBA to premultiplied BGRA kernels against the scalar reference for every
+// color/alpha pair, the changed-row detection, and reports how much faster they are.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+// Every (color, alpha) pair, plus an odd pixel count so every kernel's tail runs
+static std::vector<uint8_t> MakeAllPairs(size_t& pixels) {
+	pixels = 256 * 256 + 3;
+	std::vector<uint8_t> rgba(pixels * 4, 0x80);
+	for (int color = 0; color < 256; ++color) {
+		for (int alpha = 0; alpha < 256; ++alpha) {
+			uint8_t* p = &rgba[(color * 256 + alpha) * 4];
+			p[0] = static_cast<uint8_t>(color);
+			p[1] = static_cast<uint8_t>(255 - color);
+			p[2] = static_cast<uint8_t>(color ^ 0x5A);
+			p[3] = static_cast<uint8_t>(alpha);
+		}
+	}
+	return rgba;
+}
+
+static void TestMatchesScalar() {
+	size_t pixels = 0;
+	std::vector<uint8_t> rgba = MakeAllPairs(pixels);
+
+	for (bool premultiply : { false, true }) {
+		std::vector<uint8_t> expected(rgba.size()), actual(rgba.size());
+		CHECK(WBRGBAToBGRARowScalar(rgba.data(), expected.data(), pixels, premultiply));
+		CHECK(WBRGBAToBGRARow(rgba.data(), actual.data(), pixels, premultiply));
+		CHECK(actual == expected);
+
+		// Converting the same row again changes nothing
+		CHECK(!WBRGBAToBGRARow(rgba.data(), actual.data(), pixels, premultiply));
+
+		// A single differing byte is found in the vector body and in the tail
+		for (size_t pixel : { size_t(0), size_t(5), size_t(17), pixels - 1 }) {
+			actual[pixel * 4 + 1] ^= 1;
+			CHECK(WBRGBAToBGRARow(rgba.data(), actual.data(), pixels, premultiply));
+			CHECK(actual == expected);
+		}
+	}
+
+	// Premultiplication rounds to nearest and leaves alpha alone
+	std::vector<uint8_t> bgra(rgba.size());
+	WBRGBAToBGRARow(rgba.data(), bgra.data(), pixels, true);
+	int wrong = 0;
+	for (int color = 0; color < 256; ++color) {
+		for (int alpha = 0; alpha < 256; ++alpha) {
+			const uint8_t* p = &bgra[(color * 256 + alpha) * 4];
+			wrong += p[2] != static_cast<int>(color * alpha / 255.0 + 0.5) || p[3] != alpha;
+		}
+	}
+	CHECK(wrong == 0);
+}
+
+static void TestDirtyRows() {
+	const int width = 67, height = 40;
+	std::vector<uint8_t> rgba(width * height * 4), bgra(width * height * 4);
+	std::mt19937 rng(11);
+	for (uint8_t& value : rgba)
+		value = static_cast<uint8_t>(rng());
+
+	WBDirtyRows first = WBRGBAToBGRAFrame(rgba.data(), width * 4, bgra.data(), width * 4, width, height, WBLayeredAlpha::Straight);
+	CHECK(first.first == 0 && first.last == height);
+	CHECK(WBRGBAToBGRAFrame(rgba.data(), width * 4, bgra.data(), width * 4, width, height, WBLayeredAlpha::Straight).Empty());
+
+	rgba[(7 * width + 3) * 4] ^= 0xFF;
+	rgba[(21 * width + 66) * 4 + 3] ^= 0xFF;
+	WBDirtyRows dirty = WBRGBAToBGRAFrame(rgba.data(), width * 4, bgra.data(), width * 4, width, height, WBLayeredAlpha::Straight);
+	CHECK(dirty.first == 7 && dirty.last == 22);
+
+	// Rows are converted on their own pitch
+	std::vector<uint8_t> padded(width * 4 + 64);
+	CHECK(WBRGBAToBGRAFrame(rgba.data(), width * 4, padded.data(), width * 4 + 64, width, 1, WBLayeredAlpha::Premultiplied).last == 1);
+	CHECK(padded[width * 4] == 0);
+}
+
+// 1080p frames, one byte changing per frame
+static void Benchmark() {
+	const int width = 1920, height = 1080, frames = 30;
+	std::vector<uint8_t> rgba(width * height * 4), bgra(width * height * 4);
+	std::mt19937 rng(3);
+	for (uint8_t& value : rgba)
+		value = static_cast<uint8_t>(rng());
+
+	auto measure = [&](auto convert) {
+		convert();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; ++i) {
+			rgba[(i * 7919) % rgba.size()] ^= 1;
+			convert();
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+	};
+
+	for (WBLayeredAlpha alpha : { WBLayeredAlpha::Premultiplied, WBLayeredAlpha::Straight }) {
+		bool premultiply = alpha == WBLayeredAlpha::Straight;
+		double scalar = measure([&] {
+			for (int y = 0; y < height; ++y)
+				WBRGBAToBGRARowScalar(&rgba[y * width * 4], &bgra[y * width * 4], width, premultiply);
+		});
+		double simd = measure([&] {
+			WBRGBAToBGRAFrame(rgba.data(), width * 4, bgra.data(), width * 4, width, height, alpha);
+		});
+		std::cout << (premultiply ? "premultiply" : "swizzle") << " 1920x1080: scalar " << scalar << " ms, "
+			<< (WBCpuHasAVX2() ? "avx2 " : "sse2 ") << simd << " ms (" << scalar / simd << "x)" << std::endl;
+	}
+}
+
+int main(void) {
+	TestMatchesScalar();
+	TestDirtyRows();
+	Benchmark();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All layered conversion tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,158 @@
+#include "windowbuilder_layers.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Drives the layer stack through simulated frames: which layers get redrawn, the order they
+// are composited in, reduced resolution sizes and the per-layer counters.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+using Id = WBLayerStack::Id;
+
+// One frame as the window runs it; returns the layers that were redrawn
+static std::vector<Id> Frame(WBLayerStack& stack) {
+	std::vector<Id> redrawn(stack.CollectDirty());
+	for (Id id : redrawn)
+		stack.Redrawn(id, 0.5);
+	for (Id id : stack.CompositeOrder())
+		stack.Composited(id, 0.01, 800, 600);
+	return redrawn;
+}
+
+static void TestDirtyTracking() {
+	WBLayerStack stack;
+	stack.Resize(800, 600);
+	Id map = stack.Add({ "map", 0 });
+	Id hud = stack.Add({ "hud", 10 });
+
+	// New layers are drawn once, then reused
+	CHECK((Frame(stack) == std::vector<Id>{ map, hud }));
+	for (int i = 0; i < 10; ++i)
+		CHECK(Frame(stack).empty());
+	CHECK(stack.GetStats(map).redraws == 1 && stack.GetStats(map).composites == 11);
+	CHECK(stack.GetStats(hud).compositedPixels == 11ull * 800 * 600);
+
+	stack.MarkDirty(hud);
+	CHECK(stack.IsDirty(hud) && !stack.IsDirty(map));
+	CHECK((Frame(stack) == std::vector<Id>{ hud }));
+	CHECK(stack.GetStats(hud).redraws == 2);
+
+	// Marking a layer while it redraws schedules it for the next frame
+	const std::vector<Id>& dirty = stack.CollectDirty();
+	CHECK(dirty.empty());
+	stack.MarkDirty(map);
+	std::vector<Id> redrawing(stack.CollectDirty());
+	CHECK((redrawing == std::vector<Id>{ map }));
+	stack.MarkDirty(map);
+	stack.Redrawn(map, 0.5);
+	CHECK((Frame(stack) == std::vector<Id>{ map }));
+
+	stack.MarkAllDirty();
+	CHECK(Frame(stack).size() == 2);
+
+	// A redraw that could not happen (no texture) is retried once the layer is marked again
+	stack.MarkDirty(hud);
+	CHECK((stack.CollectDirty() == std::vector<Id>{ hud }) && !stack.IsDirty(hud));
+	stack.MarkDirty(hud);
+	CHECK((Frame(stack) == std::vector<Id>{ hud }));
+
+	// Unknown ids are ignored
+	stack.MarkDirty(1234);
+	CHECK(!stack.IsDirty(1234) && stack.GetStats(1234).redraws == 0);
+}
+
+static void TestOrdering() {
+	WBLayerStack stack;
+	Id a = stack.Add({ "a", 5 });
+	Id b = stack.Add({ "b", -1 });
+	Id c = stack.Add({ "c", 5 });
+	Id d = stack.Add({ "d", 2 });
+
+	// Back to front by z, ties in creation order
+	CHECK((stack.CompositeOrder() == std::vector<Id>{ b, d, a, c }));
+
+	stack.SetZ(b, 9);
+	CHECK((stack.CompositeOrder() == std::vector<Id>{ d, a, c, b }));
+
+	// Ties stay in creation order however the layers got there
+	stack.SetZ(d, 5);
+	CHECK((stack.CompositeOrder() == std::vector<Id>{ a, c, d, b }));
+
+	CHECK(stack.Remove(c) && !stack.Remove(c) && !stack.Contains(c));
+	CHECK((stack.CompositeOrder() == std::vector<Id>{ a, d, b }));
+	CHECK(stack.Find("b") == b && stack.Find("c") == WBLayerStack::invalid && stack.Count() == 3);
+	CHECK(stack.GetAllStats().size() == 3 && std::string(stack.GetAllStats().back().name) == "b");
+}
+
+static void TestOpacity() {
+	WBLayerStack stack;
+	Id base = stack.Add({ "base" });
+	Id popup = stack.Add({ "popup", 1, 0.0f });
+
+	// Hidden layers are neither drawn nor composited, and keep their dirty flag for later
+	CHECK((Frame(stack) == std::vector<Id>{ base }));
+	CHECK(stack.IsDirty(popup) && stack.GetStats(popup).composites == 0);
+
+	stack.SetOpacity(popup, 0.5f);
+	CHECK((Frame(stack) == std::vector<Id>{ popup }));
+	CHECK((stack.CompositeOrder() == std::vector<Id>{ base, popup }));
+
+	// Fading out and back in reuses the cached contents
+	stack.SetOpacity(popup, 0.0f);
+	Frame(stack);
+	stack.SetOpacity(popup, 1.0f);
+	CHECK(Frame(stack).empty());
+	CHECK(stack.GetStats(popup).redraws == 1 && stack.GetDesc(popup)->opacity == 1.0f);
+}
+
+static void TestScale() {
+	WBLayerStack stack;
+	stack.Resize(1920, 1080);
+	Id full = stack.Add({ "full" });
+	Id half = stack.Add({ "half", 0, 1.0f, 0.5f });
+	Id tiny = stack.Add({ "tiny", 0, 1.0f, 0.0f });
+	Frame(stack);
+
+	int width = 0, height = 0;
+	CHECK(stack.GetSize(full, width, height) && width == 1920 && height == 1080);
+	CHECK(stack.GetSize(half, width, height) && width == 960 && height == 540);
+	CHECK(stack.GetSize(tiny, width, height) && width == 30 && height == 17);
+	CHECK(!stack.GetSize(999, width, height));
+
+	// A resize redraws only the layers whose pixel size changes
+	stack.Resize(1919, 1080);
+	CHECK((Frame(stack) == std::vector<Id>{ full }));
+	stack.Resize(1919, 1080);
+	CHECK(Frame(stack).empty());
+	stack.Resize(1000, 500);
+	CHECK(Frame(stack).size() == 3);
+
+	stack.SetScale(half, 0.25f);
+	CHECK(stack.GetSize(half, width, height) && width == 250 && height == 125);
+	CHECK((Frame(stack) == std::vector<Id>{ half }));
+	stack.SetScale(full, 4.0f);
+	CHECK(Frame(stack).empty());
+
+	// Composited into a scene rendered at 60% resolution, only the scene's pixels are written
+	uint64_t before = stack.GetStats(half).compositedPixels;
+	stack.Composited(half, 0.01, 600, 300);
+	CHECK(stack.GetStats(half).compositedPixels - before == 600ull * 300);
+}
+
+int main(void) {
+	TestDirtyTracking();
+	TestOrdering();
+	TestOpacity();
+	TestScale();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All layer stack tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,293 @@
+#include "windowbuilder_metrics.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// Checks the frame time histogram and its quantiles, the Prometheus text output, and scrapes the
+// exporter over a loopback socket and a Unix domain socket while a simulated render thread keeps
+// updating the counters. Clients that never read must not keep Stop() waiting.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static void TestHistogram() {
+	WBFrameTimeHistogram histogram;
+	CHECK(std::isnan(histogram.Load().Quantile(0.5)));
+	CHECK(WBFrameTimeHistogram::UpperBoundMs(0) == 0.25);
+	CHECK(WBFrameTimeHistogram::UpperBoundMs(4) == 0.5);
+	CHECK(std::abs(WBFrameTimeHistogram::UpperBoundMs(28) - 32.0) < 1e-9);
+
+	// Uniform 10..20 ms: quantiles land within one bucket (19%) of the truth
+	std::mt19937 rng(5);
+	std::uniform_int_distribution<uint64_t> frameNs(10000000, 20000000);
+	for (int i = 0; i < 100000; ++i)
+		histogram.Record(frameNs(rng));
+	WBFrameTimeHistogram::Snapshot all = histogram.Load();
+	CHECK(all.count == 100000);
+	CHECK(std::abs(all.Quantile(0.5) - 15.0) < 15.0 * 0.19);
+	CHECK(std::abs(all.Quantile(0.9) - 19.0) < 19.0 * 0.19);
+	CHECK(all.Quantile(0.0) >= 8.0 && all.Quantile(1.0) <= 20.0 * 1.19);
+	CHECK(std::abs(static_cast<double>(all.sumNs) / all.count / 1e6 - 15.0) < 0.1);
+
+	// Extremes land in the first and the overflow bucket
+	histogram.Record(0);
+	histogram.Record(5000000000ull);
+	WBFrameTimeHistogram::Snapshot extremes = histogram.Load().Since(all);
+	CHECK(extremes.count == 2 && extremes.buckets[0] == 1 && extremes.buckets[WBFrameTimeHistogram::bucketCount] == 1);
+	CHECK(extremes.Quantile(1.0) == WBFrameTimeHistogram::UpperBoundMs(WBFrameTimeHistogram::bucketCount - 1));
+}
+
+// Every line is a comment or "name{labels} value", and every sample belongs to a declared family
+static bool WellFormed(const std::string& text) {
+	std::istringstream lines(text);
+	std::string line, family;
+	while (std::getline(lines, line)) {
+		if (line.rfind("# TYPE ", 0) == 0) {
+			family = line.substr(7, line.find(' ', 7) - 7);
+			continue;
+		}
+		if (line.rfind("# HELP ", 0) == 0)
+			continue;
+		size_t space = line.rfind(' ');
+		std::string name = line.substr(0, std::min(line.find('{'), space));
+		if (space == std::string::npos || name.rfind(family, 0) != 0 || space + 1 >= line.size())
+			return false;
+		std::string value = line.substr(space + 1);
+		char* end = nullptr;
+		strtod(value.c_str(), &end);
+		if (*end != '\0' && value != "NaN" && value != "+Inf")
+			return false;
+	}
+	return true;
+}
+
+static void TestFormat() {
+	WBMetrics metrics;
+	metrics.messages.Add(3);
+	metrics.resizes.Add();
+	metrics.texturesResident.Set(12);
+	metrics.collectExtra = [](WBPrometheusWriter& out) {
+		out.Counter("wb_tracker_wakeups_total", "Tracker thread wakeups.", 7);
+	};
+	for (int i = 0; i < 4; ++i)
+		metrics.FrameFinished(i != 2);
+
+	std::string text;
+	WBPrometheusWriter writer(text);
+	metrics.Write(writer);
+	CHECK(WellFormed(text));
+	CHECK(text.find("# TYPE wb_frames_rendered_total counter\nwb_frames_rendered_total 4\n") != std::string::npos);
+	CHECK(text.find("wb_frames_skipped_total 1\n") != std::string::npos);
+	CHECK(text.find("wb_presents_total 3\n") != std::string::npos);
+	CHECK(text.find("wb_messages_total 3\n") != std::string::npos);
+	CHECK(text.find("wb_textures_resident 12\n") != std::string::npos);
+	CHECK(text.find("wb_frame_time_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+	CHECK(text.find("wb_frame_time_seconds_count 3\n") != std::string::npos);
+	CHECK(text.find("wb_tracker_wakeups_total 7\n") != std::string::npos);
+
+	// Recent quantiles only cover frames since the previous scrape
+	text.clear();
+	metrics.Write(writer);
+	CHECK(text.find("wb_frame_time_recent_seconds{quantile=\"0.5\"} NaN\n") != std::string::npos);
+	CHECK(text.find("wb_frame_time_seconds_count 3\n") != std::string::npos);
+}
+
+static std::string ReadAll(int fd) {
+	std::string data;
+	char buffer[4096];
+	ssize_t n;
+	while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+		data.append(buffer, static_cast<size_t>(n));
+	close(fd);
+	return data;
+}
+
+static std::string HttpGet(uint16_t port, const char* path) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		close(fd);
+		return "";
+	}
+	std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+	return ReadAll(fd);
+}
+
+static std::string PipeRead(const std::string& path) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		close(fd);
+		return "";
+	}
+	return ReadAll(fd);
+}
+
+static uint64_t ValueOf(const std::string& text, const std::string& series) {
+	size_t at = text.find("\n" + series + " ");
+	return at == std::string::npos ? 0 : std::stoull(text.substr(at + series.size() + 2));
+}
+
+static void TestExporter() {
+	WBMetrics metrics;
+	WBMetricsExporter exporter([&metrics](std::string& out) {
+		WBPrometheusWriter writer(out);
+		metrics.Write(writer);
+	});
+	CHECK(exporter.ListenTcp(0) && exporter.Port() != 0);
+	const std::string pipe = "/tmp/wb_metrics_test_" + std::to_string(getpid()) + ".sock";
+	CHECK(exporter.ListenPipe(pipe));
+
+	// A render thread counting frames the whole time scrapes run
+	std::atomic<bool> running = true;
+	std::thread render([&] {
+		while (running) {
+			metrics.messages.Add();
+			metrics.FrameFinished(true);
+		}
+	});
+
+	uint64_t previous = 0;
+	for (int i = 0; i < 20; ++i) {
+		std::string response = HttpGet(exporter.Port(), "/metrics");
+		CHECK(response.rfind("HTTP/1.0 200 OK\r\n", 0) == 0);
+		size_t body = response.find("\r\n\r\n");
+		CHECK(body != std::string::npos && WellFormed(response.substr(body + 4)));
+		CHECK(response.find("Content-Length: " + std::to_string(response.size() - body - 4) + "\r\n") != std::string::npos);
+
+		// Counters only move forward
+		uint64_t frames = ValueOf(response, "wb_frames_rendered_total");
+		CHECK(frames >= previous);
+		previous = frames;
+	}
+	running = false;
+	render.join();
+
+	CHECK(HttpGet(exporter.Port(), "/other").rfind("HTTP/1.0 404 Not Found\r\n", 0) == 0);
+
+	std::string piped = PipeRead(pipe);
+	CHECK(WellFormed(piped) && ValueOf(piped, "wb_frames_rendered_total") == metrics.framesRendered.Load());
+	CHECK(exporter.Scrapes() == 21);
+
+	// A client that connects and never sends anything must not keep Stop() waiting forever
+	int idle = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(exporter.Port());
+	CHECK(connect(idle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+
+	uint16_t port = exporter.Port();
+	auto start = std::chrono::steady_clock::now();
+	exporter.Stop();
+	double stopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	close(idle);
+	CHECK(stopMs < 1500.0);
+	CHECK(HttpGet(port, "/metrics").empty());
+	CHECK(access(pipe.c_str(), F_OK) != 0);
+}
+
+// Clients that connect and then never read. The text is larger than the socket buffers, so the
+// exporter blocks in send: Stop() must cut that short, and on its own the send times out.
+static void TestStalledClients() {
+	WBMetricsExporter exporter([](std::string& out) { out.assign(32 * 1024 * 1024, '#'); });
+	CHECK(exporter.ListenTcp(0));
+	const std::string pipe = "/tmp/wb_metrics_stall_" + std::to_string(getpid()) + ".sock";
+	CHECK(exporter.ListenPipe(pipe));
+
+	int http = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(exporter.Port());
+	CHECK(connect(http, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+	const std::string request = "GET /metrics HTTP/1.1\r\n\r\n";
+	CHECK(send(http, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size()));
+
+	int local = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un path = {};
+	path.sun_family = AF_UNIX;
+	memcpy(path.sun_path, pipe.c_str(), pipe.size() + 1);
+	CHECK(connect(local, reinterpret_cast<sockaddr*>(&path), sizeof(path)) == 0);
+
+	// Let both threads fill the buffers and block
+	while (exporter.Scrapes() < 2)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	auto start = std::chrono::steady_clock::now();
+	exporter.Stop();
+	double stopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	close(http);
+	close(local);
+	CHECK(stopMs < WBMetricsExporter::ioTimeoutMs / 2);
+
+	// Without Stop(), a stalled client is given up on and the next one is served
+	CHECK(exporter.ListenPipe(pipe));
+	int stalled = socket(AF_UNIX, SOCK_STREAM, 0);
+	CHECK(connect(stalled, reinterpret_cast<sockaddr*>(&path), sizeof(path)) == 0);
+	start = std::chrono::steady_clock::now();
+	std::string text = PipeRead(pipe);
+	double servedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	close(stalled);
+	CHECK(text.size() == 32u * 1024 * 1024);
+	CHECK(servedMs < 4.0 * WBMetricsExporter::ioTimeoutMs);
+	exporter.Stop();
+}
+
+// Cost of the render thread side
+static void Benchmark() {
+	WBMetrics metrics;
+	const int iterations = 10000000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		metrics.messages.Add();
+	double counterNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		metrics.frameTime.Record(static_cast<uint64_t>(i) * 97 % 40000000);
+	double histogramNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 1000; ++i) {
+		std::string text;
+		WBPrometheusWriter writer(text);
+		metrics.Write(writer);
+	}
+	double scrapeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / 1000;
+
+	std::cout << "counter add " << counterNs << " ns, histogram record " << histogramNs << " ns, format "
+		<< scrapeUs << " us per scrape" << std::endl;
+}
+
+int main(void) {
+	TestHistogram();
+	TestFormat();
+	TestExporter();
+	TestStalledClients();
+	Benchmark();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All metrics tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+// The subset of Dear ImGui's draw data declarations that the portable tests use, for building them
+// on machines without the vcpkg imgui port. It keeps the parts of the real header the code under
+// test depends on: no default ImDrawList constructor, ImDrawData starting with a zero
+// FramebufferScale and zero-filled ImDrawCmd. Functions the real library defines out of line are
+// only declared, so code that needs them fails to link here instead of testing a stand-in.
+// On Windows the tests build against the real header, see README.md.
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wclass-memaccess" // ImDrawCmd zero-fills itself, as in imgui.h
+#endif
+
+typedef unsigned int ImU32;
+typedef unsigned long long ImU64;
+#ifndef ImTextureID
+typedef void* ImTextureID;
+#endif
+#ifndef ImDrawIdx
+typedef unsigned short ImDrawIdx;
+#endif
+
+struct ImVec2 {
+	float x, y;
+	constexpr ImVec2() : x(0.0f), y(0.0f) {}
+	constexpr ImVec2(float x, float y) : x(x), y(y) {}
+};
+
+struct ImVec4 {
+	float x, y, z, w;
+	constexpr ImVec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	constexpr ImVec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+};
+
+// Like ImGui's: for trivially copyable types, grown with realloc
+template<typename T>
+struct ImVector {
+	int Size = 0;
+	int Capacity = 0;
+	T* Data = nullptr;
+
+	ImVector() = default;
+	ImVector(const ImVector& other) { *this = other; }
+	ImVector& operator=(const ImVector& other) {
+		if (this != &other) {
+			resize(other.Size);
+			if (other.Size)
+				memcpy(Data, other.Data, sizeof(T) * other.Size);
+		}
+		return *this;
+	}
+	~ImVector() { free(Data); }
+
+	bool empty() const { return Size == 0; }
+	int size() const { return Size; }
+	T& operator[](int i) { return Data[i]; }
+	const T& operator[](int i) const { return Data[i]; }
+	T* begin() { return Data; }
+	const T* begin() const { return Data; }
+	T* end() { return Data + Size; }
+	const T* end() const { return Data + Size; }
+	T& back() { return Data[Size - 1]; }
+	const T& back() const { return Data[Size - 1]; }
+
+	void clear() { free(Data); Data = nullptr; Size = Capacity = 0; }
+	void reserve(int capacity) {
+		if (capacity <= Capacity)
+			return;
+		Data = static_cast<T*>(realloc(Data, sizeof(T) * capacity));
+		Capacity = capacity;
+	}
+	void resize(int size) {
+		if (size > Capacity)
+			reserve(size > Capacity * 2 ? size : Capacity * 2);
+		Size = size;
+	}
+	void push_back(const T& value) {
+		if (Size == Capacity)
+			reserve(Capacity ? Capacity * 2 : 8);
+		memcpy(&Data[Size++], &value, sizeof(T));
+	}
+};
+
+struct ImDrawVert {
+	ImVec2 pos;
+	ImVec2 uv;
+	ImU32 col;
+};
+
+struct ImDrawList;
+struct ImDrawCmd;
+struct ImDrawListSharedData;
+typedef void (*ImDrawCallback)(const ImDrawList* parent_list, const ImDrawCmd* cmd);
+#define ImDrawCallback_ResetRenderState (ImDrawCallback)(-8)
+
+struct ImDrawCmd {
+	ImVec4 ClipRect;
+	ImTextureID TextureId;
+	unsigned int VtxOffset;
+	unsigned int IdxOffset;
+	unsigned int ElemCount;
+	ImDrawCallback UserCallback;
+	void* UserCallbackData;
+
+	ImDrawCmd() { memset(this, 0, sizeof(*this)); }
+	ImTextureID GetTexID() const { return TextureId; }
+};
+
+struct ImDrawList {
+	ImVector<ImDrawCmd> CmdBuffer;
+	ImVector<ImDrawIdx> IdxBuffer;
+	ImVector<ImDrawVert> VtxBuffer;
+	ImDrawListSharedData* _Data;
+
+	ImDrawList(ImDrawListSharedData* shared_data) : _Data(shared_data) {}
+	ImDrawList(const ImDrawList&) = delete;
+	ImDrawList& operator=(const ImDrawList&) = delete;
+};
+
+struct ImDrawData {
+	bool Valid;
+	int CmdListsCount;
+	int TotalIdxCount;
+	int TotalVtxCount;
+	ImVector<ImDrawList*> CmdLists;
+	ImVec2 DisplayPos;
+	ImVec2 DisplaySize;
+	ImVec2 FramebufferScale;
+
+	ImDrawData() { Clear(); }
+	void Clear() {
+		Valid = false;
+		CmdListsCount = TotalIdxCount = TotalVtxCount = 0;
+		CmdLists.resize(0);
+		DisplayPos = DisplaySize = FramebufferScale = ImVec2(0.0f, 0.0f);
+	}
+};
+
+struct ImFontAtlas {
+	void GetTexDataAsRGBA32(unsigned char** out_pixels, int* out_width, int* out_height, int* out_bytes_per_pixel = nullptr);
+	void SetTexID(ImTextureID id);
+};
@@ -0,0 +1,322 @@
+#include "windowbuilder_softraster.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <memory>
+
+// Renders hand-built draw data with WBSoftRasterizer and checks it against expected pixels and a
+// per-pixel reference renderer, within a tolerance: pixel-center coverage, blending, texturing,
+// clipping, the quad and triangle paths, and identical output for any thread count. Ends with a
+// throughput run on a UI-sized frame.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+static const ImTextureID textureId = (ImTextureID)1;
+
+// Rectangle from (x0, y0) to (x1, y1), as ImGui emits it (asQuad) or with an index order the quad path does not take
+static void AddRect(ImDrawList& list, float x0, float y0, float x1, float y1, ImU32 col,
+	float u0 = 0.0f, float v0 = 0.0f, float u1 = 0.0f, float v1 = 0.0f, bool asQuad = true) {
+	ImDrawIdx base = static_cast<ImDrawIdx>(list.VtxBuffer.Size);
+	list.VtxBuffer.push_back(ImDrawVert{ ImVec2(x0, y0), ImVec2(u0, v0), col });
+	list.VtxBuffer.push_back(ImDrawVert{ ImVec2(x1, y0), ImVec2(u1, v0), col });
+	list.VtxBuffer.push_back(ImDrawVert{ ImVec2(x1, y1), ImVec2(u1, v1), col });
+	list.VtxBuffer.push_back(ImDrawVert{ ImVec2(x0, y1), ImVec2(u0, v1), col });
+	static const ImDrawIdx quad[6] = { 0, 1, 2, 0, 2, 3 }, triangles[6] = { 0, 1, 2, 2, 3, 0 };
+	for (int i = 0; i < 6; ++i)
+		list.IdxBuffer.push_back(static_cast<ImDrawIdx>(base + (asQuad ? quad[i] : triangles[i])));
+}
+
+// Puts everything in the list into one command and appends it to the draw data. ImDrawData
+// starts out with a zero framebuffer scale, which would collapse every vertex and clip rect.
+static void Finish(ImDrawData& data, ImDrawList& list, ImVec4 clip, int width, int height) {
+	ImDrawCmd cmd;
+	cmd.ClipRect = clip;
+	cmd.TextureId = textureId;
+	cmd.ElemCount = static_cast<unsigned>(list.IdxBuffer.Size);
+	list.CmdBuffer.push_back(cmd);
+	data.CmdLists.push_back(&list);
+	data.CmdListsCount++;
+	data.TotalVtxCount += list.VtxBuffer.Size;
+	data.TotalIdxCount += list.IdxBuffer.Size;
+	data.Valid = true;
+	data.DisplaySize = ImVec2(static_cast<float>(width), static_cast<float>(height));
+	data.FramebufferScale = ImVec2(1.0f, 1.0f);
+}
+
+static const uint8_t* Pixel(const WBSoftRasterizer& raster, int x, int y) {
+	return raster.GetPixels() + (static_cast<size_t>(y) * raster.GetWidth() + x) * 4;
+}
+
+static bool PixelIs(const WBSoftRasterizer& raster, int x, int y, int r, int g, int b, int a, int tolerance = 0) {
+	const uint8_t* p = Pixel(raster, x, y);
+	return std::abs(p[0] - r) <= tolerance && std::abs(p[1] - g) <= tolerance
+		&& std::abs(p[2] - b) <= tolerance && std::abs(p[3] - a) <= tolerance;
+}
+
+// Straight alpha over, in floating point, as the GPU blender computes it
+static void Over(uint8_t* dst, const float src[4]) {
+	float a = src[3] / 255.0f;
+	for (int c = 0; c < 3; ++c)
+		dst[c] = static_cast<uint8_t>(src[c] * a + dst[c] * (1.0f - a) + 0.5f);
+	dst[3] = static_cast<uint8_t>(src[3] + dst[3] * (1.0f - a) + 0.5f);
+}
+
+struct RefRect {
+	float x0, y0, x1, y1, u0, v0, u1, v1;
+	ImU32 col;
+};
+
+// Reference renderer: for every pixel center inside a rect, in order, sample the texel under it and blend
+static std::vector<uint8_t> Reference(const std::vector<RefRect>& rects, const WBSoftTexture& texture,
+	int width, int height, uint32_t clearValue) {
+	std::vector<uint8_t> out(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < out.size(); i += 4)
+		memcpy(&out[i], &clearValue, 4);
+	for (const RefRect& rect : rects) {
+		for (int y = 0; y < height; ++y) {
+			float py = y + 0.5f;
+			if (py < rect.y0 || py >= rect.y1)
+				continue;
+			for (int x = 0; x < width; ++x) {
+				float px = x + 0.5f;
+				if (px < rect.x0 || px >= rect.x1)
+					continue;
+				float u = rect.u0 + (px - rect.x0) / (rect.x1 - rect.x0) * (rect.u1 - rect.u0);
+				float v = rect.v0 + (py - rect.y0) / (rect.y1 - rect.y0) * (rect.v1 - rect.v0);
+				int tx = std::clamp(static_cast<int>(u * texture.width), 0, texture.width - 1);
+				int ty = std::clamp(static_cast<int>(v * texture.height), 0, texture.height - 1);
+				const uint8_t* texel = texture.pixels + (static_cast<size_t>(ty) * texture.width + tx) * 4;
+				float src[4];
+				for (int c = 0; c < 4; ++c)
+					src[c] = texel[c] * ((rect.col >> (c * 8)) & 0xFF) / 255.0f;
+				Over(&out[(static_cast<size_t>(y) * width + x) * 4], src);
+			}
+		}
+	}
+	return out;
+}
+
+static void TestBlendSpan() {
+	// SIMD widths and the scalar tail agree with the float blend to within rounding
+	std::mt19937 rng(1);
+	for (int iteration = 0; iteration < 2000; ++iteration) {
+		int count = 1 + static_cast<int>(rng() % 40);
+		std::vector<uint8_t> span(count * 4);
+		for (uint8_t& byte : span)
+			byte = static_cast<uint8_t>(rng());
+		std::vector<uint8_t> expected = span;
+		uint8_t r = static_cast<uint8_t>(rng()), g = static_cast<uint8_t>(rng()), b = static_cast<uint8_t>(rng()),
+			a = static_cast<uint8_t>(rng());
+		WBSoftRasterizer::BlendSpan(span.data(), count, r, g, b, a);
+		float src[4] = { float(r), float(g), float(b), float(a) };
+		if (a != 0)
+			for (int i = 0; i < count; ++i)
+				Over(&expected[i * 4], src);
+		CHECK(WBCompareImages(span.data(), expected.data(), count, 1, 1).pixelsOver == 0);
+	}
+}
+
+static void TestGolden() {
+	WBSoftRasterizer raster(1);
+	raster.Resize(64, 48);
+	raster.SetTexture(textureId, {}); // No pixels: sampled as white
+
+	// Opaque rect on pixel edges covers exactly the pixels inside, and stats count it as one quad
+	{
+		ImDrawList list(nullptr);
+		ImDrawData data;
+		AddRect(list, 10.0f, 5.0f, 20.0f, 15.0f, 0xFF0000FFu); // Red
+		Finish(data, list, ImVec4(0, 0, 64, 48), 64, 48);
+		raster.Clear({ 0.0f, 0.0f, 0.0f, 1.0f });
+		raster.Render(&data);
+		CHECK(PixelIs(raster, 10, 5, 255, 0, 0, 255) && PixelIs(raster, 19, 14, 255, 0, 0, 255));
+		CHECK(PixelIs(raster, 9, 5, 0, 0, 0, 255) && PixelIs(raster, 20, 14, 0, 0, 0, 255));
+		CHECK(PixelIs(raster, 10, 4, 0, 0, 0, 255) && PixelIs(raster, 10, 15, 0, 0, 0, 255));
+		CHECK(raster.GetStats().quads == 1 && raster.GetStats().triangles == 0 && raster.GetStats().pixels == 100);
+	}
+
+	// Half-pixel edges: a pixel is covered when its center is inside [x0, x1)
+	{
+		ImDrawList list(nullptr);
+		ImDrawData data;
+		AddRect(list, 2.5f, 2.5f, 4.5f, 3.6f, 0xFFFFFFFFu);
+		Finish(data, list, ImVec4(0, 0, 64, 48), 64, 48);
+		raster.Clear({ 0.0f, 0.0f, 0.0f, 0.0f });
+		raster.Render(&data);
+		CHECK(PixelIs(raster, 2, 2, 255, 255, 255, 255) && PixelIs(raster, 3, 3, 255, 255, 255, 255));
+		CHECK(PixelIs(raster, 4, 2, 0, 0, 0, 0) && PixelIs(raster, 2, 4, 0, 0, 0, 0) && PixelIs(raster, 1, 2, 0, 0, 0, 0));
+		CHECK(raster.GetStats().pixels == 4);
+	}
+
+	// Translucent over translucent: later primitives go on top, straight alpha
+	{
+		ImDrawList list(nullptr);
+		ImDrawData data;
+		AddRect(list, 0.0f, 0.0f, 8.0f, 8.0f, 0x8000FF00u);   // Green, alpha 128
+		AddRect(list, 4.0f, 0.0f, 12.0f, 8.0f, 0x40FF0000u);  // Blue, alpha 64
+		Finish(data, list, ImVec4(0, 0, 64, 48), 64, 48);
+		raster.Clear({ 1.0f, 0.0f, 0.0f, 1.0f });
+		raster.Render(&data);
+		CHECK(PixelIs(raster, 1, 1, 127, 128, 0, 255, 1));
+		CHECK(PixelIs(raster, 5, 1, 95, 96, 64, 255, 1));
+		CHECK(PixelIs(raster, 9, 1, 191, 0, 64, 255, 1));
+	}
+
+	// Clip rect truncates like the DX11 scissor
+	{
+		ImDrawList list(nullptr);
+		ImDrawData data;
+		AddRect(list, 0.0f, 0.0f, 64.0f, 48.0f, 0xFFFFFFFFu);
+		Finish(data, list, ImVec4(8.7f, 4.2f, 16.9f, 10.0f), 64, 48);
+		raster.Clear({ 0.0f, 0.0f, 0.0f, 1.0f });
+		raster.Render(&data);
+		CHECK(PixelIs(raster, 8, 4, 255, 255, 255, 255) && PixelIs(raster, 15, 9, 255, 255, 255, 255));
+		CHECK(PixelIs(raster, 7, 4, 0, 0, 0, 255) && PixelIs(raster, 16, 9, 0, 0, 0, 255) && PixelIs(raster, 8, 10, 0, 0, 0, 255));
+		CHECK(raster.GetStats().pixels == 8 * 6);
+	}
+
+	// A 2x2 texture stretched over 8x8 shows four 4x4 blocks, tinted by the vertex color
+	{
+		const uint8_t checker[16] = {
+			255, 0, 0, 255,   0, 255, 0, 255,
+			0, 0, 255, 255,   255, 255, 255, 0 };
+		raster.SetTexture(textureId, { 2, 2, checker });
+		ImDrawList list(nullptr);
+		ImDrawData data;
+		AddRect(list, 16.0f, 16.0f, 24.0f, 24.0f, 0xFF80FFFFu, 0.0f, 0.0f, 1.0f, 1.0f);
+		Finish(data, list, ImVec4(0, 0, 64, 48), 64, 48);
+		raster.Clear({ 0.0f, 0.0f, 0.0f, 1.0f });
+		raster.Render(&data);
+		CHECK(PixelIs(raster, 16, 16, 255, 0, 0, 255) && PixelIs(raster, 19, 19, 255, 0, 0, 255));
+		CHECK(PixelIs(raster, 20, 16, 0, 255, 0, 255) && PixelIs(raster, 23, 19, 0, 255, 0, 255));
+		CHECK(PixelIs(raster, 16, 20, 0, 0, 128, 255, 1));
+		CHECK(PixelIs(raster, 23, 23, 0, 0, 0, 255)); // Transparent texel leaves the clear color
+	}
+}
+
+// Random rects in the proportions of a UI frame: mostly small glyph-sized ones, some panels
+static std::vector<RefRect> RandomRects(int count, int width, int height, int textureSize, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::vector<RefRect> rects;
+	for (int i = 0; i < count; ++i) {
+		float x = static_cast<float>(rng() % width), y = static_cast<float>(rng() % height);
+		float w = static_cast<float>(4 + rng() % (i % 10 == 0 ? 300 : 16));
+		float h = static_cast<float>(4 + rng() % (i % 10 == 0 ? 200 : 16));
+		ImU32 col = static_cast<ImU32>(rng()) | 0x80000000u;
+		if (i % 3 == 0)
+			rects.push_back({ x, y, x + w, y + h, 0.0f, 0.0f, 0.0f, 0.0f, col });
+		else
+			rects.push_back({ x, y, x + w, y + h, 0.1f, 0.1f, 0.1f + w / textureSize, 0.1f + h / textureSize, col });
+	}
+	return rects;
+}
+
+static void BuildList(ImDrawList& list, const std::vector<RefRect>& rects, bool asQuads) {
+	for (const RefRect& r : rects)
+		AddRect(list, r.x0, r.y0, r.x1, r.y1, r.col, r.u0, r.v0, r.u1, r.v1, asQuads);
+}
+
+static std::vector<uint8_t> MakeTexture(int size) {
+	std::vector<uint8_t> texture(static_cast<size_t>(size) * size * 4);
+	for (int i = 0; i < size * size; ++i) {
+		texture[i * 4] = static_cast<uint8_t>(i * 7);
+		texture[i * 4 + 1] = static_cast<uint8_t>(i * 13);
+		texture[i * 4 + 2] = 255;
+		texture[i * 4 + 3] = static_cast<uint8_t>((i % 7) * 40);
+	}
+	return texture;
+}
+
+static void TestAgainstReference() {
+	const int width = 320, height = 200, textureSize = 64;
+	std::vector<uint8_t> texels = MakeTexture(textureSize);
+	const WBSoftTexture texture = { textureSize, textureSize, texels.data() };
+	std::vector<RefRect> rects = RandomRects(600, width, height, textureSize, 3);
+	const std::array<float, 4> clear = { 0.2f, 0.4f, 0.6f, 1.0f };
+	const uint32_t clearValue = 51 | 102 << 8 | 153 << 16 | 0xFF000000u;
+	std::vector<uint8_t> expected = Reference(rects, texture, width, height, clearValue);
+
+	std::vector<uint8_t> quadPixels;
+	for (bool asQuads : { true, false }) {
+		std::vector<uint8_t> firstOfPath;
+		for (int threads : { 1, 3, 8 }) {
+			ImDrawList list(nullptr);
+			ImDrawData data;
+			BuildList(list, rects, asQuads);
+			Finish(data, list, ImVec4(0, 0, float(width), float(height)), width, height);
+			WBSoftRasterizer raster(threads);
+			raster.Resize(width, height);
+			raster.SetTexture(textureId, texture);
+			raster.Clear(clear);
+			raster.Render(&data);
+			CHECK(raster.GetStats().quads == (asQuads ? rects.size() : 0));
+			CHECK(raster.GetStats().triangles == (asQuads ? 0 : rects.size() * 2));
+
+			// Rounding differs by one step per blend; texel lookups may land on the neighbour where
+			// the reference and the incremental or barycentric uv disagree at a texel boundary
+			WBImageDiff diff = WBCompareImages(raster.GetPixels(), expected.data(), width, height, 4);
+			CHECK(diff.pixelsOver * 200 < static_cast<size_t>(width) * height);
+
+			// Thread count never changes a single byte
+			std::vector<uint8_t> pixels(raster.GetPixels(), raster.GetPixels() + expected.size());
+			if (firstOfPath.empty())
+				firstOfPath = pixels;
+			CHECK(WBCompareImages(pixels.data(), firstOfPath.data(), width, height, 0).maxDelta == 0);
+
+			// Both paths draw the same image
+			if (asQuads)
+				quadPixels = pixels;
+			else
+				CHECK(WBCompareImages(pixels.data(), quadPixels.data(), width, height, 4).pixelsOver * 200
+					< static_cast<size_t>(width) * height);
+		}
+	}
+}
+
+static void Benchmark() {
+	const int width = 1920, height = 1080, textureSize = 64;
+	std::vector<uint8_t> texels = MakeTexture(textureSize);
+	std::vector<RefRect> rects = RandomRects(20000, width, height, textureSize, 7);
+	for (bool asQuads : { true, false }) {
+		// In lists of up to 16k rects, so 16-bit indices reach every vertex
+		std::vector<std::unique_ptr<ImDrawList>> lists;
+		ImDrawData data;
+		for (size_t first = 0; first < rects.size(); first += 16000) {
+			lists.push_back(std::make_unique<ImDrawList>(nullptr));
+			BuildList(*lists.back(), std::vector<RefRect>(rects.begin() + first,
+				rects.begin() + std::min(rects.size(), first + 16000)), asQuads);
+			Finish(data, *lists.back(), ImVec4(0, 0, float(width), float(height)), width, height);
+		}
+		for (int threads : { 1, 0 }) {
+			WBSoftRasterizer raster(threads);
+			raster.Resize(width, height);
+			raster.SetTexture(textureId, { textureSize, textureSize, texels.data() });
+			double best = 1e9;
+			for (int run = 0; run < 5; ++run) {
+				raster.Clear({ 0.1f, 0.2f, 0.3f, 1.0f });
+				raster.Render(&data);
+				best = std::min(best, raster.GetStats().milliseconds);
+			}
+			std::cout << (asQuads ? "quad path" : "triangle path") << ", "
+				<< (threads ? 1u : std::max(1u, std::thread::hardware_concurrency())) << " thread(s): "
+				<< best << " ms, " << raster.GetStats().pixels / best / 1000.0 << " Mpix/s" << std::endl;
+		}
+	}
+}
+
+int main(void) {
+	TestBlendSpan();
+	TestGolden();
+	TestAgainstReference();
+	Benchmark();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All software rasterizer tests passed" << std::endl;
+	return 0;
+}
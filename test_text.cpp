@@ -0,0 +1,317 @@
+#define WB_TEXT_RUN_KEY_BITS 8 // 256 run cache keys, so hundreds of strings are bound to collide
+#include "windowbuilder_text.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Drives WBTextSystem with a synthetic glyph source: distance field values around the 128 edge,
+// shelf reclaiming that spares shelves used or filled this frame, evicted glyphs going ahead of
+// new ones, the retry delay for glyphs that found no room, run cache collisions, and the hit
+// rates and generation throughput reported by GetStats().
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+// Every glyph is a solid box of the same size, so each one takes the same atlas space. Logs the
+// order glyphs are rasterized in, and can hold the worker inside Rasterize for one codepoint.
+class BoxGlyphSource : public WBGlyphSource {
+public:
+	struct Log {
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::vector<uint32_t> rasterized;
+		uint32_t holdCodepoint = 0;
+		bool holding = false;
+		bool released = false;
+
+		size_t Count(uint32_t codepoint) {
+			std::lock_guard<std::mutex> lock(mutex);
+			return std::count(rasterized.begin(), rasterized.end(), codepoint);
+		}
+	};
+
+	BoxGlyphSource(Log& log, int box) : log(log), box(box) {}
+
+	float Advance(uint32_t, int pixelSize) override { return pixelSize * 0.5f; }
+	float LineHeight(int pixelSize) override { return pixelSize * 1.25f; }
+	float Ascent(int pixelSize) override { return pixelSize * 1.0f; }
+
+	bool Rasterize(uint32_t codepoint, int, WBGlyphBitmap& out) override {
+		std::unique_lock<std::mutex> lock(log.mutex);
+		log.rasterized.push_back(codepoint);
+		if (codepoint == log.holdCodepoint) {
+			log.holding = true;
+			log.changed.notify_all();
+			log.changed.wait(lock, [&] { return log.released; });
+		}
+		if (codepoint == ' ')
+			return false;
+		out.width = out.height = box;
+		out.left = 0.0f;
+		out.top = static_cast<float>(box);
+		out.coverage.assign(size_t(box) * box, 255);
+		return true;
+	}
+
+private:
+	Log& log;
+	int box;
+};
+
+// Draws a string and counts the quads, i.e. the glyphs that were resident
+static int Visible(WBTextSystem& text, WBTextSystem::FontId font, const std::string& string) {
+	int quads = 0;
+	text.Draw(font, string, 0.0f, 0.0f, 16.0f, [&](const WBGlyphQuad&) { ++quads; });
+	return quads;
+}
+
+// Runs frames drawing every string until all of them are fully resident, or gives up
+static bool Settle(WBTextSystem& text, WBTextSystem::FontId font, const std::vector<std::string>& strings, int maxFrames = 2000) {
+	for (int i = 0; i < maxFrames; ++i) {
+		text.Update();
+		bool all = true;
+		for (const std::string& string : strings)
+			all = Visible(text, font, string) == static_cast<int>(string.size()) && all;
+		if (all)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+static void TestEdgeValues() {
+	// A vertical edge: solid left half, one half-covered column, empty right half
+	WBGlyphBitmap bitmap;
+	bitmap.width = 16;
+	bitmap.height = 4;
+	bitmap.coverage.assign(16 * 4, 0);
+	for (int y = 0; y < 4; ++y) {
+		for (int x = 0; x < 8; ++x)
+			bitmap.coverage[y * 16 + x] = 255;
+		bitmap.coverage[y * 16 + 8] = 128;
+	}
+	int width = 0, height = 0;
+	std::vector<uint8_t> sdf = WBGenerateSDF(bitmap, 1, 4, width, height);
+	CHECK(width == 16 + 8 && height == 4 + 8);
+	const uint8_t* row = sdf.data() + size_t(height / 2) * width;
+	CHECK(std::abs(row[4 + 8] - 128) <= 1);            // The half-covered column is the edge
+	CHECK(row[4 + 7] > 128 && row[4 + 9] < 128);       // Inside above, outside below
+	CHECK(std::abs((row[4 + 7] - 128) - (128 - row[4 + 9])) <= 2); // Symmetric around it
+	for (int x = 4 + 5; x < width; ++x)
+		CHECK(row[x] <= row[x - 1]);                   // Falls monotonically across the edge
+	CHECK(row[4 + 4] > row[4 + 7]);                    // Deeper inside is further above 128
+	CHECK(row[0] < 5 && row[width - 1] < 5);           // The padding is outside, clamped at the spread
+
+	// One step per output pixel is 127 / spread
+	CHECK(std::abs((row[4 + 7] - row[4 + 9]) - 2 * 127 / 4) <= 3);
+
+	// Oversampled: a 16x16 box at 2x gives an 8x8 box with the edge halfway between output pixels
+	WBGlyphBitmap box;
+	box.width = box.height = 16;
+	box.coverage.assign(256, 255);
+	std::vector<uint8_t> small = WBGenerateSDF(box, 2, 2, width, height);
+	CHECK(width == 12 && height == 12);
+	const uint8_t* middle = small.data() + size_t(6) * width;
+	CHECK(middle[1] < 128 && middle[2] > 128);          // Output pixel 2 is the first inside the box
+	CHECK(std::abs((middle[2] + middle[1]) / 2 - 128) <= 2);
+	CHECK(middle[6] == 255 || middle[6] > middle[2]);
+}
+
+static void TestShelfEviction() {
+	// Two 16-high shelves in a 32x32 atlas
+	WBShelfAtlas atlas(32, 32);
+	WBShelfAtlas::Rect rect;
+	CHECK(atlas.Allocate(15, 16, 1, 1, rect) == 0);
+	CHECK(atlas.Allocate(15, 16, 1, 1, rect) == 0 && rect.x == 16); // Same shelf, one pixel of gutter
+	CHECK(atlas.Allocate(15, 16, 1, 1, rect) == 1 && rect.y == 16);
+	CHECK(atlas.Allocate(15, 16, 1, 1, rect) == 1);
+	CHECK(atlas.Allocate(15, 16, 1, 1, rect) == -1);   // Full
+
+	// Both shelves were filled this frame: nothing can go
+	CHECK(atlas.EvictLeastRecentlyUsed(16, 1) == -1);
+
+	// Next frame shelf 1 is used, so shelf 0 is the only candidate
+	atlas.Touch(1, 2);
+	CHECK(atlas.EvictLeastRecentlyUsed(16, 2) == 0);
+	CHECK(atlas.Allocate(15, 16, 2, 2, rect) == 0 && rect.x == 0 && rect.y == 0);
+
+	// Now shelf 0 was filled and shelf 1 used this frame
+	CHECK(atlas.EvictLeastRecentlyUsed(16, 2) == -1);
+
+	// Frame 3: the older of the two goes first, and shelves too short are never candidates
+	atlas.Touch(0, 3);
+	CHECK(atlas.EvictLeastRecentlyUsed(16, 4) == 1);
+	CHECK(atlas.EvictLeastRecentlyUsed(20, 4) == -1);
+}
+
+static void TestTextSystem() {
+	BoxGlyphSource::Log log;
+	WBTextConfig config;
+	config.atlasSize = 64;   // Four 16-high shelves of three 16x16 fields: twelve glyphs
+	config.glyphSize = 8;
+	config.spread = 4;
+	config.oversample = 1;
+	config.workerThreads = 1;
+	config.retryFrames = 20;
+	config.maxRuns = 64;
+	WBTextSystem text(config);
+	WBTextSystem::FontId font = text.AddFont(std::make_unique<BoxGlyphSource>(log, 8));
+
+	// Twelve glyphs fill the atlas exactly
+	const std::string first = "ABCDEFGHIJKL";
+	CHECK(Settle(text, font, { first }));
+	WBTextStats stats = text.GetStats();
+	CHECK(stats.evictedShelves == 0 && stats.glyphsGenerated == 12);
+
+	// While all of them are drawn every frame, new glyphs find no room and nothing is evicted
+	const std::string second = "mnopqr";
+	for (int frame = 0; frame < 60; ++frame) {
+		text.Update();
+		CHECK(Visible(text, font, first) == 12);
+		Visible(text, font, second);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	stats = text.GetStats();
+	CHECK(stats.evictedShelves == 0 && stats.unplacedGlyphs >= 6);
+
+	// And a glyph that found no room is generated again only every retryFrames, not every frame
+	CHECK(log.Count('m') >= 2 && log.Count('m') <= size_t(60 / config.retryFrames + 2));
+
+	// Once the first string goes out of use its shelves are reclaimed for the second
+	CHECK(Settle(text, font, { second }));
+	stats = text.GetStats();
+	CHECK(stats.evictedShelves >= 2 && stats.evictedGlyphs >= 6);
+
+	// Evicted glyphs go ahead of first-time requests. Hold the worker in 'Z', queue new glyphs,
+	// then ask for the evicted ones again.
+	{
+		std::lock_guard<std::mutex> lock(log.mutex);
+		log.holdCodepoint = 'Z';
+	}
+	Visible(text, font, "Z");
+	{
+		std::unique_lock<std::mutex> lock(log.mutex);
+		log.changed.wait(lock, [&] { return log.holding; });
+	}
+	text.Update();
+	Visible(text, font, "stuvwx");
+	Visible(text, font, first);
+	size_t before, evictedCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(log.mutex);
+		before = log.rasterized.size();
+		log.released = true;
+	}
+	log.changed.notify_all();
+	for (int i = 0; i < 2000; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::lock_guard<std::mutex> lock(log.mutex);
+		if (std::count(log.rasterized.begin() + before, log.rasterized.end(), 'x'))
+			break;
+	}
+	{
+		std::lock_guard<std::mutex> lock(log.mutex);
+		std::vector<uint32_t> order(log.rasterized.begin() + before, log.rasterized.end());
+		size_t firstNew = order.size();
+		for (size_t i = 0; i < order.size(); ++i)
+			if (order[i] >= 's' && order[i] <= 'x') {
+				firstNew = i;
+				break;
+			}
+		for (size_t i = 0; i < order.size(); ++i) {
+			if (order[i] >= 'A' && order[i] <= 'L') {
+				++evictedCount;
+				CHECK(i < firstNew);
+			}
+		}
+	}
+	CHECK(evictedCount >= 6);
+	Settle(text, font, { "Z" });
+}
+
+static void TestRunCache() {
+	BoxGlyphSource::Log log;
+	WBTextConfig config;
+	config.maxRuns = 1024;
+	WBTextSystem text(config);
+	WBTextSystem::FontId font = text.AddFont(std::make_unique<BoxGlyphSource>(log, 12));
+	WBTextSystem::FontId other = text.AddFont(std::make_unique<BoxGlyphSource>(log, 12));
+
+	// 600 strings on 256 keys: colliding strings replace each other, but each still lays out as itself
+	std::vector<std::string> strings;
+	for (int i = 0; i < 600; ++i)
+		strings.push_back(std::string(size_t(i % 40 + 1), 'a') + std::to_string(i));
+	for (int pass = 0; pass < 3; ++pass)
+		for (const std::string& string : strings)
+			CHECK(text.Measure(font, string, 8.0f).first == string.size() * 4.0f);
+	WBTextStats stats = text.GetStats();
+	CHECK(stats.runMisses > 600 && stats.runHits > 0); // Collisions were hit, and some keys only held one string
+
+	// The same text in another font is another run, even on the same key
+	CHECK(text.Measure(other, "ab\ncd", 16.0f).second == 40.0f);
+	CHECK(text.Measure(font, "ab\ncd", 16.0f).second == 40.0f);
+
+	// A repeated string is a hit
+	uint64_t hits = text.GetStats().runHits;
+	text.Measure(font, "ab\ncd", 16.0f);
+	text.Measure(font, "ab\ncd", 16.0f);
+	CHECK(text.GetStats().runHits == hits + 2);
+}
+
+static void TestStats() {
+	BoxGlyphSource::Log log;
+	WBTextConfig config;
+	WBTextSystem text(config);
+	WBTextSystem::FontId font = text.AddFont(std::make_unique<BoxGlyphSource>(log, 48));
+
+	// Every printable ASCII glyph, then the same labels for a while
+	std::string all;
+	for (char c = '!'; c <= '~'; ++c)
+		all += c;
+	const std::vector<std::string> labels = { all, "Target 42m", "Waypoint 7" };
+	CHECK(Settle(text, font, { all }));
+	while (text.GetStats().glyphsGenerated < 95) { // The space has no outline and never becomes resident
+		text.Update();
+		for (const std::string& label : labels)
+			Visible(text, font, label);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Once everything is resident, every run and every glyph is a hit
+	const WBTextStats warm = text.GetStats();
+	const int frames = 1000;
+	for (int frame = 0; frame < frames; ++frame) {
+		text.Update();
+		for (const std::string& label : labels)
+			Visible(text, font, label);
+	}
+	WBTextStats stats = text.GetStats();
+	CHECK(stats.runHits - warm.runHits == uint64_t(frames) * labels.size() && stats.runMisses == warm.runMisses);
+	CHECK(stats.glyphHits - warm.glyphHits == uint64_t(frames) * (94 + 9 + 9) && stats.glyphMisses == warm.glyphMisses);
+	CHECK(stats.RunHitRate() > 0.99 && stats.GlyphHitRate() > warm.GlyphHitRate());
+	CHECK(stats.glyphsGenerated == 95 && stats.GlyphsPerSecond() > 0.0);
+	std::cout << "run hit rate " << stats.RunHitRate() << ", glyph hit rate " << stats.GlyphHitRate()
+		<< " including warm-up, " << stats.glyphsGenerated << " glyphs generated at " << stats.GlyphsPerSecond()
+		<< " glyphs/s per worker (48 px boxes, 2x oversampled)" << std::endl;
+}
+
+int main(void) {
+	TestEdgeValues();
+	TestShelfEviction();
+	TestTextSystem();
+	TestRunCache();
+	TestStats();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All text tests passed" << std::endl;
+	return 0;
+}
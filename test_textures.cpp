@@ -0,0 +1,258 @@
+#include "windowbuilder_textures.h"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <set>
+
+// Runs the texture cache against a fake backend: the BMP decoder and its bounds checks, uploads
+// capped per frame, deduplication, budget eviction, failed loads and retries, and the placeholder.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+// Hands out numbered handles and remembers what was uploaded
+class FakeBackend : public WBTextureBackend {
+public:
+	struct Log {
+		std::vector<WBImage> uploads;
+		std::set<uintptr_t> live;
+		bool failUploads = false;
+	};
+
+	explicit FakeBackend(Log& log) : log(log) {}
+
+	void* Upload(const WBImage& image) override {
+		if (log.failUploads)
+			return nullptr;
+		log.uploads.push_back(image);
+		uintptr_t handle = log.uploads.size();
+		log.live.insert(handle);
+		return reinterpret_cast<void*>(handle);
+	}
+
+	void Release(void* handle) override {
+		log.live.erase(reinterpret_cast<uintptr_t>(handle));
+	}
+
+private:
+	Log& log;
+};
+
+static void Put16(std::vector<uint8_t>& out, size_t at, uint32_t v) {
+	out[at] = static_cast<uint8_t>(v);
+	out[at + 1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void Put32(std::vector<uint8_t>& out, size_t at, uint32_t v) {
+	Put16(out, at, v & 0xFFFF);
+	Put16(out, at + 2, v >> 16);
+}
+
+// Builds a BMP whose pixel (x, y) from the top is color(x, y) as a raw 24/32-bit little-endian value
+template<typename Color>
+static std::vector<uint8_t> MakeBMP(int width, int height, int bpp, bool topDown, Color color,
+	uint32_t compression = 0, const std::vector<uint32_t>& masks = {}) {
+	const uint32_t headerSize = masks.size() >= 4 ? 108 : 40;
+	const uint32_t offset = 14 + headerSize + (headerSize == 40 ? static_cast<uint32_t>(masks.size()) * 4 : 0);
+	const size_t stride = (static_cast<size_t>(width) * bpp / 8 + 3) & ~size_t(3);
+	std::vector<uint8_t> out(offset + stride * height);
+	out[0] = 'B';
+	out[1] = 'M';
+	Put32(out, 2, static_cast<uint32_t>(out.size()));
+	Put32(out, 10, offset);
+	Put32(out, 14, headerSize);
+	Put32(out, 18, static_cast<uint32_t>(width));
+	Put32(out, 22, static_cast<uint32_t>(topDown ? -height : height));
+	Put16(out, 26, 1);
+	Put16(out, 28, static_cast<uint32_t>(bpp));
+	Put32(out, 30, compression);
+	for (size_t i = 0; i < masks.size(); ++i)
+		Put32(out, 54 + i * 4, masks[i]);
+	for (int y = 0; y < height; ++y) {
+		size_t row = offset + stride * (topDown ? y : height - 1 - y);
+		for (int x = 0; x < width; ++x) {
+			uint32_t value = color(x, y);
+			for (int b = 0; b < bpp / 8; ++b)
+				out[row + x * (bpp / 8) + b] = static_cast<uint8_t>(value >> (8 * b));
+		}
+	}
+	return out;
+}
+
+static bool PixelIs(const WBImage& image, int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+	const uint8_t* p = image.pixels.data() + (static_cast<size_t>(y) * image.width + x) * 4;
+	return p[0] == r && p[1] == g && p[2] == b && p[3] == a;
+}
+
+static void TestDecodeBMP() {
+	auto gradient = [](int x, int y) { return static_cast<uint32_t>(x * 40 | y * 60 << 8 | 0x80 << 16); };
+
+	// 24-bit bottom-up and top-down decode to the same image, stored BGR
+	for (bool topDown : { false, true }) {
+		WBImage image;
+		CHECK(WBDecodeBMP(MakeBMP(5, 3, 24, topDown, gradient), image));
+		CHECK(image.width == 5 && image.height == 3);
+		CHECK(PixelIs(image, 0, 0, 0x80, 0, 0, 255));
+		CHECK(PixelIs(image, 4, 2, 0x80, 120, 160, 255));
+	}
+
+	// 32-bit BI_RGB: the fourth byte is padding, not alpha
+	WBImage rgb;
+	CHECK(WBDecodeBMP(MakeBMP(2, 2, 32, false, [](int, int) { return 0x00112233u; }), rgb));
+	CHECK(PixelIs(rgb, 1, 1, 0x11, 0x22, 0x33, 255));
+
+	// BI_BITFIELDS with masks after a 40-byte header: RGBA stored as A in the low byte
+	WBImage fields;
+	CHECK(WBDecodeBMP(MakeBMP(2, 1, 32, false, [](int x, int) { return x ? 0x10203040u : 0xFF000080u; },
+		3, { 0xFF000000u, 0x00FF0000u, 0x0000FF00u }), fields));
+	CHECK(PixelIs(fields, 0, 0, 0xFF, 0x00, 0x00, 255)); // No alpha mask, opaque
+	CHECK(PixelIs(fields, 1, 0, 0x10, 0x20, 0x30, 255));
+
+	// V4 header with an alpha mask, and 5-6-5 style narrow channels scaled to 8 bits
+	WBImage v4;
+	CHECK(WBDecodeBMP(MakeBMP(1, 1, 32, false, [](int, int) { return 0x8000F81Fu; },
+		3, { 0x0000F800u, 0x000007E0u, 0x0000001Fu, 0xFF000000u }), v4));
+	CHECK(PixelIs(v4, 0, 0, 255, 0, 255, 0x80));
+
+	// Rejected: non-contiguous mask, bitfields at 24 bits, INT_MIN height, truncation, offsets past the end
+	WBImage bad;
+	CHECK(!WBDecodeBMP(MakeBMP(1, 1, 32, false, gradient, 3, { 0x00FF00FFu, 0x0000FF00u, 0x000000FFu }), bad));
+	CHECK(!WBDecodeBMP(MakeBMP(1, 1, 24, false, gradient, 3, { 0xFF0000u, 0xFF00u, 0xFFu }), bad));
+	std::vector<uint8_t> file = MakeBMP(4, 4, 24, false, gradient);
+	std::vector<uint8_t> minHeight = file;
+	Put32(minHeight, 22, 0x80000000u);
+	CHECK(!WBDecodeBMP(minHeight, bad));
+	std::vector<uint8_t> truncated(file.begin(), file.end() - 1);
+	CHECK(!WBDecodeBMP(truncated, bad));
+	std::vector<uint8_t> farOffset = file;
+	Put32(farOffset, 10, 0xFFFFFFF0u);
+	CHECK(!WBDecodeBMP(farOffset, bad));
+	std::vector<uint8_t> huge = file;
+	Put32(huge, 18, 0x7FFFFFFFu);
+	Put32(huge, 22, 0x7FFFFFFFu);
+	CHECK(!WBDecodeBMP(huge, bad));
+	CHECK(!WBDecodeBMP(std::vector<uint8_t>(file.begin(), file.begin() + 20), bad));
+}
+
+// Pumps Update() until nothing is decoding or waiting for upload
+static void Drain(WBTextureCache& cache, int maxFrames = 2000) {
+	for (int i = 0; i < maxFrames; ++i) {
+		cache.Update();
+		WBTextureStats stats = cache.GetStats();
+		if (stats.uploads + stats.failures >= stats.misses && stats.pendingUploads == 0)
+			return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+static std::vector<uint8_t> Solid(int size, uint32_t bgr) {
+	return MakeBMP(size, size, 24, false, [bgr](int, int) { return bgr; });
+}
+
+static void TestCache() {
+	FakeBackend::Log log;
+	WBTextureCacheConfig config;
+	config.uploadsPerFrame = 2;
+	config.budgetBytes = 3 * 16 * 16 * 4; // Three 16x16 textures
+	config.placeholderColor = 0x80FF0000u; // Blue at half alpha, packed like WBRGBA
+	{
+		WBTextureCache cache(std::make_unique<FakeBackend>(log), config);
+		CHECK(log.uploads.size() == 1 && PixelIs(log.uploads[0], 0, 0, 0, 0, 0xFF, 0x80));
+
+		// Five distinct images plus a duplicate of the first
+		std::vector<WBTextureCache::Key> keys;
+		for (uint32_t i = 0; i < 5; ++i)
+			keys.push_back(cache.Acquire(Solid(16, i * 0x101010u)));
+		CHECK(cache.Acquire(Solid(16, 0)) == keys[0]);
+		CHECK(cache.GetStats().hits == 1 && cache.GetStats().misses == 5);
+		CHECK(cache.Get(keys[0]) == cache.GetPlaceholder());
+
+		// Never more than two uploads in a frame
+		size_t previous = log.uploads.size();
+		for (int frame = 0; frame < 2000 && cache.GetStats().uploads < 5; ++frame) {
+			cache.Update();
+			CHECK(log.uploads.size() - previous <= 2);
+			previous = log.uploads.size();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		CHECK(cache.GetStats().uploads == 5);
+		for (auto key : keys)
+			CHECK(cache.IsReady(key) && cache.Get(key) != cache.GetPlaceholder());
+
+		// Everything is referenced, so nothing goes even though the budget is exceeded
+		cache.Update();
+		CHECK(cache.GetStats().residentTextures == 5 && cache.GetStats().evictions == 0);
+
+		// Unreferenced ones go least recently used first, until the budget fits
+		cache.Release(keys[0]);
+		cache.Release(keys[0]); // Duplicate reference
+		cache.Release(keys[1]);
+		cache.Release(keys[2]);
+		cache.Get(keys[0]); // Touch: now the most recent
+		cache.Update();
+		CHECK(cache.GetStats().evictions == 2);
+		CHECK(cache.IsReady(keys[0]) && !cache.IsReady(keys[1]) && !cache.IsReady(keys[2]));
+		CHECK(cache.GetStats().residentBytes == 3 * 16 * 16 * 4);
+	}
+	CHECK(log.live.empty()); // Everything released, placeholder included
+}
+
+static void TestFailures() {
+	FakeBackend::Log log;
+	WBTextureCacheConfig config;
+	config.retryFailedMs = 50;
+	std::atomic<int> attempts = 0;
+	WBTextureCache cache(std::make_unique<FakeBackend>(log), config,
+		[&](const std::vector<uint8_t>& data, WBImage& out) {
+			return ++attempts > 1 && WBDecodeBMP(data, out); // First decode fails
+		});
+
+	std::vector<uint8_t> image = Solid(4, 0x123456);
+	WBTextureCache::Key key = cache.Acquire(image);
+	Drain(cache);
+	CHECK(cache.GetStats().failures == 1 && cache.Get(key) == cache.GetPlaceholder());
+
+	// Still failed while it is recent
+	cache.Acquire(image);
+	Drain(cache);
+	CHECK(attempts == 1 && !cache.IsReady(key));
+
+	// Retried once it is old enough
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	cache.Acquire(image);
+	Drain(cache);
+	CHECK(attempts == 2 && cache.IsReady(key));
+
+	// A failed load is forgotten with its last reference, so acquiring it again retries at once
+	WBTextureCache::Key missing = cache.Acquire(std::string("/nonexistent/texture.bmp"));
+	Drain(cache);
+	CHECK(!cache.IsReady(missing));
+	uint64_t misses = cache.GetStats().misses;
+	cache.Release(missing);
+	cache.Acquire(std::string("/nonexistent/texture.bmp"));
+	CHECK(cache.GetStats().misses == misses + 1);
+	Drain(cache);
+
+	// Failed GPU uploads count as failures too
+	log.failUploads = true;
+	WBTextureCache::Key rejected = cache.Acquire(Solid(8, 0xABCDEF));
+	Drain(cache);
+	CHECK(!cache.IsReady(rejected) && cache.GetStats().failures >= 3);
+}
+
+int main(void) {
+	TestDecodeBMP();
+	TestCache();
+	TestFailures();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All texture cache tests passed" << std::endl;
+	return 0;
+}
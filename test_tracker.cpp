@@ -0,0 +1,169 @@
+#include "windowbuilder_tracker.h"
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// Registers synthetic targets with a WBTracker: the idle back-off, the reset when a target moves,
+// Unregister waiting for a poll in flight, and the wakeups of the shared thread against one
+// sleeping thread per overlay, both measured over the same wall time.
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { if (!(expr)) { std::cerr << "FAILED: " #expr " (line " << __LINE__ << ")\n"; ++failures; } } while (0)
+
+using Clock = std::chrono::steady_clock;
+
+static double Ms(Clock::duration d) {
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Records when it is polled and reports a move when asked to
+struct Target {
+	std::mutex mutex;
+	std::vector<Clock::time_point> polls;
+	std::atomic<bool> moveOnce = false;
+	std::atomic<bool> moving = false;
+
+	WBTrackResult Poll() {
+		std::lock_guard<std::mutex> lock(mutex);
+		polls.push_back(Clock::now());
+		if (moving || moveOnce.exchange(false))
+			return WBTrackResult::Moved;
+		return WBTrackResult::Unchanged;
+	}
+
+	std::vector<double> Intervals() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<double> intervals;
+		for (size_t i = 1; i < polls.size(); ++i)
+			intervals.push_back(Ms(polls[i] - polls[i - 1]));
+		return intervals;
+	}
+};
+
+static void TestBackoffAndReset() {
+	WBTracker tracker;
+	Target target;
+	WBTracker::Handle handle = tracker.Register([&] { return target.Poll(); });
+
+	// Idle: the interval grows from 16 ms and levels off just under 250 ms
+	std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+	std::vector<double> idle = target.Intervals();
+	CHECK(idle.size() >= 8);
+	if (idle.size() >= 8) {
+		CHECK(idle.front() < 40.0);
+		CHECK(idle.back() > 200.0 && idle.back() < 320.0);
+		for (size_t i = 1; i < idle.size(); ++i)
+			CHECK(idle[i] > idle[i - 1] * 0.8); // Never shrinks while nothing moves
+	}
+
+	// One move snaps the next poll back to the base interval
+	target.moveOnce = true;
+	size_t before = idle.size();
+	std::this_thread::sleep_for(std::chrono::milliseconds(400));
+	std::vector<double> afterMove = target.Intervals();
+	CHECK(afterMove.size() >= before + 2);
+	if (afterMove.size() >= before + 2)
+		CHECK(afterMove[before + 1] < 40.0); // The poll after the one that saw the move
+	tracker.Unregister(handle);
+	CHECK(tracker.GetStats().targets == 0 && tracker.GetStats().moves == 1);
+}
+
+static void TestUnregisterWaitsForPoll() {
+	WBTracker tracker;
+	std::atomic<bool> inPoll = false, finished = false;
+	std::atomic<int> calls = 0;
+	WBTracker::Handle handle = tracker.Register([&] {
+		++calls;
+		inPoll = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		finished = true;
+		return WBTrackResult::Moved;
+	});
+
+	while (!inPoll)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	auto start = Clock::now();
+	tracker.Unregister(handle);
+	CHECK(finished); // Returned only after the callback did
+	CHECK(Ms(Clock::now() - start) > 50.0);
+
+	int seen = calls;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(calls == seen); // And never called it again
+}
+
+static void TestGone() {
+	WBTracker tracker;
+	std::atomic<int> calls = 0;
+	tracker.Register([&] { ++calls; return WBTrackResult::Gone; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(calls == 1 && tracker.GetStats().targets == 0);
+}
+
+// Wakeups per second of both designs, 48 overlays of which 6 have a moving target
+static void MeasureWakeups() {
+	const int overlays = 48, movingOverlays = 6;
+	const auto duration = std::chrono::milliseconds(3000);
+	std::vector<std::unique_ptr<Target>> targets;
+	for (int i = 0; i < overlays; ++i) {
+		targets.push_back(std::make_unique<Target>());
+		targets.back()->moving = i < movingOverlays;
+	}
+
+	// Shared tracker, past the initial back-off
+	WBTracker tracker;
+	std::vector<WBTracker::Handle> handles;
+	for (auto& target : targets)
+		handles.push_back(tracker.Register([t = target.get()] { return t->Poll(); }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	uint64_t wakeupsBefore = tracker.GetStats().wakeups;
+	auto start = Clock::now();
+	std::this_thread::sleep_for(duration);
+	double trackerRate = (tracker.GetStats().wakeups - wakeupsBefore) / (Ms(Clock::now() - start) / 1000.0);
+	for (WBTracker::Handle handle : handles)
+		tracker.Unregister(handle);
+
+	// The previous design: every overlay sleeps 16 ms and polls its target
+	std::atomic<bool> running = true;
+	std::atomic<uint64_t> threadWakeups = 0;
+	std::vector<std::thread> threads;
+	start = Clock::now();
+	for (auto& target : targets) {
+		threads.emplace_back([&, t = target.get()] {
+			while (running) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(WBTracker::defaultIntervalMs));
+				threadWakeups.fetch_add(1, std::memory_order_relaxed);
+				t->Poll();
+			}
+		});
+	}
+	std::this_thread::sleep_for(duration);
+	double threadRate = threadWakeups.load() / (Ms(Clock::now() - start) / 1000.0);
+	running = false;
+	for (std::thread& thread : threads)
+		thread.join();
+
+	std::cout << overlays << " overlays (" << movingOverlays << " moving): shared tracker " << trackerRate
+		<< " wakeups/s, thread per overlay " << threadRate << " wakeups/s" << std::endl;
+	CHECK(trackerRate > 0.0 && trackerRate * 10.0 < threadRate);
+}
+
+int main(void) {
+	TestBackoffAndReset();
+	TestUnregisterWaitsForPoll();
+	TestGone();
+	MeasureWakeups();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All tracker tests passed" << std::endl;
+	return 0;
+}
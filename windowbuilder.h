@@ -1,8 +1,11 @@
 #pragma once
 
 #pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "dwmapi.lib")
 #pragma comment(lib, "ntdll.lib")
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "windowscodecs.lib")
 
 #include <functional>
 #include <iostream>
@@ -14,13 +17,34 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <algorithm>
+#include <typeinfo>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <d3d11.h>
+#include <d3dcompiler.h>
 #include <dwmapi.h>
 #include <winternl.h>
 #include <psapi.h>
+#include <objbase.h>
+#include <wincodec.h>
+
+#include "windowbuilder_tracker.h"
+#include "windowbuilder_textures.h"
+#include "windowbuilder_framering.h"
+#include "windowbuilder_latency.h"
+#include "windowbuilder_layered.h"
+#include "windowbuilder_allocprof.h"
+#include "windowbuilder_layers.h"
+#include "windowbuilder_metrics.h"
+#include "windowbuilder_dynres.h"
+#ifdef __cpp_impl_coroutine
+#include "windowbuilder_coro.h"
+#endif
 
 // Status constants for NT API
 #ifndef STATUS_SUCCESS
@@ -56,6 +80,18 @@ typedef struct _SYSTEM_PROCESS_INFORMATION {
 class Window;
 class WBPlugin;
 
+// Pointer state sampled for a late latch, in client coordinates.
+struct WBPointerState {
+	int x = 0;
+	int y = 0;
+	bool left = false;
+	bool right = false;
+	bool middle = false;
+	uint64_t time = 0;      // When the pointer moved here, from the mouse move history, in the window's latency clock
+	uint64_t sampled = 0;   // When it was sampled, same clock; time falls back to this without a history entry
+	uint32_t eventTick = 0; // Tick count of that move event, 0 without one
+};
+
 // A simple configuration struct for window properties.
 struct WindowConfig {
 	const char* title = "Window";
@@ -68,6 +104,7 @@ struct WindowConfig {
 	std::function<void(Window&)> onResize = nullptr;
 	std::function<void(Window&)> onClose = nullptr;
 	std::function<void(Window&)> onRender = nullptr;
+	std::function<void(Window&, const WBPointerState&)> onLateLatch = nullptr;
 	std::vector<std::unique_ptr<WBPlugin>> plugins;
 	
 	// Overlay/attach configuration
@@ -77,6 +114,795 @@ struct WindowConfig {
 	DWORD targetProcessId = 0;
 	bool takeFocus = false;
 	bool transparentBackground = true;
+
+	// Texture cache configuration
+	WBTextureCacheConfig textureCache;
+
+	// Shared-memory frame publishing
+	const char* frameRingName = nullptr;
+	int frameRingSlots = 3;
+	int frameRingWidth = 0;         // Capacity of the ring, 0 takes the window's initial size
+	int frameRingHeight = 0;
+
+	// Per-pixel alpha presentation through UpdateLayeredWindow
+	bool perPixelAlpha = false;
+	WBLayeredAlpha layeredAlpha = WBLayeredAlpha::Premultiplied;
+
+	// Create the device and swap chain in the first Show() instead of the constructor
+	bool deferGraphics = false;
+
+	// Retained render layers, each with the callback that draws it
+	std::vector<std::pair<WBLayerDesc, std::function<void(Window&)>>> layers;
+
+	// Prometheus metrics on a loopback port and/or a local pipe, off when both are unset
+	uint16_t metricsPort = 0;
+	const char* metricsPipe = nullptr;
+
+	// Render the scene at a scale that keeps the GPU frame time inside a budget
+	bool dynamicResolution = false;
+	WBDynamicResolutionConfig resolution;
+};
+
+/// <summary>
+/// Decodes any image format supported by WIC (PNG, JPEG, BMP, GIF, TIFF, ...) into RGBA8.
+/// </summary>
+/// <param name="data">The encoded file contents.</param>
+/// <param name="out">Receives the decoded image.</param>
+/// <returns>True on success.</returns>
+inline bool WBDecodeImageWIC(const std::vector<uint8_t>& data, WBImage& out) {
+	// Decoding runs on the cache worker threads, each needs COM initialized once
+	thread_local HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	if (FAILED(comResult) && comResult != RPC_E_CHANGED_MODE)
+		return false;
+
+	IWICImagingFactory* factory = nullptr;
+	IWICStream* stream = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+
+	bool ok = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+			IID_PPV_ARGS(&factory)))
+		&& SUCCEEDED(factory->CreateStream(&stream))
+		&& SUCCEEDED(stream->InitializeFromMemory(const_cast<BYTE*>(data.data()), static_cast<DWORD>(data.size())))
+		&& SUCCEEDED(factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder))
+		&& SUCCEEDED(decoder->GetFrame(0, &frame))
+		&& SUCCEEDED(factory->CreateFormatConverter(&converter))
+		&& SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone,
+			nullptr, 0.0, WICBitmapPaletteTypeCustom));
+
+	if (ok) {
+		UINT w = 0, h = 0;
+		converter->GetSize(&w, &h);
+		out.width = static_cast<int>(w);
+		out.height = static_cast<int>(h);
+		out.pixels.resize(out.Bytes());
+		ok = SUCCEEDED(converter->CopyPixels(nullptr, w * 4, static_cast<UINT>(out.pixels.size()), out.pixels.data()));
+	}
+
+	if (converter) converter->Release();
+	if (frame) frame->Release();
+	if (decoder) decoder->Release();
+	if (stream) stream->Release();
+	if (factory) factory->Release();
+	return ok;
+}
+
+/// <summary>
+/// Compiles an HLSL shader from source. Used by the built-in plugins.
+/// </summary>
+/// <param name="source">HLSL source code.</param>
+/// <param name="entry">Entry point name.</param>
+/// <param name="target">Shader model, e.g. "vs_4_0".</param>
+/// <returns>The compiled bytecode, or nullptr on failure (errors are written to std::cerr).</returns>
+inline ID3DBlob* WBCompileShader(const char* source, const char* entry, const char* target) {
+	ID3DBlob* blob = nullptr;
+	ID3DBlob* errors = nullptr;
+	HRESULT res = D3DCompile(source, strlen(source), nullptr, nullptr, nullptr, entry, target,
+		D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &blob, &errors);
+	if (FAILED(res)) {
+		std::cerr << "Failed to compile shader " << entry;
+		if (errors)
+			std::cerr << ": " << static_cast<const char*>(errors->GetBufferPointer());
+		std::cerr << std::endl;
+	}
+	if (errors) errors->Release();
+	return blob;
+}
+
+/// <summary>
+/// Texture cache backend that creates immutable D3D11 textures.
+/// Handles are ID3D11ShaderResourceView pointers, usable directly as ImTextureID.
+/// </summary>
+class WBD3D11TextureBackend : public WBTextureBackend {
+public:
+	explicit WBD3D11TextureBackend(ID3D11Device* device) : device(device) {
+		device->AddRef();
+	}
+
+	~WBD3D11TextureBackend() override {
+		device->Release();
+	}
+
+	void* Upload(const WBImage& image) override {
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = image.width;
+		desc.Height = image.height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA initial = {};
+		initial.pSysMem = image.pixels.data();
+		initial.SysMemPitch = image.width * 4;
+
+		ID3D11Texture2D* texture = nullptr;
+		if (FAILED(device->CreateTexture2D(&desc, &initial, &texture)))
+			return nullptr;
+
+		ID3D11ShaderResourceView* view = nullptr;
+		device->CreateShaderResourceView(texture, nullptr, &view);
+		texture->Release();
+		return view;
+	}
+
+	void Release(void* handle) override {
+		static_cast<ID3D11ShaderResourceView*>(handle)->Release();
+	}
+
+private:
+	ID3D11Device* device = nullptr;
+};
+
+/// <summary>
+/// Finds the first visible top-level window of a process.
+/// </summary>
+inline HWND WBFindWindowByProcessId(DWORD processId) {
+	struct EnumData {
+		DWORD targetPid;
+		HWND result;
+	};
+	
+	EnumData data = { processId, nullptr };
+	
+	EnumWindows([](HWND hwnd, LPARAM lParam) -> BOOL {
+		EnumData* data = reinterpret_cast<EnumData*>(lParam);
+		DWORD pid;
+		GetWindowThreadProcessId(hwnd, &pid);
+		if (pid == data->targetPid && IsWindowVisible(hwnd)) {
+			data->result = hwnd;
+			return FALSE; // Stop enumeration
+		}
+		return TRUE; // Continue enumeration
+	}, reinterpret_cast<LPARAM>(&data));
+	
+	return data.result;
+}
+
+/// <summary>
+/// Finds the first visible top-level window of a process by executable name, e.g. "notepad.exe".
+/// </summary>
+inline HWND WBFindWindowByProcessName(const char* processName) {
+	// Use NT API to avoid detection
+	HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+	if (!ntdll) return nullptr;
+
+	NtQuerySystemInformation_t NtQuerySystemInformation = 
+		reinterpret_cast<NtQuerySystemInformation_t>(GetProcAddress(ntdll, "NtQuerySystemInformation"));
+	if (!NtQuerySystemInformation) return nullptr;
+
+	ULONG bufferSize = 0x10000;
+	std::vector<BYTE> buffer(bufferSize);
+
+	NTSTATUS status = NtQuerySystemInformation(SystemProcessInformation, 
+		buffer.data(), bufferSize, &bufferSize);
+	
+	if (status == STATUS_INFO_LENGTH_MISMATCH) {
+		buffer.resize(bufferSize);
+		status = NtQuerySystemInformation(SystemProcessInformation, 
+			buffer.data(), bufferSize, &bufferSize);
+	}
+
+	if (status != STATUS_SUCCESS) return nullptr;
+
+	PSYSTEM_PROCESS_INFORMATION processInfo = 
+		reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(buffer.data());
+
+	BYTE* bufferEnd = buffer.data() + buffer.size();
+	
+	while (processInfo->NextEntryOffset != 0) {
+		if (processInfo->ImageName.Buffer) {
+			// Convert UNICODE_STRING to char*
+			int len = WideCharToMultiByte(CP_UTF8, 0, processInfo->ImageName.Buffer, 
+				processInfo->ImageName.Length / sizeof(WCHAR), nullptr, 0, nullptr, nullptr);
+			if (len > 0) {
+				std::vector<char> processNameBuffer(len + 1);
+				WideCharToMultiByte(CP_UTF8, 0, processInfo->ImageName.Buffer, 
+					processInfo->ImageName.Length / sizeof(WCHAR), 
+					processNameBuffer.data(), len, nullptr, nullptr);
+				processNameBuffer[len] = '\0';
+
+				if (strcmp(processNameBuffer.data(), processName) == 0) {
+					DWORD pid = static_cast<DWORD>(reinterpret_cast<uintptr_t>(processInfo->ProcessId));
+					return WBFindWindowByProcessId(pid);
+				}
+			}
+		}
+
+		// Move to next process info, with bounds checking
+		BYTE* nextPtr = reinterpret_cast<BYTE*>(processInfo) + processInfo->NextEntryOffset;
+		if (nextPtr >= bufferEnd) break; // Prevent buffer overflow
+		
+		processInfo = reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(nextPtr);
+	}
+
+	return nullptr;
+}
+
+/// <summary>
+/// Resolves an overlay target from a process ID, or a process name if the ID is 0.
+/// </summary>
+/// <returns>The target window, or nullptr if neither names a running process with a visible window.</returns>
+inline HWND WBFindTargetWindow(DWORD processId, const char* processName) {
+	if (processId != 0)
+		return WBFindWindowByProcessId(processId);
+	if (processName)
+		return WBFindWindowByProcessName(processName);
+	return nullptr;
+}
+
+/// <summary>
+/// Registers a window class once per class name and process; later calls for the same name
+/// return immediately.
+/// </summary>
+/// <returns>True if the class is registered.</returns>
+inline bool WBRegisterWindowClass(const char* className, WNDPROC windowProc) {
+	static std::mutex mutex;
+	static std::unordered_set<std::string> registered;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (registered.count(className))
+		return true;
+
+	WNDCLASS wc = {};
+	wc.lpfnWndProc = windowProc;
+	wc.hInstance = GetModuleHandle(NULL);
+#ifdef UNICODE
+	wchar_t wClassName[256];
+	swprintf(wClassName, 256, L"%hs", className);
+	wc.lpszClassName = wClassName;
+#else
+	wc.lpszClassName = className;
+#endif
+	if (!RegisterClass(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+		return false;
+	registered.insert(className);
+	return true;
+}
+
+/// <summary>
+/// Whether apps should use the dark theme. Read from the registry on the first call only.
+/// </summary>
+inline bool WBAppsUseDarkTheme() {
+	static const bool dark = [] {
+		HKEY hKey = nullptr;
+		DWORD value = 1;
+		if (RegOpenKeyEx(HKEY_CURRENT_USER,
+#ifdef UNICODE
+			L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
+#else
+			"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
+#endif
+			0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+			DWORD size = sizeof(DWORD);
+			RegQueryValueEx(hKey,
+#ifdef UNICODE
+				L"AppsUseLightTheme",
+#else
+				"AppsUseLightTheme",
+#endif
+				NULL, NULL,
+				reinterpret_cast<LPBYTE>(&value), &size);
+			RegCloseKey(hKey);
+		}
+		return value == 0;
+	}();
+	return dark;
+}
+
+/// <summary>
+/// Presents a per-pixel alpha window: reads the backbuffer back, converts it into a premultiplied
+/// BGRA DIB section and hands UpdateLayeredWindowIndirect only the rows that changed.
+/// </summary>
+class WBLayeredPresenter {
+public:
+	explicit WBLayeredPresenter(WBLayeredAlpha alpha) : alpha(alpha) {}
+	WBLayeredPresenter(const WBLayeredPresenter&) = delete;
+	WBLayeredPresenter& operator=(const WBLayeredPresenter&) = delete;
+
+	~WBLayeredPresenter() {
+		ReleaseSurface();
+		if (staging) staging->Release();
+	}
+
+	/// <summary>
+	/// Shows the current contents of the swap chain's backbuffer in the window. Mapping the
+	/// readback waits for the GPU to finish the frame, the same wait Present would do.
+	/// </summary>
+	/// <returns>False if the readback or the window update failed.</returns>
+	bool Present(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain, HWND hWnd) {
+		ID3D11Texture2D* backBuffer = nullptr;
+		if (FAILED(swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer))))
+			return false;
+		D3D11_TEXTURE2D_DESC desc = {};
+		backBuffer->GetDesc(&desc);
+
+		if (staging) {
+			D3D11_TEXTURE2D_DESC stagingDesc = {};
+			staging->GetDesc(&stagingDesc);
+			if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height) {
+				staging->Release();
+				staging = nullptr;
+			}
+		}
+		if (!staging) {
+			desc.Usage = D3D11_USAGE_STAGING;
+			desc.BindFlags = 0;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			desc.MiscFlags = 0;
+			device->CreateTexture2D(&desc, nullptr, &staging);
+		}
+		if (staging)
+			context->CopyResource(staging, backBuffer);
+		backBuffer->Release();
+		if (!staging || !CreateSurface(static_cast<int>(desc.Width), static_cast<int>(desc.Height)))
+			return false;
+
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped)))
+			return false;
+		WBDirtyRows dirty = WBRGBAToBGRAFrame(static_cast<const uint8_t*>(mapped.pData), mapped.RowPitch,
+			bits, static_cast<size_t>(surfaceWidth) * 4, surfaceWidth, surfaceHeight, alpha);
+		context->Unmap(staging, 0);
+
+		++stats.frames;
+		stats.rowsConverted += surfaceHeight;
+		if (fullUpdate)
+			dirty = { 0, surfaceHeight };
+		if (dirty.Empty()) {
+			++stats.framesSkipped;
+			return true;
+		}
+
+		POINT source = { 0, 0 };
+		SIZE size = { surfaceWidth, surfaceHeight };
+		BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+		RECT dirtyRect = { 0, dirty.first, surfaceWidth, dirty.last };
+		UPDATELAYEREDWINDOWINFO info = {};
+		info.cbSize = sizeof(info);
+		info.hdcSrc = dc;
+		info.pptSrc = &source;
+		info.psize = &size;
+		info.pblend = &blend;
+		info.dwFlags = ULW_ALPHA;
+		info.prcDirty = &dirtyRect;
+		if (!UpdateLayeredWindowIndirect(hWnd, &info)) {
+			fullUpdate = true;
+			return false;
+		}
+		fullUpdate = false;
+		stats.rowsUploaded += dirty.last - dirty.first;
+		return true;
+	}
+
+	const WBLayeredStats& GetStats() const { return stats; }
+
+private:
+	// (Re)creates the top-down 32-bit DIB section the frames are converted into
+	bool CreateSurface(int width, int height) {
+		if (dc && width == surfaceWidth && height == surfaceHeight)
+			return true;
+		ReleaseSurface();
+
+		BITMAPINFO info = {};
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = width;
+		info.bmiHeader.biHeight = -height;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+
+		dc = CreateCompatibleDC(nullptr);
+		void* pixels = nullptr;
+		bitmap = dc ? CreateDIBSection(dc, &info, DIB_RGB_COLORS, &pixels, nullptr, 0) : nullptr;
+		if (!bitmap) {
+			ReleaseSurface();
+			return false;
+		}
+		previousBitmap = SelectObject(dc, bitmap);
+		bits = static_cast<uint8_t*>(pixels);
+		surfaceWidth = width;
+		surfaceHeight = height;
+		fullUpdate = true;
+		return true;
+	}
+
+	void ReleaseSurface() {
+		if (dc && previousBitmap)
+			SelectObject(dc, previousBitmap);
+		if (bitmap) DeleteObject(bitmap);
+		if (dc) DeleteDC(dc);
+		dc = nullptr;
+		bitmap = nullptr;
+		previousBitmap = nullptr;
+		bits = nullptr;
+		surfaceWidth = surfaceHeight = 0;
+	}
+
+	WBLayeredAlpha alpha;
+	ID3D11Texture2D* staging = nullptr;
+	HDC dc = nullptr;
+	HBITMAP bitmap = nullptr;
+	HGDIOBJ previousBitmap = nullptr;
+	uint8_t* bits = nullptr;
+	int surfaceWidth = 0;
+	int surfaceHeight = 0;
+	bool fullUpdate = true; // The window has not seen the surface's current contents yet
+	WBLayeredStats stats;
+};
+
+/// <summary>
+/// Which layers a composite pass draws. With dynamic resolution the scaled layers go into the
+/// scaled scene and the full resolution ones over the upscaled result.
+/// </summary>
+enum class WBCompositePass {
+	All,
+	Scaled,
+	FullResolution
+};
+
+/// <summary>
+/// GPU side of the render layers tracked by a WBLayerStack: one texture per layer, kept between
+/// frames, and a composite pass that blends each visible layer over the backbuffer with a single
+/// fullscreen triangle. Layer textures hold premultiplied color, which is what straight alpha
+/// blending over their transparent clear produces, so opacity is a plain multiply.
+/// </summary>
+class WBLayerCompositor {
+public:
+	// Surface id of the scaled scene of a dynamic resolution window, never handed out to a layer
+	static constexpr WBLayerStack::Id sceneSurface = 0xFFFFFFFFu;
+
+	explicit WBLayerCompositor(ID3D11Device* device) {
+		ID3DBlob* vsBlob = WBCompileShader(shaderSource, "VSMain", "vs_4_0");
+		ID3DBlob* psBlob = WBCompileShader(shaderSource, "PSMain", "ps_4_0");
+		if (vsBlob && psBlob) {
+			device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
+			device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+		}
+		if (vsBlob) vsBlob->Release();
+		if (psBlob) psBlob->Release();
+
+		D3D11_BUFFER_DESC cbDesc = {};
+		cbDesc.ByteWidth = 16;
+		cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+		cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&cbDesc, nullptr, &constantBuffer);
+
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		device->CreateBlendState(&blendDesc, &blendState);
+
+		D3D11_RASTERIZER_DESC rasterDesc = {};
+		rasterDesc.FillMode = D3D11_FILL_SOLID;
+		rasterDesc.CullMode = D3D11_CULL_NONE;
+		rasterDesc.DepthClipEnable = TRUE;
+		device->CreateRasterizerState(&rasterDesc, &rasterizerState);
+
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		device->CreateDepthStencilState(&depthDesc, &depthStencilState);
+
+		D3D11_SAMPLER_DESC samplerDesc = {};
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = samplerDesc.AddressV = samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+		device->CreateSamplerState(&samplerDesc, &samplerState);
+	}
+
+	WBLayerCompositor(const WBLayerCompositor&) = delete;
+	WBLayerCompositor& operator=(const WBLayerCompositor&) = delete;
+
+	~WBLayerCompositor() {
+		for (Surface& surface : surfaces)
+			ReleaseSurface(surface);
+		if (samplerState) samplerState->Release();
+		if (depthStencilState) depthStencilState->Release();
+		if (rasterizerState) rasterizerState->Release();
+		if (blendState) blendState->Release();
+		if (constantBuffer) constantBuffer->Release();
+		if (pixelShader) pixelShader->Release();
+		if (vertexShader) vertexShader->Release();
+	}
+
+	/// <summary>
+	/// Gets the render target of a layer, creating its texture or recreating it at a new size.
+	/// </summary>
+	/// <returns>The render target, or nullptr if the texture could not be created.</returns>
+	ID3D11RenderTargetView* Target(ID3D11Device* device, WBLayerStack::Id id, int width, int height) {
+		Surface* surface = Find(id);
+		if (!surface) {
+			surfaces.push_back({ id });
+			surface = &surfaces.back();
+		}
+		if (surface->renderTarget && surface->width == width && surface->height == height)
+			return surface->renderTarget;
+		ReleaseSurface(*surface);
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = static_cast<UINT>(width);
+		desc.Height = static_cast<UINT>(height);
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		if (FAILED(device->CreateTexture2D(&desc, nullptr, &surface->texture))
+			|| FAILED(device->CreateRenderTargetView(surface->texture, nullptr, &surface->renderTarget))
+			|| FAILED(device->CreateShaderResourceView(surface->texture, nullptr, &surface->shaderResource))) {
+			ReleaseSurface(*surface);
+			return nullptr;
+		}
+		surface->width = width;
+		surface->height = height;
+		return surface->renderTarget;
+	}
+
+	/// <summary>
+	/// Frees the texture of a removed layer.
+	/// </summary>
+	void Release(WBLayerStack::Id id) {
+		for (size_t i = 0; i < surfaces.size(); ++i) {
+			if (surfaces[i].id == id) {
+				ReleaseSurface(surfaces[i]);
+				surfaces.erase(surfaces.begin() + i);
+				return;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Blends every visible layer that has been drawn over the bound render target, back to front,
+	/// and records the submit time of each in the stack's stats. A pass other than All only takes
+	/// the layers on its side of WBLayerDesc::fullResolution, in z order among themselves.
+	/// </summary>
+	void Composite(ID3D11DeviceContext* context, WBLayerStack& layers, int width, int height,
+		WBCompositePass pass = WBCompositePass::All) {
+		if (!vertexShader || !pixelShader)
+			return;
+
+		bool bound = false;
+		for (WBLayerStack::Id id : layers.CompositeOrder()) {
+			Surface* surface = Find(id);
+			const WBLayerDesc* desc = layers.GetDesc(id);
+			if (!surface || !surface->shaderResource)
+				continue;
+			if (pass != WBCompositePass::All && desc->fullResolution != (pass == WBCompositePass::FullResolution))
+				continue;
+			if (!bound) {
+				Bind(context, width, height);
+				bound = true;
+			}
+			auto start = std::chrono::steady_clock::now();
+			DrawSurface(context, *surface, desc->opacity);
+			layers.Composited(id, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+				width, height);
+		}
+
+		// The layer textures are render targets again in the next redraw
+		ID3D11ShaderResourceView* none = nullptr;
+		if (bound)
+			context->PSSetShaderResources(0, 1, &none);
+	}
+
+	/// <summary>
+	/// Stretches one surface over the bound render target with bilinear filtering, e.g. the scaled
+	/// scene over the backbuffer.
+	/// </summary>
+	void Blit(ID3D11DeviceContext* context, WBLayerStack::Id id, int width, int height) {
+		Surface* surface = Find(id);
+		if (!vertexShader || !pixelShader || !surface || !surface->shaderResource)
+			return;
+		Bind(context, width, height);
+		DrawSurface(context, *surface, 1.0f);
+		ID3D11ShaderResourceView* none = nullptr;
+		context->PSSetShaderResources(0, 1, &none);
+	}
+
+private:
+	struct Surface {
+		WBLayerStack::Id id = WBLayerStack::invalid;
+		int width = 0;
+		int height = 0;
+		ID3D11Texture2D* texture = nullptr;
+		ID3D11RenderTargetView* renderTarget = nullptr;
+		ID3D11ShaderResourceView* shaderResource = nullptr;
+	};
+
+	Surface* Find(WBLayerStack::Id id) {
+		for (Surface& surface : surfaces)
+			if (surface.id == id)
+				return &surface;
+		return nullptr;
+	}
+
+	void Bind(ID3D11DeviceContext* context, int width, int height) {
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f };
+		const float blendFactor[4] = {};
+		context->RSSetViewports(1, &viewport);
+		context->RSSetState(rasterizerState);
+		context->IASetInputLayout(nullptr);
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		context->VSSetShader(vertexShader, nullptr, 0);
+		context->PSSetShader(pixelShader, nullptr, 0);
+		context->PSSetConstantBuffers(0, 1, &constantBuffer);
+		context->PSSetSamplers(0, 1, &samplerState);
+		context->GSSetShader(nullptr, nullptr, 0);
+		context->OMSetBlendState(blendState, blendFactor, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(depthStencilState, 0);
+	}
+
+	void DrawSurface(ID3D11DeviceContext* context, const Surface& surface, float opacity) {
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (SUCCEEDED(context->Map(constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			float* constants = static_cast<float*>(mapped.pData);
+			constants[0] = opacity;
+			constants[1] = constants[2] = constants[3] = 0.0f;
+			context->Unmap(constantBuffer, 0);
+		}
+		context->PSSetShaderResources(0, 1, &surface.shaderResource);
+		context->Draw(3, 0);
+	}
+
+	static void ReleaseSurface(Surface& surface) {
+		if (surface.shaderResource) surface.shaderResource->Release();
+		if (surface.renderTarget) surface.renderTarget->Release();
+		if (surface.texture) surface.texture->Release();
+		surface.shaderResource = nullptr;
+		surface.renderTarget = nullptr;
+		surface.texture = nullptr;
+		surface.width = surface.height = 0;
+	}
+
+	// One triangle covering the viewport, positions and UVs generated from the vertex id
+	static constexpr const char* shaderSource = R"(
+cbuffer Layer : register(b0) { float opacity; float3 unused; };
+Texture2D tex : register(t0);
+SamplerState smp : register(s0);
+
+struct VSOut {
+	float4 pos : SV_POSITION;
+	float2 uv : TEXCOORD0;
+};
+
+VSOut VSMain(uint id : SV_VertexID) {
+	VSOut o;
+	o.uv = float2((id << 1) & 2, id & 2);
+	o.pos = float4(o.uv * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+	return o;
+}
+
+float4 PSMain(VSOut i) : SV_TARGET {
+	return tex.Sample(smp, i.uv) * opacity;
+}
+)";
+
+	std::vector<Surface> surfaces;
+	ID3D11VertexShader* vertexShader = nullptr;
+	ID3D11PixelShader* pixelShader = nullptr;
+	ID3D11Buffer* constantBuffer = nullptr;
+	ID3D11BlendState* blendState = nullptr;
+	ID3D11RasterizerState* rasterizerState = nullptr;
+	ID3D11DepthStencilState* depthStencilState = nullptr;
+	ID3D11SamplerState* samplerState = nullptr;
+};
+
+/// <summary>
+/// GPU time of whole frames from timestamp queries. Results are read a few frames later without
+/// flushing or waiting; a frame is not timed while all query sets are still in flight.
+/// </summary>
+class WBGpuFrameTimer {
+public:
+	static constexpr int depth = 4;
+
+	explicit WBGpuFrameTimer(ID3D11Device* device) {
+		for (Frame& frame : frames) {
+			D3D11_QUERY_DESC desc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+			device->CreateQuery(&desc, &frame.disjoint);
+			desc.Query = D3D11_QUERY_TIMESTAMP;
+			device->CreateQuery(&desc, &frame.begin);
+			device->CreateQuery(&desc, &frame.end);
+		}
+	}
+
+	WBGpuFrameTimer(const WBGpuFrameTimer&) = delete;
+	WBGpuFrameTimer& operator=(const WBGpuFrameTimer&) = delete;
+
+	~WBGpuFrameTimer() {
+		for (Frame& frame : frames) {
+			if (frame.end) frame.end->Release();
+			if (frame.begin) frame.begin->Release();
+			if (frame.disjoint) frame.disjoint->Release();
+		}
+	}
+
+	/// <summary>
+	/// Starts timing a frame rendered at the given scale.
+	/// </summary>
+	void Begin(ID3D11DeviceContext* context, float scale) {
+		Frame& frame = frames[written % depth];
+		recording = written - read < depth && frame.disjoint && frame.begin && frame.end;
+		if (!recording)
+			return;
+		frame.scale = scale;
+		context->Begin(frame.disjoint);
+		context->End(frame.begin);
+	}
+
+	void End(ID3D11DeviceContext* context) {
+		if (!recording)
+			return;
+		Frame& frame = frames[written % depth];
+		context->End(frame.end);
+		context->End(frame.disjoint);
+		++written;
+		recording = false;
+	}
+
+	/// <summary>
+	/// Takes the oldest timed frame if the GPU has finished it.
+	/// </summary>
+	/// <returns>False when nothing is ready, or the frame could not be timed.</returns>
+	bool Read(ID3D11DeviceContext* context, double& ms, float& scale) {
+		if (read == written)
+			return false;
+		Frame& frame = frames[read % depth];
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+		UINT64 begin = 0, end = 0;
+		if (context->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| context->GetData(frame.begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| context->GetData(frame.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			return false;
+		++read;
+		if (disjoint.Disjoint || !disjoint.Frequency || end < begin)
+			return false;
+		ms = static_cast<double>(end - begin) * 1000.0 / static_cast<double>(disjoint.Frequency);
+		scale = frame.scale;
+		return true;
+	}
+
+private:
+	struct Frame {
+		ID3D11Query* disjoint = nullptr;
+		ID3D11Query* begin = nullptr;
+		ID3D11Query* end = nullptr;
+		float scale = 1.0f;
+	};
+
+	std::array<Frame, depth> frames = {};
+	uint64_t written = 0;
+	uint64_t read = 0;
+	bool recording = false;
 };
 
 /// <summary>
@@ -113,6 +939,12 @@ public:
 	/// <param name="window">The window instance.</param>
 	virtual void PostRender(Window&) {}
 
+	/// <summary>
+	/// Whether PostRender draws into the scaled scene of a window with dynamic resolution. Plugins
+	/// that return false run PostRender after the upscale, at full resolution, e.g. for text and UI.
+	/// </summary>
+	virtual bool ScalesWithResolution() const { return true; }
+
 	/// <summary>
 	/// Called when the window receives a message but previous handlers have not processed it.
 	/// </summary>
@@ -148,6 +980,7 @@ public:
 		onResize(std::move(other.onResize)),
 		onClose(std::move(other.onClose)),
 		onRender(std::move(other.onRender)),
+		onLateLatch(std::move(other.onLateLatch)),
 		plugins(std::move(other.plugins)),
 		useImmersiveTitlebar(other.useImmersiveTitlebar),
 		vsync(other.vsync),
@@ -157,9 +990,42 @@ public:
 		targetProcessId(other.targetProcessId),
 		takeFocus(other.takeFocus.load()),
 		transparentBackground(other.transparentBackground),
-		trackingThread(std::move(other.trackingThread)),
-		shouldStopTracking(other.shouldStopTracking.load())
+		lastTargetRect(other.lastTargetRect),
+		textureCacheConfig(other.textureCacheConfig),
+		textures(std::move(other.textures)),
+		frameRingName(other.frameRingName),
+		frameRingSlots(other.frameRingSlots),
+		frameRingWidth(other.frameRingWidth),
+		frameRingHeight(other.frameRingHeight),
+		frameRing(std::move(other.frameRing)),
+		readbackTextures(other.readbackTextures),
+		readbackFrame(other.readbackFrame),
+		perPixelAlpha(other.perPixelAlpha),
+		layeredAlpha(other.layeredAlpha),
+		layered(std::move(other.layered)),
+		latency(std::move(other.latency)),
+		lastPointer(other.lastPointer),
+		layers(std::move(other.layers)),
+		layerDraws(std::move(other.layerDraws)),
+		compositor(std::move(other.compositor)),
+		targetWidth(other.targetWidth),
+		targetHeight(other.targetHeight),
+		metrics(std::move(other.metrics)),
+		metricsExporter(std::move(other.metricsExporter)),
+		resolution(std::move(other.resolution)),
+		gpuTimer(std::move(other.gpuTimer)),
+		sceneScaled(other.sceneScaled),
+#ifdef __cpp_impl_coroutine
+		coroutines(std::move(other.coroutines)),
+#endif
+		targetMoved(other.targetMoved.load())
 	{
+		// The tracker callback is bound to the old address, re-register it against this one
+		if (other.trackingHandle) {
+			other.StopTracking();
+			StartTracking();
+		}
+
 		// Clear the other object
 		other.device = nullptr;
 		other.context = nullptr;
@@ -167,6 +1033,7 @@ public:
 		other.renderTargetView = nullptr;
 		other.hWnd = nullptr;
 		other.targetWindow = nullptr;
+		other.readbackTextures = {};
 	}
 
 	// Custom move assignment
@@ -182,11 +1049,19 @@ public:
 	}
 
 	~Window() {
-		// Stop tracking thread if running
-		if (isOverlay && trackingThread.joinable()) {
-			shouldStopTracking = true;
-			trackingThread.join();
-		}
+		StopTracking();
+		metricsExporter.reset();
+#ifdef __cpp_impl_coroutine
+		coroutines.reset(); // Suspended coroutines may hold textures or layers of this window
+#endif
+
+		// Textures must go before the device they were created on
+		textures.reset();
+		layered.reset();
+		compositor.reset();
+		gpuTimer.reset();
+		for (auto* texture : readbackTextures)
+			if (texture) texture->Release();
 
 		if (renderTargetView) renderTargetView->Release();
 		if (swapChain) swapChain->Release();
@@ -195,41 +1070,159 @@ public:
 	}
 
 	/// <summary>
-	/// Shows the window and enters the message loop.
+	/// Shows the window and enters the message loop. Creates the device and swap chain and
+	/// loads the plugins first if the window was built with DeferGraphics.
 	/// </summary>
 	void Show() {
+		if (!swapChain && !CreateGraphics())
+			return;
+
 		MSG msg = {};
 		while (msg.message != WM_QUIT) {
 			if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+				// Stamped with the event's own time rather than when it was dequeued, so time spent in
+				// the queue counts. Moves a late latch already showed are not counted a second time.
+				if (IsInputMessage(msg.message) && !(IsMoveMessage(msg.message) && lastPointer.eventTick
+					&& static_cast<int32_t>(msg.time - lastPointer.eventTick) <= 0))
+					latency.InputReceived(WBEventTimeNs(latency.Now(), GetTickCount(), msg.time));
+				if (metrics)
+					metrics->messages.Add();
+				WB_ALLOC_PHASE(WBAllocPhase::Message);
 				TranslateMessage(&msg);
 				DispatchMessage(&msg);
 			}
 			else {
-				context->ClearRenderTargetView(renderTargetView, clearColor.data());
+				latency.BeginFrame();
+				WBAllocProfiler::Instance().BeginFrame();
+				{
+					WB_ALLOC_PHASE(WBAllocPhase::Update);
+					textures->Update();
+#ifdef __cpp_impl_coroutine
+					if (targetMoved.exchange(false))
+						coroutines->Raise(targetMovedSignal);
+					coroutines->Tick(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now().time_since_epoch()).count()));
+#endif
+				}
+
+				if (gpuTimer)
+					gpuTimer->Begin(context, resolution->GetScale());
+
+				if (layers.Count()) {
+					WB_ALLOC_PHASE(WBAllocPhase::Render);
+					RedrawLayers();
+				}
+
+				context->ClearRenderTargetView(BeginScene(), clearColor.data());
+				if (compositor)
+					compositor->Composite(context, layers, GetTargetWidth(), GetTargetHeight(),
+						resolution ? WBCompositePass::Scaled : WBCompositePass::All);
 
-				for (auto& plugin : plugins)
+				for (auto& plugin : plugins) {
+					WB_ALLOC_PHASE(WBAllocPhase::PreRender, PluginName(*plugin));
 					plugin->PreRender(*this);
+				}
 
-				if (onRender)
+				if (onRender) {
+					WB_ALLOC_PHASE(WBAllocPhase::Render);
 					onRender(*this);
+				}
+
+				// Plugins submit their draws in PostRender, so this is the last point to move
+				// pointer-driven content before it is committed to the frame
+				if (onLateLatch) {
+					WB_ALLOC_PHASE(WBAllocPhase::LateLatch);
+					WBPointerState pointer = SamplePointer();
+					const bool moved = pointer.x != lastPointer.x || pointer.y != lastPointer.y;
+					const bool clicked = pointer.left != lastPointer.left || pointer.right != lastPointer.right
+						|| pointer.middle != lastPointer.middle;
+					// A button change has no event time until its message is dequeued, so it counts from the sample
+					if (moved || clicked)
+						latency.InputReceived(moved ? pointer.time : pointer.sampled);
+					if (!moved)
+						pointer.eventTick = lastPointer.eventTick;
+					lastPointer = pointer;
+					latency.LateLatch();
+					onLateLatch(*this, pointer);
+				}
 
-				for (auto& plugin : plugins)
+				for (auto& plugin : plugins) {
+					if (resolution && !plugin->ScalesWithResolution())
+						continue;
+					WB_ALLOC_PHASE(WBAllocPhase::PostRender, PluginName(*plugin));
 					plugin->PostRender(*this);
+				}
+
+				if (resolution) {
+					EndScene();
+					for (auto& plugin : plugins) {
+						if (plugin->ScalesWithResolution())
+							continue;
+						WB_ALLOC_PHASE(WBAllocPhase::PostRender, PluginName(*plugin));
+						plugin->PostRender(*this);
+					}
+					UpdateResolution();
+				}
 
-				swapChain->Present(vsync ? 1 : 0, 0); // P953f
+				WB_ALLOC_PHASE(WBAllocPhase::Present);
+				if (frameRing)
+					PublishFrame();
+
+				latency.Submit();
+				bool presented = true;
+				if (layered) {
+					uint64_t skipped = layered->GetStats().framesSkipped;
+					presented = layered->Present(device, context, swapChain, hWnd) && layered->GetStats().framesSkipped == skipped;
+					if (vsync)
+						DwmFlush(); // Nothing to wait on in Present, pace to the compositor instead
+				}
+				else {
+					HRESULT result = swapChain->Present(vsync ? 1 : 0, 0); // P953f
+					presented = SUCCEEDED(result) && result != DXGI_STATUS_OCCLUDED;
+				}
+				latency.Present();
+				if (metrics)
+					UpdateMetrics(presented);
 			}
 		}
 
-		// Stop tracking thread if running
-		if (isOverlay && trackingThread.joinable()) {
-			shouldStopTracking = true;
-			trackingThread.join();
-		}
+		StopTracking();
 
 		for (auto& plugin : plugins)
 			plugin->OnUnload(*this);
 	}
 
+	/// <summary>
+	/// Samples the current pointer position and buttons, bypassing the message queue.
+	/// </summary>
+	/// <returns>Pointer state in client coordinates, stamped with the latency clock</returns>
+	WBPointerState SamplePointer() const {
+		WBPointerState pointer;
+		pointer.sampled = latency.Now();
+		pointer.time = pointer.sampled;
+		const DWORD nowTick = GetTickCount();
+		POINT position = {};
+		if (GetCursorPos(&position)) {
+			// The move history knows when the cursor arrived at its current position. Display
+			// coordinates are passed masked to 16 bits, as GetMouseMovePointsEx expects.
+			MOUSEMOVEPOINT current = {}, latest = {};
+			current.x = position.x & 0xFFFF;
+			current.y = position.y & 0xFFFF;
+			if (GetMouseMovePointsEx(sizeof(MOUSEMOVEPOINT), &current, &latest, 1, GMMP_USE_DISPLAY_POINTS) == 1) {
+				pointer.eventTick = latest.time;
+				pointer.time = WBEventTimeNs(pointer.sampled, nowTick, latest.time);
+			}
+			if (ScreenToClient(hWnd, &position)) {
+				pointer.x = position.x;
+				pointer.y = position.y;
+			}
+		}
+		pointer.left = (GetAsyncKeyState(VK_LBUTTON) & 0x8000) != 0;
+		pointer.right = (GetAsyncKeyState(VK_RBUTTON) & 0x8000) != 0;
+		pointer.middle = (GetAsyncKeyState(VK_MBUTTON) & 0x8000) != 0;
+		return pointer;
+	}
+
 	/// <summary>
 	/// Sets whether the overlay window should take focus when clicked.
 	/// Only applies to overlay windows.
@@ -258,6 +1251,102 @@ public:
 		return takeFocus;
 	}
 
+	/// <summary>
+	/// Finds a loaded plugin by type.
+	/// </summary>
+	/// <returns>The first plugin of type T, or nullptr if there is none</returns>
+	template<typename T>
+	T* GetPlugin() {
+		for (auto& plugin : plugins)
+			if (T* match = dynamic_cast<T*>(plugin.get()))
+				return match;
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Adds a retained render layer. draw renders its contents into the layer's own texture and
+	/// only runs when the layer is dirty: once after it is added, after InvalidateLayer, and when a
+	/// resize changes its size. Every frame the visible layers are composited back to front over
+	/// the clear color, below what onRender and the plugins draw. Layers must not be added or
+	/// removed from inside a draw callback.
+	/// </summary>
+	/// <param name="desc">Name, z order, opacity and resolution scale of the layer</param>
+	/// <param name="draw">Renders the layer; GetTargetWidth/Height give the size of its texture</param>
+	/// <returns>The layer id, for InvalidateLayer and the layers stack</returns>
+	WBLayerStack::Id AddLayer(const WBLayerDesc& desc, std::function<void(Window&)> draw) {
+		WBLayerStack::Id id = layers.Add(desc);
+		layerDraws.emplace_back(id, std::move(draw));
+		return id;
+	}
+
+	void RemoveLayer(WBLayerStack::Id id) {
+		layers.Remove(id);
+		layerDraws.erase(std::remove_if(layerDraws.begin(), layerDraws.end(),
+			[id](const auto& entry) { return entry.first == id; }), layerDraws.end());
+		if (compositor)
+			compositor->Release(id);
+	}
+
+	/// <summary>
+	/// Redraws a layer in the next frame.
+	/// </summary>
+	void InvalidateLayer(WBLayerStack::Id id) {
+		layers.MarkDirty(id);
+	}
+
+	/// <summary>
+	/// Gets the size of the render target being drawn: a layer's texture while it is redrawn,
+	/// otherwise the window. Coordinates stay in window pixels either way, only the viewport shrinks.
+	/// </summary>
+	int GetTargetWidth() const {
+		return targetWidth ? targetWidth : width;
+	}
+
+	int GetTargetHeight() const {
+		return targetHeight ? targetHeight : height;
+	}
+
+	/// <summary>
+	/// Gets the scale the scene is rendered at: 1 unless the window was built with DynamicResolution.
+	/// While the scene is scaled, GetTargetWidth/Height return the size of the scaled target.
+	/// </summary>
+	float GetResolutionScale() const {
+		return resolution ? resolution->GetScale() : 1.0f;
+	}
+
+#ifdef __cpp_impl_coroutine
+	/// <summary>
+	/// co_await window.NextFrame() resumes at the start of the next frame, before the layers and
+	/// onRender. Coroutines are WBTask functions; they run on the thread that calls Show(), and the
+	/// ones still suspended are destroyed with the window.
+	/// </summary>
+	WBCoroScheduler::NextFrameAwaiter NextFrame() {
+		return coroutines->NextFrame();
+	}
+
+	/// <summary>
+	/// co_await window.Delay(ms) resumes in the first frame at least ms after the current one started.
+	/// </summary>
+	WBCoroScheduler::DelayAwaiter Delay(uint32_t milliseconds) {
+		return coroutines->Delay(static_cast<uint64_t>(milliseconds) * 1000000);
+	}
+
+	/// <summary>
+	/// co_await window.Message(WM_KEYDOWN) resumes in the frame after the window receives the
+	/// message and returns it. Messages arriving while nobody waits for them are not queued.
+	/// </summary>
+	WBCoroScheduler::KeyedAwaiter Message(UINT message) {
+		return coroutines->Message(message);
+	}
+
+	/// <summary>
+	/// co_await window.TargetMoved() resumes in the frame after the overlaid window moves or resizes.
+	/// </summary>
+	WBCoroScheduler::KeyedAwaiter TargetMoved() {
+		return coroutines->Signal(targetMovedSignal);
+	}
+#endif
+
 	/// <summary>
 	/// Checks if this window is in overlay mode.
 	/// </summary>
@@ -266,6 +1355,13 @@ public:
 		return isOverlay;
 	}
 
+	/// <summary>
+	/// Checks if the device and swap chain exist. False until the first Show() with DeferGraphics.
+	/// </summary>
+	bool HasGraphics() const {
+		return swapChain != nullptr;
+	}
+
 	/// <summary>
 	/// Gets the handle of the target window being overlaid (if any).
 	/// </summary>
@@ -283,6 +1379,7 @@ public:
 		onResize(config.onResize ? config.onResize : defaultOnResize),
 		onClose(config.onClose ? config.onClose : defaultOnClose),
 		onRender(config.onRender ? config.onRender : defaultOnRender),
+		onLateLatch(config.onLateLatch),
 		plugins(std::move(config.plugins)),
 		useImmersiveTitlebar(config.useImmersiveTitlebar),
 		vsync(config.vsync), // P953f
@@ -291,7 +1388,14 @@ public:
 		targetProcessName(config.targetProcessName),
 		targetProcessId(config.targetProcessId),
 		takeFocus(config.takeFocus),
-		transparentBackground(config.transparentBackground)
+		transparentBackground(config.transparentBackground),
+		textureCacheConfig(config.textureCache),
+		frameRingName(config.frameRingName),
+		frameRingSlots(config.frameRingSlots),
+		frameRingWidth(config.frameRingWidth),
+		frameRingHeight(config.frameRingHeight),
+		perPixelAlpha(config.perPixelAlpha),
+		layeredAlpha(config.layeredAlpha)
 	{
 		// If overlay mode, try to find target window if not already specified
 		if (isOverlay && !targetWindow) {
@@ -303,18 +1407,7 @@ public:
 			}
 		}
 
-		// Register window class
-		WNDCLASS wc = {};
-		wc.lpfnWndProc = WndProc;
-		wc.hInstance = GetModuleHandle(NULL);
-#ifdef UNICODE
-		wchar_t wClassName[256];
-		swprintf(wClassName, 256, L"%hs", className);
-		wc.lpszClassName = wClassName;
-#else
-		wc.lpszClassName = className;
-#endif
-		RegisterClass(&wc);
+		WBRegisterWindowClass(className, WndProc);
 
 		// Create window with appropriate styles for overlay or normal window
 		HWND hWnd = nullptr;
@@ -327,6 +1420,9 @@ public:
 				exStyle |= WS_EX_TRANSPARENT;
 			}
 		}
+		if (perPixelAlpha) {
+			exStyle |= WS_EX_LAYERED;
+		}
 
 		// Get target window position and size for overlay
 		int x = CW_USEDEFAULT, y = CW_USEDEFAULT;
@@ -341,6 +1437,8 @@ public:
 		}
 
 #ifdef UNICODE
+		wchar_t wClassName[256];
+		swprintf(wClassName, 256, L"%hs", className);
 		wchar_t wTitle[256];
 		swprintf(wTitle, 256, L"%hs", title);
 		hWnd = CreateWindowEx(exStyle, wClassName, wTitle, windowStyle,
@@ -357,8 +1455,9 @@ public:
 		this->hWnd = hWnd;
 		this->hInstance = GetModuleHandle(NULL);
 
-		// Set up layered window attributes for overlay
-		if (isOverlay) {
+		// Set up layered window attributes for overlay. Per-pixel alpha windows take their
+		// opacity from the frame instead and must not have any set.
+		if (isOverlay && !perPixelAlpha) {
 			// Set transparency
 			BYTE alpha = transparentBackground ? 200 : 255; // Semi-transparent background
 			SetLayeredWindowAttributes(hWnd, RGB(0, 0, 0), alpha, LWA_ALPHA);
@@ -366,84 +1465,22 @@ public:
 
 		// Optionally enable an immersive (e.g., dark mode) titlebar
 		if (useImmersiveTitlebar && !isOverlay) {
-			HKEY hKey = nullptr;
-			if (RegOpenKeyEx(HKEY_CURRENT_USER,
-#ifdef UNICODE
-				L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
-#else
-				"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
-#endif
-				0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-				DWORD value = 0;
-				DWORD size = sizeof(DWORD);
-				if (RegQueryValueEx(hKey,
-#ifdef UNICODE
-					L"AppsUseLightTheme",
-#else
-					"AppsUseLightTheme",
-#endif
-					NULL, NULL,
-					reinterpret_cast<LPBYTE>(&value), &size) == ERROR_SUCCESS) {
-					BOOL dark = value == 0;
-					DwmSetWindowAttribute(hWnd, DWMWA_USE_IMMERSIVE_DARK_MODE,
-						&dark, sizeof(BOOL));
-				}
-				RegCloseKey(hKey);
-			}
-		}
-
-		// Create DX11 device and swap chain
-		DXGI_SWAP_CHAIN_DESC scd = {};
-		scd.BufferCount = 1;
-		scd.BufferDesc.Width = width;
-		scd.BufferDesc.Height = height;
-		scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		scd.BufferDesc.RefreshRate.Numerator = 60;
-		scd.BufferDesc.RefreshRate.Denominator = 1;
-		scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-		scd.OutputWindow = hWnd;
-		scd.SampleDesc.Count = 1;
-		scd.SampleDesc.Quality = 0;
-		scd.Windowed = TRUE;
-
-		HRESULT res = D3D11CreateDeviceAndSwapChain(
-			nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0,
-			nullptr, 0, D3D11_SDK_VERSION, &scd,
-			&swapChain, &device, nullptr, &context);
-		if (res != S_OK) {
-			std::cerr << "Failed to create device and swap chain" << std::endl;
-			LPSTR errorMsg = nullptr;
-			FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
-				FORMAT_MESSAGE_IGNORE_INSERTS,
-				nullptr, res, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-				reinterpret_cast<LPSTR>(&errorMsg), 0, nullptr);
-			std::cerr << errorMsg << std::endl;
-			LocalFree(errorMsg);
-			return;
+			BOOL dark = WBAppsUseDarkTheme();
+			DwmSetWindowAttribute(hWnd, DWMWA_USE_IMMERSIVE_DARK_MODE,
+				&dark, sizeof(BOOL));
 		}
 
-		// Create render target view
-		ID3D11Texture2D* backBuffer = nullptr;
-		swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D),
-			reinterpret_cast<void**>(&backBuffer));
-		assert(backBuffer != nullptr);
-		device->CreateRenderTargetView(backBuffer, nullptr, &renderTargetView);
-		backBuffer->Release();
+		for (auto& layer : config.layers)
+			AddLayer(layer.first, std::move(layer.second));
 
-		ShowWindow(hWnd, SW_SHOW);
-		UpdateWindow(hWnd);
+		if (config.metricsPort || config.metricsPipe)
+			StartMetrics(config.metricsPort, config.metricsPipe);
 
-		context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+		if (config.dynamicResolution)
+			resolution = std::make_unique<WBDynamicResolution>(config.resolution);
 
-		// Start tracking thread for overlay mode
-		if (isOverlay && targetWindow) {
-			shouldStopTracking = false;
-			trackingThread = std::thread(&Window::TrackTargetWindow, this);
-		}
-
-		// Notify plugins that the window has loaded
-		for (auto& plugin : plugins)
-			plugin->OnLoad(*this);
+		if (!config.deferGraphics)
+			CreateGraphics();
 	}
 
 	// DX11/Win32 objects
@@ -463,6 +1500,7 @@ public:
 	std::function<void(Window&)> onResize = defaultOnResize;
 	std::function<void(Window&)> onClose = defaultOnClose;
 	std::function<void(Window&)> onRender = defaultOnRender;
+	std::function<void(Window&, const WBPointerState&)> onLateLatch = nullptr;
 	std::vector<std::unique_ptr<WBPlugin>> plugins = {};
 	bool useImmersiveTitlebar = false;
 	bool vsync = false; // P953f
@@ -474,8 +1512,56 @@ public:
 	DWORD targetProcessId = 0;
 	std::atomic<bool> takeFocus = false;
 	bool transparentBackground = true;
-	std::thread trackingThread;
-	std::atomic<bool> shouldStopTracking = false;
+	WBTracker::Handle trackingHandle = 0;
+	RECT lastTargetRect = {};
+
+	// Texture cache, decodes on worker threads and uploads from the Show() loop.
+	// Use textures->Acquire(path) once and textures->Get(key) every frame.
+	WBTextureCacheConfig textureCacheConfig;
+	std::unique_ptr<WBTextureCache> textures;
+
+	// Shared-memory frame publishing, see WBFrameRingConsumer for the reading side
+	const char* frameRingName = nullptr;
+	int frameRingSlots = 3;
+	int frameRingWidth = 0;
+	int frameRingHeight = 0;
+	std::unique_ptr<WBFrameRingProducer> frameRing;
+	std::array<ID3D11Texture2D*, 2> readbackTextures = {};
+	uint64_t readbackFrame = 0;
+
+	// Set for per-pixel alpha windows, replaces the swap chain's Present. See layered->GetStats()
+	bool perPixelAlpha = false;
+	WBLayeredAlpha layeredAlpha = WBLayeredAlpha::Premultiplied;
+	std::unique_ptr<WBLayeredPresenter> layered;
+
+	// Input-to-present bookkeeping of the Show() loop, see latency.GetStats()
+	WBLatencyTracker latency;
+	WBPointerState lastPointer;
+
+	// Retained render layers, see AddLayer. Redraw and composite costs are in layers.GetAllStats()
+	WBLayerStack layers;
+	std::vector<std::pair<WBLayerStack::Id, std::function<void(Window&)>>> layerDraws;
+	std::unique_ptr<WBLayerCompositor> compositor;
+	int targetWidth = 0;  // Size of the layer being redrawn or of the scaled scene, 0 while drawing to the window
+	int targetHeight = 0;
+
+	// Dynamic resolution controller fed by gpuTimer, null unless the window was built with
+	// DynamicResolution. See resolution->GetStats()
+	std::unique_ptr<WBDynamicResolution> resolution;
+	std::unique_ptr<WBGpuFrameTimer> gpuTimer;
+	bool sceneScaled = false; // The scene of this frame went into the compositor's scene surface
+
+	// Runtime counters served by metricsExporter, null unless the window was built with ExportMetrics
+	std::unique_ptr<WBMetrics> metrics;
+	std::unique_ptr<WBMetricsExporter> metricsExporter;
+
+#ifdef __cpp_impl_coroutine
+	// Resumes the coroutines waiting on NextFrame, Delay, Message and TargetMoved. Held by
+	// pointer because suspended coroutines refer to it and the window can be moved.
+	std::unique_ptr<WBCoroScheduler> coroutines = std::make_unique<WBCoroScheduler>();
+	static constexpr uint32_t targetMovedSignal = 1;
+#endif
+	std::atomic<bool> targetMoved = false; // Set by the tracker thread, raised from Show()
 
 	// Window procedure
 	static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
@@ -485,6 +1571,8 @@ public:
 			case WM_SIZE:
 				window->width = LOWORD(lParam);
 				window->height = HIWORD(lParam);
+				if (window->metrics)
+					window->metrics->resizes.Add();
 				if (window->onResize)
 					window->onResize(*window);
 				break;
@@ -494,148 +1582,329 @@ public:
 				break;
 			}
 
-			for (auto& plugin : window->plugins)
+			for (auto& plugin : window->plugins) {
+				WB_ALLOC_PHASE(WBAllocPhase::Message, PluginName(*plugin));
 				plugin->HandleMessage(*window, message, wParam, lParam);
+			}
+#ifdef __cpp_impl_coroutine
+			if (window->coroutines)
+				window->coroutines->Post(message, static_cast<uint64_t>(wParam), static_cast<int64_t>(lParam));
+#endif
 		}
 
 		return DefWindowProc(hWnd, message, wParam, lParam);
 	}
 
 private:
-	// Helper methods for overlay functionality
-	HWND FindTargetWindow() {
-		if (targetProcessId != 0) {
-			return FindWindowByProcessId(targetProcessId);
+	// Creates the device, swap chain and everything rendering depends on, shows the window, loads the
+	// plugins and then starts following the target window for overlays. Runs from the constructor, or
+	// from the first Show() with DeferGraphics.
+	bool CreateGraphics() {
+		WB_ALLOC_PHASE(WBAllocPhase::Build);
+
+		// Create DX11 device and swap chain
+		DXGI_SWAP_CHAIN_DESC scd = {};
+		scd.BufferCount = 1;
+		scd.BufferDesc.Width = width;
+		scd.BufferDesc.Height = height;
+		scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		scd.BufferDesc.RefreshRate.Numerator = 60;
+		scd.BufferDesc.RefreshRate.Denominator = 1;
+		scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		scd.OutputWindow = hWnd;
+		scd.SampleDesc.Count = 1;
+		scd.SampleDesc.Quality = 0;
+		scd.Windowed = TRUE;
+
+		HRESULT res = D3D11CreateDeviceAndSwapChain(
+			nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0,
+			nullptr, 0, D3D11_SDK_VERSION, &scd,
+			&swapChain, &device, nullptr, &context);
+		if (res != S_OK) {
+			std::cerr << "Failed to create device and swap chain" << std::endl;
+			LPSTR errorMsg = nullptr;
+			FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+				FORMAT_MESSAGE_IGNORE_INSERTS,
+				nullptr, res, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+				reinterpret_cast<LPSTR>(&errorMsg), 0, nullptr);
+			std::cerr << errorMsg << std::endl;
+			LocalFree(errorMsg);
+			return false;
+		}
+
+		// Create render target view
+		ID3D11Texture2D* backBuffer = nullptr;
+		swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D),
+			reinterpret_cast<void**>(&backBuffer));
+		assert(backBuffer != nullptr);
+		device->CreateRenderTargetView(backBuffer, nullptr, &renderTargetView);
+		backBuffer->Release();
+
+		ShowWindow(hWnd, SW_SHOW);
+		UpdateWindow(hWnd);
+
+		context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+
+		textures = std::make_unique<WBTextureCache>(std::make_unique<WBD3D11TextureBackend>(device),
+			textureCacheConfig, WBDecodeImageWIC);
+
+		if (perPixelAlpha)
+			layered = std::make_unique<WBLayeredPresenter>(layeredAlpha);
+
+		if (resolution)
+			gpuTimer = std::make_unique<WBGpuFrameTimer>(device);
+
+		if (frameRingName) {
+			// Fixed capacity: consumers map the ring once, so frames of a window grown past it are cropped
+			frameRing = std::make_unique<WBFrameRingProducer>();
+			if (!frameRing->Create(frameRingName, static_cast<uint32_t>(frameRingWidth > 0 ? frameRingWidth : width),
+				static_cast<uint32_t>(frameRingHeight > 0 ? frameRingHeight : height), static_cast<uint32_t>(frameRingSlots))) {
+				std::cerr << "Failed to create frame ring " << frameRingName << std::endl;
+				frameRing.reset();
+			}
 		}
-		else if (targetProcessName) {
-			return FindWindowByProcessName(targetProcessName);
+
+		// Notify plugins that the window has loaded
+		for (auto& plugin : plugins)
+			plugin->OnLoad(*this);
+
+		// Register with the shared tracker for overlay mode. Only now: its thread resizes the window,
+		// which must not race the swap chain and plugins being set up
+		if (isOverlay && targetWindow) {
+			GetWindowRect(targetWindow, &lastTargetRect);
+			StartTracking();
 		}
-		return nullptr;
+		return true;
 	}
 
-	HWND FindWindowByProcessId(DWORD processId) {
-		struct EnumData {
-			DWORD targetPid;
-			HWND result;
-		};
-		
-		EnumData data = { processId, nullptr };
-		
-		EnumWindows([](HWND hwnd, LPARAM lParam) -> BOOL {
-			EnumData* data = reinterpret_cast<EnumData*>(lParam);
-			DWORD pid;
-			GetWindowThreadProcessId(hwnd, &pid);
-			if (pid == data->targetPid && IsWindowVisible(hwnd)) {
-				data->result = hwnd;
-				return FALSE; // Stop enumeration
+	// Renders the dirty layers into their textures, then rebinds the backbuffer and its viewport
+	void RedrawLayers() {
+		if (!compositor)
+			compositor = std::make_unique<WBLayerCompositor>(device);
+		layers.Resize(width, height);
+
+		const std::vector<WBLayerStack::Id>& dirty = layers.CollectDirty();
+		if (dirty.empty())
+			return;
+		const float transparent[4] = {};
+		for (WBLayerStack::Id id : dirty) {
+			auto draw = std::find_if(layerDraws.begin(), layerDraws.end(),
+				[id](const auto& entry) { return entry.first == id; });
+			int layerWidth = 0, layerHeight = 0;
+			layers.GetSize(id, layerWidth, layerHeight);
+			ID3D11RenderTargetView* target = compositor->Target(device, id, layerWidth, layerHeight);
+			if (!target) {
+				layers.MarkDirty(id); // CollectDirty cleared the flag; try again next frame
+				continue;
 			}
-			return TRUE; // Continue enumeration
-		}, reinterpret_cast<LPARAM>(&data));
-		
-		return data.result;
+			if (draw == layerDraws.end())
+				continue;
+
+			auto start = std::chrono::steady_clock::now();
+			D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(layerWidth), static_cast<float>(layerHeight), 0.0f, 1.0f };
+			context->OMSetRenderTargets(1, &target, nullptr);
+			context->ClearRenderTargetView(target, transparent);
+			context->RSSetViewports(1, &viewport);
+			targetWidth = layerWidth;
+			targetHeight = layerHeight;
+			draw->second(*this);
+			layers.Redrawn(id, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		targetWidth = targetHeight = 0;
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f };
+		context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+		context->RSSetViewports(1, &viewport);
 	}
 
-	HWND FindWindowByProcessName(const char* processName) {
-		// Use NT API to avoid detection
-		HMODULE ntdll = GetModuleHandleA("ntdll.dll");
-		if (!ntdll) return nullptr;
+	// Binds the render target of the scene: the backbuffer, or with dynamic resolution below full
+	// scale a texture of the scaled size
+	ID3D11RenderTargetView* BeginScene() {
+		sceneScaled = false;
+		if (!resolution || resolution->GetScale() >= 1.0f)
+			return renderTargetView;
+		if (!compositor)
+			compositor = std::make_unique<WBLayerCompositor>(device);
+
+		int sceneWidth = std::max(1, static_cast<int>(std::lround(width * resolution->GetScale())));
+		int sceneHeight = std::max(1, static_cast<int>(std::lround(height * resolution->GetScale())));
+		ID3D11RenderTargetView* target = compositor->Target(device, WBLayerCompositor::sceneSurface, sceneWidth, sceneHeight);
+		if (!target)
+			return renderTargetView;
+
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(sceneWidth), static_cast<float>(sceneHeight), 0.0f, 1.0f };
+		context->OMSetRenderTargets(1, &target, nullptr);
+		context->RSSetViewports(1, &viewport);
+		targetWidth = sceneWidth;
+		targetHeight = sceneHeight;
+		sceneScaled = true;
+		return target;
+	}
 
-		NtQuerySystemInformation_t NtQuerySystemInformation = 
-			reinterpret_cast<NtQuerySystemInformation_t>(GetProcAddress(ntdll, "NtQuerySystemInformation"));
-		if (!NtQuerySystemInformation) return nullptr;
+	// Upscales the scaled scene into the backbuffer, then composites the full resolution layers over it
+	void EndScene() {
+		if (sceneScaled) {
+			const float transparent[4] = {};
+			targetWidth = targetHeight = 0;
+			context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+			context->ClearRenderTargetView(renderTargetView, transparent);
+			compositor->Blit(context, WBLayerCompositor::sceneSurface, width, height);
+			sceneScaled = false;
+		}
+		if (compositor)
+			compositor->Composite(context, layers, width, height, WBCompositePass::FullResolution);
+	}
 
-		ULONG bufferSize = 0x10000;
-		std::vector<BYTE> buffer(bufferSize);
+	// Ends the GPU timing of this frame and feeds the finished ones to the controller. Frames
+	// rendered at another scale than the current one are dropped, they would skew its window.
+	void UpdateResolution() {
+		gpuTimer->End(context);
+		double ms = 0.0;
+		float scale = 1.0f;
+		while (gpuTimer->Read(context, ms, scale))
+			if (scale == resolution->GetScale())
+				resolution->Update(ms);
+	}
 
-		NTSTATUS status = NtQuerySystemInformation(SystemProcessInformation, 
-			buffer.data(), bufferSize, &bufferSize);
-		
-		if (status == STATUS_INFO_LENGTH_MISMATCH) {
-			buffer.resize(bufferSize);
-			status = NtQuerySystemInformation(SystemProcessInformation, 
-				buffer.data(), bufferSize, &bufferSize);
+	// Starts the exporter threads. They only read atomics, so a scrape never holds up a frame.
+	void StartMetrics(uint16_t port, const char* pipe) {
+		metrics = std::make_unique<WBMetrics>();
+		metrics->collectExtra = [](WBPrometheusWriter& out) {
+			WBTrackerStats tracker = WBTracker::Instance().GetStats();
+			out.Counter("wb_tracker_wakeups_total", "Wakeups of the shared target tracking thread.", tracker.wakeups);
+			out.Counter("wb_tracker_moves_total", "Target moves seen by the tracking thread.", tracker.moves);
+			out.Gauge("wb_tracker_targets", "Targets registered with the tracking thread.", static_cast<double>(tracker.targets));
+		};
+
+		WBMetrics* counters = metrics.get(); // Stays put when the Window is moved
+		metricsExporter = std::make_unique<WBMetricsExporter>([counters](std::string& out) {
+			WBPrometheusWriter writer(out);
+			counters->Write(writer);
+		});
+		if (port && !metricsExporter->ListenTcp(port))
+			std::cerr << "Failed to serve metrics on 127.0.0.1:" << port << std::endl;
+		if (pipe && !metricsExporter->ListenPipe(pipe))
+			std::cerr << "Failed to serve metrics on pipe " << pipe << std::endl;
+	}
+
+	// Render thread side of the metrics: counts the frame and now and then refreshes the resource
+	// gauges, skipping the texture cache while its workers hold the lock
+	void UpdateMetrics(bool presented) {
+		metrics->FrameFinished(presented);
+		if (metrics->framesRendered.Load() % 32 != 1)
+			return;
+		WBTextureStats textureStats;
+		if (textures && textures->TryGetStats(textureStats)) {
+			metrics->texturesResident.Set(static_cast<int64_t>(textureStats.residentTextures));
+			metrics->textureBytesResident.Set(static_cast<int64_t>(textureStats.residentBytes));
 		}
+		metrics->renderLayers.Set(static_cast<int64_t>(layers.Count()));
+	}
 
-		if (status != STATUS_SUCCESS) return nullptr;
+	// Plugin tag for the allocation profiler
+	static const char* PluginName(const WBPlugin& plugin) {
+		return typeid(plugin).name();
+	}
 
-		PSYSTEM_PROCESS_INFORMATION processInfo = 
-			reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(buffer.data());
+	static bool IsMoveMessage(UINT message) {
+		return message == WM_MOUSEMOVE || message == 0x0245; // WM_POINTERUPDATE
+	}
 
-		BYTE* bufferEnd = buffer.data() + buffer.size();
-		
-		while (processInfo->NextEntryOffset != 0) {
-			if (processInfo->ImageName.Buffer) {
-				// Convert UNICODE_STRING to char*
-				int len = WideCharToMultiByte(CP_UTF8, 0, processInfo->ImageName.Buffer, 
-					processInfo->ImageName.Length / sizeof(WCHAR), nullptr, 0, nullptr, nullptr);
-				if (len > 0) {
-					std::vector<char> processNameBuffer(len + 1);
-					WideCharToMultiByte(CP_UTF8, 0, processInfo->ImageName.Buffer, 
-						processInfo->ImageName.Length / sizeof(WCHAR), 
-						processNameBuffer.data(), len, nullptr, nullptr);
-					processNameBuffer[len] = '\0';
-
-					if (strcmp(processNameBuffer.data(), processName) == 0) {
-						DWORD pid = static_cast<DWORD>(reinterpret_cast<uintptr_t>(processInfo->ProcessId));
-						return FindWindowByProcessId(pid);
-					}
-				}
-			}
+	static bool IsInputMessage(UINT message) {
+		return (message >= WM_KEYFIRST && message <= WM_KEYLAST) || (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST)
+			|| message == WM_INPUT || message == WM_TOUCH || (message >= 0x0245 && message <= 0x0257); // WM_POINTER*
+	}
 
-			// Move to next process info, with bounds checking
-			BYTE* nextPtr = reinterpret_cast<BYTE*>(processInfo) + processInfo->NextEntryOffset;
-			if (nextPtr >= bufferEnd) break; // Prevent buffer overflow
-			
-			processInfo = reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(nextPtr);
-		}
+	// Helper methods for overlay functionality
+	HWND FindTargetWindow() {
+		return WBFindTargetWindow(targetProcessId, targetProcessName);
+	}
 
-		return nullptr;
+	void StartTracking() {
+		trackingHandle = WBTracker::Instance().Register([this] { return PollTargetWindow(); });
 	}
 
-	void TrackTargetWindow() {
-		RECT lastRect = {};
-		GetWindowRect(targetWindow, &lastRect);
+	void StopTracking() {
+		if (!trackingHandle) return;
+		WBTracker::Instance().Unregister(trackingHandle);
+		trackingHandle = 0;
+	}
 
-		while (!shouldStopTracking) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60 FPS
+	// Runs on the shared tracker thread
+	WBTrackResult PollTargetWindow() {
+		if (!IsWindow(targetWindow)) {
+			// Target window was closed
+			PostMessage(hWnd, WM_CLOSE, 0, 0);
+			return WBTrackResult::Gone;
+		}
 
-			if (!IsWindow(targetWindow)) {
-				// Target window was closed
-				PostMessage(hWnd, WM_CLOSE, 0, 0);
-				break;
-			}
+		RECT currentRect;
+		if (!GetWindowRect(targetWindow, &currentRect))
+			return WBTrackResult::Unchanged;
 
-			RECT currentRect;
-			if (GetWindowRect(targetWindow, &currentRect)) {
-				// Check if position or size changed
-				if (memcmp(&lastRect, &currentRect, sizeof(RECT)) != 0) {
-					int newWidth = currentRect.right - currentRect.left;
-					int newHeight = currentRect.bottom - currentRect.top;
-
-					SetWindowPos(hWnd, HWND_TOPMOST,
-						currentRect.left, currentRect.top,
-						newWidth, newHeight,
-						SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS);
-
-					// Update internal size if changed
-					if (newWidth != width || newHeight != height) {
-						width = newWidth;
-						height = newHeight;
-						
-						// Trigger resize handling
-						if (onResize) {
-							onResize(*this);
-						}
-					}
+		// Check if position or size changed
+		if (memcmp(&lastTargetRect, &currentRect, sizeof(RECT)) == 0)
+			return WBTrackResult::Unchanged;
 
-					lastRect = currentRect;
-				}
+		int newWidth = currentRect.right - currentRect.left;
+		int newHeight = currentRect.bottom - currentRect.top;
+
+		// Asynchronous, so the move is carried out by the window's own thread. A size change arrives
+		// there as WM_SIZE, which updates width/height and runs onResize next to the rendering it
+		// affects instead of on the tracker thread every overlay shares.
+		SetWindowPos(hWnd, HWND_TOPMOST,
+			currentRect.left, currentRect.top,
+			newWidth, newHeight,
+			SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS);
+
+		lastTargetRect = currentRect;
+		targetMoved = true;
+		return WBTrackResult::Moved;
+	}
+
+	// Copies the backbuffer into a staging texture and publishes the copy made the frame before,
+	// so mapping it does not stall on the GPU finishing the current frame
+	void PublishFrame() {
+		ID3D11Texture2D* backBuffer = nullptr;
+		swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer));
+		D3D11_TEXTURE2D_DESC desc = {};
+		backBuffer->GetDesc(&desc);
+
+		ID3D11Texture2D*& staging = readbackTextures[readbackFrame % 2];
+		if (staging) {
+			D3D11_TEXTURE2D_DESC stagingDesc = {};
+			staging->GetDesc(&stagingDesc);
+			if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height) {
+				staging->Release();
+				staging = nullptr;
 			}
 		}
+		if (!staging) {
+			desc.Usage = D3D11_USAGE_STAGING;
+			desc.BindFlags = 0;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			desc.MiscFlags = 0;
+			device->CreateTexture2D(&desc, nullptr, &staging);
+		}
+		if (staging)
+			context->CopyResource(staging, backBuffer);
+		backBuffer->Release();
+
+		ID3D11Texture2D* ready = readbackTextures[(readbackFrame + 1) % 2];
+		if (readbackFrame++ == 0 || !ready)
+			return;
+
+		D3D11_TEXTURE2D_DESC readyDesc = {};
+		ready->GetDesc(&readyDesc);
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (SUCCEEDED(context->Map(ready, 0, D3D11_MAP_READ, 0, &mapped))) {
+			frameRing->Publish(static_cast<const uint8_t*>(mapped.pData), readyDesc.Width, readyDesc.Height, mapped.RowPitch);
+			context->Unmap(ready, 0);
+		}
 	}
 
 	// Default callback implementations
 	static void defaultOnResize(Window& window) {
+		if (!window.swapChain) return; // Graphics deferred to the first Show()
 		if (window.renderTargetView) window.renderTargetView->Release();
 		window.swapChain->ResizeBuffers(0, window.width, window.height, DXGI_FORMAT_UNKNOWN, 0);
 		ID3D11Texture2D* backBuffer = nullptr;
@@ -682,6 +1951,17 @@ public:
 		config.onRender = onRender;
 		return *this;
 	}
+
+	/// <summary>
+	/// Sets a callback that runs after onRender and before plugins submit their draws, with
+	/// the pointer sampled at that moment, so pointer-driven content lags a frame less.
+	/// </summary>
+	/// <param name="onLateLatch">Callback receiving the freshly sampled pointer</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& OnLateLatch(std::function<void(Window&, const WBPointerState&)> onLateLatch) {
+		config.onLateLatch = onLateLatch;
+		return *this;
+	}
 	WindowBuilder& ImmersiveTitlebar(bool useImmersiveTitlebar = true) {
 		config.useImmersiveTitlebar = useImmersiveTitlebar;
 		return *this;
@@ -691,6 +1971,66 @@ public:
 		return *this;
 	}
 
+	/// <summary>
+	/// Creates the device and swap chain and loads the plugins in the first Show() instead of
+	/// Build(), so building a window that is never shown stays cheap. device, context and
+	/// textures are null until then.
+	/// </summary>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& DeferGraphics(bool defer = true) {
+		config.deferGraphics = defer;
+		return *this;
+	}
+
+	/// <summary>
+	/// Publishes every finished frame into a named shared-memory ring that other processes can
+	/// read with WBFrameRingConsumer. The ring is allocated once for maxWidth x maxHeight and never
+	/// reallocated, because consumers map it only once; if the window grows past that, the right and
+	/// bottom of its frames are cropped and every slot reports the cropped size.
+	/// Creating the ring fails if another process already publishes under the same name.
+	/// </summary>
+	/// <param name="name">Name of the shared-memory mapping</param>
+	/// <param name="slots">Number of frames kept in the ring</param>
+	/// <param name="maxWidth">Widest frame published uncropped, 0 for the window's initial width</param>
+	/// <param name="maxHeight">Tallest frame published uncropped, 0 for the window's initial height</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& PublishFrames(const char* name, int slots = 3, int maxWidth = 0, int maxHeight = 0) {
+		config.frameRingName = name;
+		config.frameRingSlots = slots;
+		config.frameRingWidth = maxWidth;
+		config.frameRingHeight = maxHeight;
+		return *this;
+	}
+
+	/// <summary>
+	/// Presents frames with UpdateLayeredWindow instead of the swap chain, so the alpha of every
+	/// rendered pixel becomes its opacity on the desktop and fully transparent pixels pass clicks
+	/// through. Replaces the uniform alpha of transparent overlays. A still-default clear color
+	/// becomes transparent black.
+	/// </summary>
+	/// <param name="alpha">Premultiplied when rendering with the usual alpha blending over a
+	/// transparent clear, Straight when the frame holds unmultiplied color</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& PerPixelAlpha(WBLayeredAlpha alpha = WBLayeredAlpha::Premultiplied) {
+		config.perPixelAlpha = true;
+		config.layeredAlpha = alpha;
+		if (config.clearColor == WindowConfig().clearColor)
+			config.clearColor = { 0.0f, 0.0f, 0.0f, 0.0f };
+		return *this;
+	}
+
+	/// <summary>
+	/// Configures the window's texture cache.
+	/// </summary>
+	/// <param name="budgetBytes">Resident GPU memory before unreferenced textures are evicted</param>
+	/// <param name="uploadsPerFrame">Maximum number of textures uploaded per frame</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& TextureCache(size_t budgetBytes, int uploadsPerFrame = 4) {
+		config.textureCache.budgetBytes = budgetBytes;
+		config.textureCache.uploadsPerFrame = uploadsPerFrame;
+		return *this;
+	}
+
 	/// <summary>
 	/// Configures the window to attach to and overlay on top of a target window by handle.
 	/// </summary>
@@ -736,6 +2076,44 @@ public:
 		return *this;
 	}
 
+	/// <summary>
+	/// Serves the window's runtime counters in the Prometheus text format: frames rendered and
+	/// skipped, frame time histogram and recent quantiles, presents, resizes, messages, tracker
+	/// wakeups and resident textures. The render thread only does relaxed atomic adds.
+	/// </summary>
+	/// <param name="port">HTTP port on 127.0.0.1 (GET /metrics), 0 for none</param>
+	/// <param name="pipeName">Named pipe \\.\pipe\pipeName that hands every client the text, or nullptr</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& ExportMetrics(uint16_t port, const char* pipeName = nullptr) {
+		config.metricsPort = port;
+		config.metricsPipe = pipeName;
+		return *this;
+	}
+
+	/// <summary>
+	/// Adds a retained render layer drawn by a callback, see Window::AddLayer.
+	/// </summary>
+	/// <param name="desc">Name, z order, opacity and resolution scale of the layer</param>
+	/// <param name="draw">Renders the layer's contents when it is dirty</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& Layer(const WBLayerDesc& desc, std::function<void(Window&)> draw) {
+		config.layers.emplace_back(desc, std::move(draw));
+		return *this;
+	}
+
+	/// <summary>
+	/// Renders the scene into a scaled target that is upscaled to the swap chain, at a scale a
+	/// controller adjusts to keep the GPU time of a frame inside a budget. Layers with
+	/// fullResolution and plugins whose ScalesWithResolution() is false are drawn after the upscale.
+	/// </summary>
+	/// <param name="resolution">Budget, scale limits and hysteresis of the controller</param>
+	/// <returns>WindowBuilder reference for chaining</returns>
+	WindowBuilder& DynamicResolution(const WBDynamicResolutionConfig& resolution = {}) {
+		config.dynamicResolution = true;
+		config.resolution = resolution;
+		return *this;
+	}
+
 	template<typename T>
 	WindowBuilder& Plugin() {
 		config.plugins.emplace_back(std::make_unique<T>());
@@ -747,9 +2125,35 @@ public:
 	/// </summary>
 	/// <returns>The new Window instance, heap-allocated with a unique pointer.</returns>
 	std::unique_ptr<Window> Build() {
+		WB_ALLOC_PHASE(WBAllocPhase::Build);
 		return std::make_unique<Window>(std::move(config));
 	}
 
+	/// <summary>
+	/// Resolves the configured attach target without creating anything.
+	/// </summary>
+	/// <returns>The target window, or nullptr if it does not exist or no target is configured.</returns>
+	HWND Probe() const {
+		if (!config.isOverlay)
+			return nullptr;
+		if (config.targetWindow)
+			return IsWindow(config.targetWindow) ? config.targetWindow : nullptr;
+		return WBFindTargetWindow(config.targetProcessId, config.targetProcessName);
+	}
+
+	/// <summary>
+	/// Builds an overlay only if its target exists. Unlike Build(), which falls back to a plain
+	/// window, nothing is created when the target is missing.
+	/// </summary>
+	/// <returns>The attached overlay, or nullptr if the target was not found.</returns>
+	std::unique_ptr<Window> TryAttach() {
+		HWND target = Probe();
+		if (!target)
+			return nullptr;
+		config.targetWindow = target;
+		return Build();
+	}
+
 private:
 	WindowConfig config;
 };
@@ -0,0 +1,466 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Platform independent allocation profiler. Window::Show() tags every phase of the frame loop
+// (and the plugin running in it) in a thread-local; the profiler attributes each allocation to
+// the tag of the thread making it. Counting only happens when the global operator new/delete
+// replacements are compiled in: define WB_ALLOC_PROFILER_IMPLEMENTATION in exactly one .cpp
+// file before including this header. Without it the phase tags are the only cost.
+
+/// <summary>
+/// Phase of the window's life an allocation was made in.
+/// </summary>
+enum class WBAllocPhase : uint8_t {
+	Other,      // Untagged: worker threads, main() outside of Show()
+	Build,      // WindowBuilder::Build() and deferred graphics creation
+	Message,    // Message dispatch, including plugins' HandleMessage
+	Update,     // Texture cache uploads at the start of a frame
+	PreRender,
+	Render,     // onRender
+	LateLatch,
+	PostRender,
+	Present,    // Frame publishing and presentation
+	Count
+};
+
+inline const char* WBAllocPhaseName(WBAllocPhase phase) {
+	static const char* names[] = { "Other", "Build", "Message", "Update", "PreRender", "Render", "LateLatch", "PostRender", "Present" };
+	return phase < WBAllocPhase::Count ? names[static_cast<int>(phase)] : "?";
+}
+
+/// <summary>
+/// What the current thread is doing, read by the allocation hooks.
+/// </summary>
+struct WBAllocTag {
+	WBAllocPhase phase = WBAllocPhase::Other;
+	const char* plugin = nullptr; // Plugin running in the phase, nullptr for the window itself
+	bool forbidden = false;       // Inside a WBNoAllocScope
+	bool suspended = false;       // Inside the profiler itself, allocations are not counted
+};
+
+inline WBAllocTag& WBCurrentAllocTag() {
+	thread_local WBAllocTag tag;
+	return tag;
+}
+
+/// <summary>
+/// Tags the current thread with a phase and plugin until the end of the scope.
+/// </summary>
+class WBAllocScope {
+public:
+	explicit WBAllocScope(WBAllocPhase phase, const char* plugin = nullptr) : previous(WBCurrentAllocTag()) {
+		WBAllocTag& tag = WBCurrentAllocTag();
+		tag.phase = phase;
+		tag.plugin = plugin;
+	}
+	~WBAllocScope() {
+		WBAllocTag& tag = WBCurrentAllocTag();
+		tag.phase = previous.phase;
+		tag.plugin = previous.plugin;
+	}
+	WBAllocScope(const WBAllocScope&) = delete;
+	WBAllocScope& operator=(const WBAllocScope&) = delete;
+
+private:
+	WBAllocTag previous;
+};
+
+/// <summary>
+/// Any allocation on the current thread until the end of the scope counts as a violation.
+/// </summary>
+class WBNoAllocScope {
+public:
+	WBNoAllocScope() : previous(WBCurrentAllocTag().forbidden) { WBCurrentAllocTag().forbidden = true; }
+	~WBNoAllocScope() { WBCurrentAllocTag().forbidden = previous; }
+	WBNoAllocScope(const WBNoAllocScope&) = delete;
+	WBNoAllocScope& operator=(const WBNoAllocScope&) = delete;
+
+private:
+	bool previous;
+};
+
+#define WB_ALLOC_CONCAT_INNER(a, b) a##b
+#define WB_ALLOC_CONCAT(a, b) WB_ALLOC_CONCAT_INNER(a, b)
+/// Tags the rest of the enclosing scope: WB_ALLOC_PHASE(WBAllocPhase::Render) or WB_ALLOC_PHASE(phase, pluginName)
+#define WB_ALLOC_PHASE(...) WBAllocScope WB_ALLOC_CONCAT(wbAllocScope, __LINE__)(__VA_ARGS__)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WB_RETURN_ADDRESS() _ReturnAddress()
+#define WB_NOINLINE __declspec(noinline)
+#else
+#define WB_RETURN_ADDRESS() __builtin_return_address(0)
+#define WB_NOINLINE __attribute__((noinline))
+#endif
+
+struct WBAllocPhaseStats {
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+	uint64_t frees = 0;
+};
+
+/// <summary>
+/// An allocating call site: the return address of operator new, resolve it with the debugger,
+/// addr2line or llvm-symbolizer.
+/// </summary>
+struct WBAllocSite {
+	uintptr_t address = 0;
+	WBAllocPhase phase = WBAllocPhase::Other;
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+};
+
+struct WBAllocPluginStats {
+	const char* plugin = nullptr;
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+};
+
+/// <summary>
+/// An allocation made where none was allowed.
+/// </summary>
+struct WBAllocViolation {
+	size_t size = 0;
+	WBAllocPhase phase = WBAllocPhase::Other;
+	const char* plugin = nullptr;
+	uintptr_t address = 0;
+	uint64_t frame = 0;
+};
+
+struct WBAllocReport {
+	bool hooked = false;              // False when WB_ALLOC_PROFILER_IMPLEMENTATION is not compiled in
+	uint64_t frames = 0;
+	uint64_t lastFrameAllocations = 0;
+	uint64_t lastFrameBytes = 0;
+	uint64_t maxFrameAllocations = 0;
+	int64_t liveBytes = 0;
+	int64_t peakLiveBytes = 0;
+	uint64_t violations = 0;
+	uint64_t droppedSites = 0;        // Allocations whose site did not fit the site table
+	std::array<WBAllocPhaseStats, static_cast<size_t>(WBAllocPhase::Count)> phases = {};
+	std::array<std::vector<WBAllocSite>, static_cast<size_t>(WBAllocPhase::Count)> topSites; // By bytes, per phase
+	std::vector<WBAllocPluginStats> plugins;
+};
+
+/// <summary>
+/// Process-wide allocation counters fed by the operator new/delete replacements. Counting uses
+/// relaxed atomics and fixed-size tables, so the hooks never allocate or lock.
+/// </summary>
+class WBAllocProfiler {
+public:
+	using ViolationHandler = void (*)(const WBAllocViolation&);
+
+	static constexpr size_t siteSlots = 2048;
+	static constexpr size_t pluginSlots = 64;
+
+	static WBAllocProfiler& Instance() {
+		static WBAllocProfiler profiler; // Constant-initialized, usable from operator new during static init
+		return profiler;
+	}
+
+	/// <summary>
+	/// Closes the current frame's allocation count. Window::Show() calls it at the start of every frame.
+	/// </summary>
+	void BeginFrame() {
+		uint64_t allocations = frameAllocations.exchange(0, std::memory_order_relaxed);
+		lastFrameAllocations.store(allocations, std::memory_order_relaxed);
+		lastFrameBytes.store(frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		if (frames.load(std::memory_order_relaxed) > 0 && allocations > maxFrameAllocations.load(std::memory_order_relaxed))
+			maxFrameAllocations.store(allocations, std::memory_order_relaxed);
+		frames.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Treats every allocation made in a tagged phase as a violation once the given number of
+	/// frames has started, so a steady-state frame loop that allocates fails loudly.
+	/// </summary>
+	/// <param name="warmupFrames">Frames allowed to allocate; 0 turns the check off</param>
+	/// <param name="handler">Called for every violation, from inside operator new; must not allocate.
+	/// nullptr only counts them.</param>
+	void ExpectNoAllocationsAfter(uint64_t warmupFrames, ViolationHandler handler = nullptr) {
+		steadyAfter.store(warmupFrames, std::memory_order_relaxed);
+		violationHandler.store(handler, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Records an allocation. Called by the operator new replacements.
+	/// </summary>
+	void OnAllocate(size_t size, const void* caller) {
+		WBAllocTag& tag = WBCurrentAllocTag();
+		if (tag.suspended)
+			return;
+		const size_t phase = static_cast<size_t>(tag.phase);
+		phases[phase].allocations.fetch_add(1, std::memory_order_relaxed);
+		phases[phase].bytes.fetch_add(size, std::memory_order_relaxed);
+		frameAllocations.fetch_add(1, std::memory_order_relaxed);
+		frameBytes.fetch_add(size, std::memory_order_relaxed);
+
+		int64_t live = liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+		int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+		while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+		RecordSite(reinterpret_cast<uintptr_t>(caller), tag.phase, size);
+		if (tag.plugin)
+			RecordPlugin(tag.plugin, size);
+
+		uint64_t warmup = steadyAfter.load(std::memory_order_relaxed);
+		bool steady = warmup != 0 && tag.phase != WBAllocPhase::Other && frames.load(std::memory_order_relaxed) > warmup;
+		if (tag.forbidden || steady) {
+			violations.fetch_add(1, std::memory_order_relaxed);
+			if (ViolationHandler handler = violationHandler.load(std::memory_order_relaxed)) {
+				WBAllocViolation violation;
+				violation.size = size;
+				violation.phase = tag.phase;
+				violation.plugin = tag.plugin;
+				violation.address = reinterpret_cast<uintptr_t>(caller);
+				violation.frame = frames.load(std::memory_order_relaxed);
+				tag.suspended = true;
+				handler(violation);
+				tag.suspended = false;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Records a free of memory allocated with the given size in the given phase.
+	/// </summary>
+	void OnFree(size_t size, WBAllocPhase phase) {
+		if (phase >= WBAllocPhase::Count)
+			return; // Allocated while suspended, never counted
+		phases[static_cast<size_t>(phase)].frees.fetch_add(1, std::memory_order_relaxed);
+		liveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Snapshot of all counters, with the heaviest call sites of every phase.
+	/// </summary>
+	/// <param name="sitesPerPhase">Call sites kept per phase</param>
+	WBAllocReport GetReport(size_t sitesPerPhase = 5) {
+		WBAllocTag& tag = WBCurrentAllocTag();
+		bool wasSuspended = tag.suspended;
+		tag.suspended = true;
+
+		WBAllocReport report;
+		report.hooked = hooked.load(std::memory_order_relaxed);
+		report.frames = frames.load(std::memory_order_relaxed);
+		report.lastFrameAllocations = lastFrameAllocations.load(std::memory_order_relaxed);
+		report.lastFrameBytes = lastFrameBytes.load(std::memory_order_relaxed);
+		report.maxFrameAllocations = maxFrameAllocations.load(std::memory_order_relaxed);
+		report.liveBytes = liveBytes.load(std::memory_order_relaxed);
+		report.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+		report.violations = violations.load(std::memory_order_relaxed);
+		report.droppedSites = droppedSites.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < report.phases.size(); ++i) {
+			report.phases[i].allocations = phases[i].allocations.load(std::memory_order_relaxed);
+			report.phases[i].bytes = phases[i].bytes.load(std::memory_order_relaxed);
+			report.phases[i].frees = phases[i].frees.load(std::memory_order_relaxed);
+		}
+
+		for (const Site& slot : sites) {
+			uint64_t key = slot.key.load(std::memory_order_relaxed);
+			if (key == 0)
+				continue;
+			WBAllocSite site;
+			site.address = static_cast<uintptr_t>(key >> 4);
+			site.phase = static_cast<WBAllocPhase>(key & 15);
+			site.allocations = slot.allocations.load(std::memory_order_relaxed);
+			site.bytes = slot.bytes.load(std::memory_order_relaxed);
+			report.topSites[static_cast<size_t>(site.phase)].push_back(site);
+		}
+		for (std::vector<WBAllocSite>& phaseSites : report.topSites) {
+			std::sort(phaseSites.begin(), phaseSites.end(), [](const WBAllocSite& a, const WBAllocSite& b) { return a.bytes > b.bytes; });
+			if (phaseSites.size() > sitesPerPhase)
+				phaseSites.resize(sitesPerPhase);
+		}
+
+		for (const Plugin& slot : plugins) {
+			const char* name = slot.name.load(std::memory_order_relaxed);
+			if (name)
+				report.plugins.push_back({ name, slot.allocations.load(std::memory_order_relaxed), slot.bytes.load(std::memory_order_relaxed) });
+		}
+		std::sort(report.plugins.begin(), report.plugins.end(), [](const WBAllocPluginStats& a, const WBAllocPluginStats& b) { return a.bytes > b.bytes; });
+
+		tag.suspended = wasSuspended;
+		return report;
+	}
+
+	/// <summary>
+	/// Set by the operator new replacements when they are compiled in.
+	/// </summary>
+	void MarkHooked() { hooked.store(true, std::memory_order_relaxed); }
+
+private:
+	struct PhaseCounters {
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+	};
+
+	// Keyed by return address << 4 | phase, 0 = empty
+	struct Site {
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+	};
+
+	struct Plugin {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+	};
+
+	constexpr WBAllocProfiler() = default;
+
+	void RecordSite(uintptr_t address, WBAllocPhase phase, size_t size) {
+		const uint64_t key = (static_cast<uint64_t>(address) << 4) | static_cast<uint64_t>(phase);
+		size_t index = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 53) % siteSlots;
+		for (int probe = 0; probe < 16; ++probe, index = (index + 1) % siteSlots) {
+			uint64_t current = sites[index].key.load(std::memory_order_relaxed);
+			if (current == 0) {
+				if (sites[index].key.compare_exchange_strong(current, key, std::memory_order_relaxed))
+					current = key;
+			}
+			if (current == key) {
+				sites[index].allocations.fetch_add(1, std::memory_order_relaxed);
+				sites[index].bytes.fetch_add(size, std::memory_order_relaxed);
+				return;
+			}
+		}
+		droppedSites.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void RecordPlugin(const char* name, size_t size) {
+		for (Plugin& slot : plugins) {
+			const char* current = slot.name.load(std::memory_order_relaxed);
+			if (!current && slot.name.compare_exchange_strong(current, name, std::memory_order_relaxed))
+				current = name;
+			if (current == name) {
+				slot.allocations.fetch_add(1, std::memory_order_relaxed);
+				slot.bytes.fetch_add(size, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	std::atomic<bool> hooked{ false };
+	PhaseCounters phases[static_cast<size_t>(WBAllocPhase::Count)];
+	std::atomic<int64_t> liveBytes{ 0 };
+	std::atomic<int64_t> peakLiveBytes{ 0 };
+
+	std::atomic<uint64_t> frames{ 0 };
+	std::atomic<uint64_t> frameAllocations{ 0 };
+	std::atomic<uint64_t> frameBytes{ 0 };
+	std::atomic<uint64_t> lastFrameAllocations{ 0 };
+	std::atomic<uint64_t> lastFrameBytes{ 0 };
+	std::atomic<uint64_t> maxFrameAllocations{ 0 };
+
+	std::atomic<uint64_t> steadyAfter{ 0 };
+	std::atomic<ViolationHandler> violationHandler{ nullptr };
+	std::atomic<uint64_t> violations{ 0 };
+
+	Site sites[siteSlots];
+	std::atomic<uint64_t> droppedSites{ 0 };
+	Plugin plugins[pluginSlots];
+};
+
+/// <summary>
+/// Writes a report as text: per-phase totals, plugins and the top call sites of every phase.
+/// </summary>
+inline void WBPrintAllocReport(const WBAllocReport& report, std::ostream& out) {
+	if (!report.hooked) {
+		out << "Allocation profiler not compiled in (define WB_ALLOC_PROFILER_IMPLEMENTATION in one file)\n";
+		return;
+	}
+	out << "frames " << report.frames << ", last frame " << report.lastFrameAllocations << " allocations / "
+		<< report.lastFrameBytes << " bytes, worst frame " << report.maxFrameAllocations << " allocations\n";
+	out << "live " << report.liveBytes << " bytes, peak " << report.peakLiveBytes << " bytes, violations "
+		<< report.violations << "\n";
+	for (size_t i = 0; i < report.phases.size(); ++i) {
+		const WBAllocPhaseStats& phase = report.phases[i];
+		if (phase.allocations == 0)
+			continue;
+		out << "  " << std::left << std::setw(11) << WBAllocPhaseName(static_cast<WBAllocPhase>(i)) << std::right
+			<< std::setw(10) << phase.allocations << " allocs " << std::setw(12) << phase.bytes << " bytes\n";
+		for (const WBAllocSite& site : report.topSites[i])
+			out << "    0x" << std::hex << site.address << std::dec << "  " << site.allocations << " allocs " << site.bytes << " bytes\n";
+	}
+	for (const WBAllocPluginStats& plugin : report.plugins)
+		out << "  plugin " << plugin.plugin << ": " << plugin.allocations << " allocs " << plugin.bytes << " bytes\n";
+}
+
+#ifdef WB_ALLOC_PROFILER_IMPLEMENTATION
+
+// The replacements are kept out of line so the return address they record is the allocating code.
+// Every block carries a header in front of it with the requested size, the phase it was
+// allocated in and the distance back to the start of the underlying malloc block.
+struct WBAllocHeader {
+	uint64_t size;
+	uint32_t phase;
+	uint32_t offset;
+};
+static_assert(sizeof(WBAllocHeader) == 16, "header keeps malloc alignment");
+
+static const bool wbAllocHooked = (WBAllocProfiler::Instance().MarkHooked(), true);
+
+inline void* WBProfiledAllocate(size_t size, size_t alignment, const void* caller) {
+	alignment = std::max<size_t>(alignment, sizeof(WBAllocHeader));
+	void* raw = std::malloc(size + alignment + sizeof(WBAllocHeader));
+	if (!raw)
+		return nullptr;
+	uintptr_t user = (reinterpret_cast<uintptr_t>(raw) + sizeof(WBAllocHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	WBAllocHeader* header = reinterpret_cast<WBAllocHeader*>(user) - 1;
+	header->size = size;
+	const WBAllocTag& tag = WBCurrentAllocTag();
+	header->phase = tag.suspended ? static_cast<uint32_t>(WBAllocPhase::Count) : static_cast<uint32_t>(tag.phase);
+	header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(raw));
+	WBAllocProfiler::Instance().OnAllocate(size, caller);
+	return reinterpret_cast<void*>(user);
+}
+
+inline void WBProfiledFree(void* pointer) {
+	if (!pointer)
+		return;
+	WBAllocHeader* header = static_cast<WBAllocHeader*>(pointer) - 1;
+	WBAllocProfiler::Instance().OnFree(static_cast<size_t>(header->size), static_cast<WBAllocPhase>(header->phase));
+	std::free(static_cast<char*>(pointer) - header->offset);
+}
+
+inline void* WBProfiledAllocateOrThrow(size_t size, size_t alignment, const void* caller) {
+	void* pointer = WBProfiledAllocate(size, alignment, caller);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+WB_NOINLINE void* operator new(size_t size) { return WBProfiledAllocateOrThrow(size, 0, WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new[](size_t size) { return WBProfiledAllocateOrThrow(size, 0, WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new(size_t size, const std::nothrow_t&) noexcept { return WBProfiledAllocate(size, 0, WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new[](size_t size, const std::nothrow_t&) noexcept { return WBProfiledAllocate(size, 0, WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new(size_t size, std::align_val_t alignment) { return WBProfiledAllocateOrThrow(size, static_cast<size_t>(alignment), WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new[](size_t size, std::align_val_t alignment) { return WBProfiledAllocateOrThrow(size, static_cast<size_t>(alignment), WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return WBProfiledAllocate(size, static_cast<size_t>(alignment), WB_RETURN_ADDRESS()); }
+WB_NOINLINE void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return WBProfiledAllocate(size, static_cast<size_t>(alignment), WB_RETURN_ADDRESS()); }
+
+WB_NOINLINE void operator delete(void* pointer) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete(void* pointer, size_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer, size_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete(void* pointer, const std::nothrow_t&) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer, const std::nothrow_t&) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete(void* pointer, std::align_val_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer, std::align_val_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete(void* pointer, size_t, std::align_val_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { WBProfiledFree(pointer); }
+WB_NOINLINE void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { WBProfiledFree(pointer); }
+
+#endif
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Platform independent half of WindowBuilderDraw2D: primitive recording, tessellation into
+// instances and sorting into batches. The plugin only uploads and draws the result.
+
+/// <summary>
+/// Packs a color the same way as ImGui's IM_COL32 (red in the low byte).
+/// </summary>
+constexpr uint32_t WBRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+	return static_cast<uint32_t>(r) | static_cast<uint32_t>(g) << 8 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(a) << 24;
+}
+
+/// <summary>
+/// Shape evaluated by the pixel shader for an instance.
+/// </summary>
+enum class WBPrim2D : uint32_t {
+	Rect = 0,   // a/b are the corners, thickness > 0 draws an outline
+	Line = 1,   // a/b are the end points
+	Circle = 2, // a is the center, b.x the radius, thickness > 0 draws a ring
+	Image = 3,  // a/b are the corners, uv the texture rectangle
+	Glyph = 4   // a/b are the corners, uv the rectangle in a distance field atlas (WBTextSystem)
+};
+
+/// <summary>
+/// One instanced quad as it is laid out in the GPU instance buffer (48 bytes).
+/// </summary>
+struct WBInstance2D {
+	float a[2];
+	float b[2];
+	float uv[4];
+	uint32_t color;
+	float thickness;
+	WBPrim2D kind;
+	uint32_t reserved;
+};
+static_assert(sizeof(WBInstance2D) == 48, "WBInstance2D must match the instance input layout");
+
+/// <summary>
+/// A run of instances drawn with one instanced draw call.
+/// </summary>
+struct WBBatch2D {
+	int layer = 0;
+	void* texture = nullptr;
+	uint32_t firstInstance = 0;
+	uint32_t instanceCount = 0;
+};
+
+/// <summary>
+/// Records immediate-mode 2D primitives and turns them into instance batches.
+/// Build() orders primitives by layer, then by texture in order of first use, keeping
+/// submission order inside each (layer, texture) group, so a frame with one layer and one
+/// texture is a single draw call no matter how many primitives it has.
+/// </summary>
+class WBBatcher2D {
+public:
+	/// <summary>
+	/// Drops everything recorded since the last Clear.
+	/// </summary>
+	void Clear() {
+		pending.clear();
+		groupOf.clear();
+		groups.clear();
+		instances.clear();
+		batches.clear();
+		lastGroup = -1;
+		layer = 0;
+	}
+
+	/// <summary>
+	/// Sets the layer of subsequent primitives. Higher layers are drawn on top.
+	/// </summary>
+	void SetLayer(int newLayer) { layer = newLayer; }
+	int GetLayer() const { return layer; }
+
+	void Rect(float x0, float y0, float x1, float y1, uint32_t color, float thickness = 0.0f) {
+		Push(nullptr, { { std::min(x0, x1), std::min(y0, y1) }, { std::max(x0, x1), std::max(y0, y1) },
+			{ 0, 0, 0, 0 }, color, thickness, WBPrim2D::Rect, 0 });
+	}
+
+	void Line(float x0, float y0, float x1, float y1, uint32_t color, float thickness = 1.0f) {
+		Push(nullptr, { { x0, y0 }, { x1, y1 }, { 0, 0, 0, 0 }, color, thickness, WBPrim2D::Line, 0 });
+	}
+
+	/// <summary>
+	/// Draws connected line segments.
+	/// </summary>
+	/// <param name="points">Interleaved x/y coordinates.</param>
+	/// <param name="count">Number of points.</param>
+	void Polyline(const float* points, size_t count, uint32_t color, float thickness = 1.0f, bool closed = false) {
+		if (count < 2)
+			return;
+		for (size_t i = 0; i + 1 < count; ++i)
+			Line(points[i * 2], points[i * 2 + 1], points[i * 2 + 2], points[i * 2 + 3], color, thickness);
+		if (closed && count > 2)
+			Line(points[(count - 1) * 2], points[(count - 1) * 2 + 1], points[0], points[1], color, thickness);
+	}
+
+	void Circle(float cx, float cy, float radius, uint32_t color, float thickness = 0.0f) {
+		Push(nullptr, { { cx, cy }, { radius, 0 }, { 0, 0, 0, 0 }, color, thickness, WBPrim2D::Circle, 0 });
+	}
+
+	/// <summary>
+	/// Draws a textured quad. The texture is an ID3D11ShaderResourceView*, e.g. from Window::textures.
+	/// </summary>
+	void Image(void* texture, float x0, float y0, float x1, float y1,
+		float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f, uint32_t color = 0xFFFFFFFF) {
+		Push(texture, { { x0, y0 }, { x1, y1 }, { u0, v0, u1, v1 }, color, 0.0f, WBPrim2D::Image, 0 });
+	}
+
+	/// <summary>
+	/// Draws a distance field glyph. The texture is the R8 atlas of a WBTextSystem.
+	/// </summary>
+	void Glyph(void* atlas, float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color) {
+		Push(atlas, { { x0, y0 }, { x1, y1 }, { u0, v0, u1, v1 }, color, 0.0f, WBPrim2D::Glyph, 0 });
+	}
+
+	/// <summary>
+	/// Records an already tessellated instance, for primitive kinds layered on top of this class.
+	/// </summary>
+	void Push(void* texture, const WBInstance2D& instance) {
+		if (lastGroup < 0 || groups[lastGroup].layer != layer || groups[lastGroup].texture != texture)
+			lastGroup = FindGroup(texture);
+		++groups[lastGroup].count;
+		groupOf.push_back(static_cast<uint32_t>(lastGroup));
+		pending.push_back(instance);
+	}
+
+	/// <summary>
+	/// Sorts the recorded primitives into batches. Call once after recording.
+	/// </summary>
+	void Build() {
+		batches.clear();
+		if (pending.empty()) {
+			instances.clear();
+			return;
+		}
+
+		// Order groups by layer, ties keep first-use order
+		std::vector<uint32_t> order(groups.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return groups[a].layer < groups[b].layer; });
+
+		uint32_t offset = 0;
+		for (uint32_t index : order) {
+			Group& group = groups[index];
+			group.offset = offset;
+			batches.push_back({ group.layer, group.texture, offset, group.count });
+			offset += group.count;
+		}
+
+		if (groups.size() == 1) {
+			instances.swap(pending);
+			pending.clear();
+			return;
+		}
+
+		// Stable counting scatter into the sorted order
+		instances.resize(pending.size());
+		for (size_t i = 0; i < pending.size(); ++i)
+			instances[groups[groupOf[i]].offset++] = pending[i];
+		pending.clear();
+	}
+
+	const std::vector<WBInstance2D>& GetInstances() const { return instances; }
+	const std::vector<WBBatch2D>& GetBatches() const { return batches; }
+	size_t GetPrimitiveCount() const { return pending.size() + instances.size(); }
+
+private:
+	struct Group {
+		int layer;
+		void* texture;
+		uint32_t count;
+		uint32_t offset;
+	};
+
+	int FindGroup(void* texture) {
+		for (size_t i = 0; i < groups.size(); ++i)
+			if (groups[i].layer == layer && groups[i].texture == texture)
+				return static_cast<int>(i);
+		groups.push_back({ layer, texture, 0, 0 });
+		return static_cast<int>(groups.size() - 1);
+	}
+
+	int layer = 0;
+	int lastGroup = -1;
+	std::vector<WBInstance2D> pending;
+	std::vector<uint32_t> groupOf;
+	std::vector<Group> groups;
+	std::vector<WBInstance2D> instances;
+	std::vector<WBBatch2D> batches;
+};
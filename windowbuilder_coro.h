@@ -0,0 +1,370 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+// Coroutines driven by a frame loop. A WBTask starts running when it is called and suspends on
+// the awaitables of a WBCoroScheduler: the next frame, a delay, a window message or a signal.
+// Everything resumes from the scheduler's Tick(), so on the thread that runs the loop, and
+// waiting costs nothing: awaiters are intrusive list nodes inside the suspended coroutine frame
+// and frames come from a per-thread pool of size classes.
+
+/// <summary>
+/// Per-thread free lists for coroutine frames, in 64-byte size classes up to 2 KB. Blocks go back
+/// to the list of the thread that frees them, which for WBTask is the thread running the scheduler.
+/// </summary>
+class WBCoroFramePool {
+public:
+	static constexpr size_t granularity = 64;
+	static constexpr size_t classCount = 32; // Frames above 2 KB go straight to operator new
+
+	struct Stats {
+		uint64_t allocations = 0;
+		uint64_t reused = 0;   // Allocations served from a free list
+		size_t cachedBytes = 0; // Bytes sitting in the free lists
+	};
+
+	static void* Allocate(size_t bytes) {
+		size_t sizeClass = (bytes + granularity - 1) / granularity;
+		WBCoroFramePool& pool = Local();
+		++pool.stats.allocations;
+		if (sizeClass == 0 || sizeClass > classCount)
+			return ::operator new(bytes);
+		Block*& head = pool.free[sizeClass - 1];
+		if (head) {
+			Block* block = head;
+			head = block->next;
+			++pool.stats.reused;
+			pool.stats.cachedBytes -= sizeClass * granularity;
+			return block;
+		}
+		return ::operator new(sizeClass * granularity);
+	}
+
+	static void Free(void* pointer, size_t bytes) {
+		size_t sizeClass = (bytes + granularity - 1) / granularity;
+		if (sizeClass == 0 || sizeClass > classCount) {
+			::operator delete(pointer);
+			return;
+		}
+		WBCoroFramePool& pool = Local();
+		Block* block = static_cast<Block*>(pointer);
+		block->next = pool.free[sizeClass - 1];
+		pool.free[sizeClass - 1] = block;
+		pool.stats.cachedBytes += sizeClass * granularity;
+	}
+
+	static Stats GetStats() { return Local().stats; }
+
+	~WBCoroFramePool() {
+		for (Block* head : free) {
+			while (head) {
+				Block* next = head->next;
+				::operator delete(head);
+				head = next;
+			}
+		}
+	}
+
+private:
+	struct Block { Block* next; };
+
+	static WBCoroFramePool& Local() {
+		thread_local WBCoroFramePool pool;
+		return pool;
+	}
+
+	std::array<Block*, classCount> free = {};
+	Stats stats;
+};
+
+/// <summary>
+/// Fire-and-forget coroutine. It runs until its first co_await when called, and its frame is freed
+/// when it returns or when the scheduler it waits on is destroyed.
+/// </summary>
+struct WBTask {
+	struct promise_type {
+		WBTask get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+
+		void unhandled_exception() {
+			try {
+				std::rethrow_exception(std::current_exception());
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Unhandled exception in coroutine: " << e.what() << std::endl;
+			}
+			catch (...) {
+				std::cerr << "Unhandled exception in coroutine" << std::endl;
+			}
+		}
+
+		static void* operator new(size_t bytes) { return WBCoroFramePool::Allocate(bytes); }
+		static void operator delete(void* pointer, size_t bytes) { WBCoroFramePool::Free(pointer, bytes); }
+	};
+};
+
+/// <summary>
+/// A window message delivered to co_await scheduler.Message(id).
+/// </summary>
+struct WBCoroMessage {
+	uint32_t message = 0;
+	uint64_t wParam = 0;
+	int64_t lParam = 0;
+};
+
+/// <summary>
+/// Counters of a WBCoroScheduler.
+/// </summary>
+struct WBCoroStats {
+	uint64_t ticks = 0;
+	uint64_t resumed = 0;
+	size_t waiting = 0; // Coroutines suspended on this scheduler
+};
+
+/// <summary>
+/// Resumes coroutines from a frame loop. Call Tick() once per frame and Post() for every
+/// message; both must run on the same thread, and so must co_await on the awaitables. Suspended
+/// coroutines point at the scheduler, so it cannot be moved.
+/// Resumption order within a tick: messages and signals, then expired delays by deadline, then
+/// the coroutines that were waiting for this frame. A coroutine that waits again from inside
+/// Tick() is resumed in the next tick at the earliest.
+/// </summary>
+class WBCoroScheduler {
+public:
+	WBCoroScheduler() = default;
+	WBCoroScheduler(const WBCoroScheduler&) = delete;
+	WBCoroScheduler& operator=(const WBCoroScheduler&) = delete;
+
+	~WBCoroScheduler() {
+		Clear();
+	}
+
+	/// <summary>
+	/// Intrusive wait list node, lives in the suspended coroutine's frame.
+	/// </summary>
+	struct Waiter {
+		std::coroutine_handle<> handle;
+		Waiter* next = nullptr;
+	};
+
+	class NextFrameAwaiter : Waiter {
+	public:
+		explicit NextFrameAwaiter(WBCoroScheduler& scheduler) : scheduler(scheduler) {}
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			handle = h;
+			scheduler.Push(scheduler.nextFrame, this);
+		}
+		void await_resume() const noexcept {}
+
+	private:
+		WBCoroScheduler& scheduler;
+	};
+
+	class DelayAwaiter : Waiter {
+	public:
+		DelayAwaiter(WBCoroScheduler& scheduler, uint64_t deadline) : scheduler(scheduler), deadline(deadline) {}
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			handle = h;
+			scheduler.AddTimer(deadline, this);
+		}
+		void await_resume() const noexcept {}
+
+	private:
+		WBCoroScheduler& scheduler;
+		uint64_t deadline;
+	};
+
+	class KeyedAwaiter : Waiter {
+	public:
+		KeyedAwaiter(WBCoroScheduler& scheduler, uint64_t key) : scheduler(scheduler), key(key) {}
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			handle = h;
+			scheduler.Push(scheduler.keyed[key], this);
+		}
+		WBCoroMessage await_resume() const noexcept { return payload; }
+
+	private:
+		friend class WBCoroScheduler;
+		WBCoroScheduler& scheduler;
+		uint64_t key;
+		WBCoroMessage payload;
+	};
+
+	/// <summary>
+	/// co_await scheduler.NextFrame() resumes in the next Tick().
+	/// </summary>
+	NextFrameAwaiter NextFrame() { return NextFrameAwaiter(*this); }
+
+	/// <summary>
+	/// co_await scheduler.Delay(ns) resumes in the first Tick() at least ns after the current tick time.
+	/// </summary>
+	DelayAwaiter Delay(uint64_t ns) { return DelayAwaiter(*this, now + ns); }
+
+	/// <summary>
+	/// co_await scheduler.Message(id) resumes in the Tick() after the message is posted and
+	/// returns it. Messages posted while nobody waits are dropped.
+	/// </summary>
+	KeyedAwaiter Message(uint32_t message) { return KeyedAwaiter(*this, message); }
+
+	/// <summary>
+	/// co_await scheduler.Signal(id) resumes in the Tick() after Raise(id).
+	/// </summary>
+	KeyedAwaiter Signal(uint32_t signal) { return KeyedAwaiter(*this, SignalKey(signal)); }
+
+	/// <summary>
+	/// Hands a message to the coroutines waiting for it. They resume in the next Tick().
+	/// </summary>
+	void Post(uint32_t message, uint64_t wParam, int64_t lParam) {
+		Wake(message, { message, wParam, lParam });
+	}
+
+	/// <summary>
+	/// Wakes the coroutines waiting for a signal. They resume in the next Tick().
+	/// </summary>
+	void Raise(uint32_t signal) {
+		Wake(SignalKey(signal), { signal, 0, 0 });
+	}
+
+	/// <summary>
+	/// Resumes everything that is due.
+	/// </summary>
+	/// <param name="nowNs">Current time on any monotonic clock, the same one for every tick</param>
+	void Tick(uint64_t nowNs) {
+		now = std::max(now, nowNs);
+		++stats.ticks;
+
+		List woken = std::exchange(ready, {});
+		List frame = std::exchange(nextFrame, {});
+		ResumeAll(woken);
+
+		const uint64_t sequenceLimit = timerSequence;
+		while (!timers.empty() && timers.front().deadline <= now && timers.front().sequence < sequenceLimit) {
+			std::pop_heap(timers.begin(), timers.end(), LaterTimer);
+			Waiter* waiter = timers.back().waiter;
+			timers.pop_back();
+			Resume(waiter);
+		}
+
+		ResumeAll(frame);
+	}
+
+	/// <summary>
+	/// Destroys every suspended coroutine, running the destructors of its locals.
+	/// </summary>
+	void Clear() {
+		std::vector<std::coroutine_handle<>> handles;
+		auto collect = [&handles](List& list) {
+			for (Waiter* waiter = list.head; waiter; waiter = waiter->next)
+				handles.push_back(waiter->handle);
+			list = {};
+		};
+		collect(ready);
+		collect(nextFrame);
+		for (auto& entry : keyed)
+			collect(entry.second);
+		for (const Timer& timer : timers)
+			handles.push_back(timer.waiter->handle);
+		keyed.clear();
+		timers.clear();
+		stats.waiting = 0;
+		for (std::coroutine_handle<> handle : handles)
+			handle.destroy();
+	}
+
+	/// <summary>
+	/// Time of the current tick, in the clock passed to Tick().
+	/// </summary>
+	uint64_t Now() const { return now; }
+
+	const WBCoroStats& GetStats() const { return stats; }
+
+private:
+	struct List {
+		Waiter* head = nullptr;
+		Waiter* tail = nullptr;
+	};
+
+	struct Timer {
+		uint64_t deadline;
+		uint64_t sequence; // Equal deadlines resume in the order they were awaited
+		Waiter* waiter;
+	};
+
+	static bool LaterTimer(const Timer& a, const Timer& b) {
+		return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+	}
+
+	static uint64_t SignalKey(uint32_t signal) {
+		return (uint64_t(1) << 32) | signal;
+	}
+
+	void Push(List& list, Waiter* waiter) {
+		waiter->next = nullptr;
+		if (list.tail)
+			list.tail->next = waiter;
+		else
+			list.head = waiter;
+		list.tail = waiter;
+		++stats.waiting;
+	}
+
+	void AddTimer(uint64_t deadline, Waiter* waiter) {
+		timers.push_back({ deadline, timerSequence++, waiter });
+		std::push_heap(timers.begin(), timers.end(), LaterTimer);
+		++stats.waiting;
+	}
+
+	void Wake(uint64_t key, const WBCoroMessage& payload) {
+		auto it = keyed.find(key);
+		if (it == keyed.end() || !it->second.head)
+			return;
+		for (Waiter* waiter = it->second.head; waiter; waiter = waiter->next)
+			static_cast<KeyedAwaiter*>(waiter)->payload = payload;
+
+		// Splice the whole list onto the ready queue
+		if (ready.tail)
+			ready.tail->next = it->second.head;
+		else
+			ready.head = it->second.head;
+		ready.tail = it->second.tail;
+		it->second = {};
+	}
+
+	void ResumeAll(List list) {
+		Waiter* waiter = list.head;
+		while (waiter) {
+			Waiter* next = waiter->next; // The node dies with its frame once resumed
+			Resume(waiter);
+			waiter = next;
+		}
+	}
+
+	void Resume(Waiter* waiter) {
+		--stats.waiting;
+		++stats.resumed;
+		waiter->handle.resume();
+	}
+
+	List ready;
+	List nextFrame;
+	std::vector<Timer> timers;
+	std::unordered_map<uint64_t, List> keyed;
+	uint64_t now = 0;
+	uint64_t timerSequence = 0;
+	WBCoroStats stats;
+};
@@ -0,0 +1,484 @@
+#pragma once
+
+#include "windowbuilder.h"
+#include "windowbuilder_batch2d.h"
+#include "windowbuilder_text.h"
+
+/// <summary>
+/// Counters of the last frame drawn by WindowBuilderDraw2D.
+/// </summary>
+struct WBDraw2DStats {
+	uint32_t primitives = 0;
+	uint32_t drawCalls = 0;
+	size_t bytesUploaded = 0;
+};
+
+/// <summary>
+/// Immediate-mode 2D renderer. Record primitives from onRender through
+/// window.GetPlugin&lt;WindowBuilderDraw2D&gt;() and they are drawn in PostRender: every
+/// primitive is one instance in a shared instance stream, and each (layer, texture) batch
+/// is a single instanced draw of a 4-vertex strip.
+/// Shapes are evaluated analytically in the pixel shader, so circles and lines are antialiased
+/// without tessellating them into triangles.
+/// </summary>
+class WindowBuilderDraw2D : public WBPlugin, public WBBatcher2D {
+public:
+	static constexpr UINT initialCapacity = 16 * 1024; // Instances
+
+	void OnLoad(Window& window) override {
+		ID3DBlob* vsBlob = WBCompileShader(shaderSource, "VSMain", "vs_4_0");
+		ID3DBlob* psBlob = WBCompileShader(shaderSource, "PSMain", "ps_4_0");
+		if (!vsBlob || !psBlob) {
+			if (vsBlob) vsBlob->Release();
+			if (psBlob) psBlob->Release();
+			return;
+		}
+
+		window.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
+		window.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] = {
+			{ "A", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "B", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 8, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "UV", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "THICKNESS", 0, DXGI_FORMAT_R32_FLOAT, 0, 36, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "KIND", 0, DXGI_FORMAT_R32_UINT, 0, 40, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		window.device->CreateInputLayout(layout, ARRAYSIZE(layout), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &inputLayout);
+		vsBlob->Release();
+		psBlob->Release();
+
+		D3D11_BUFFER_DESC cbDesc = {};
+		cbDesc.ByteWidth = 16;
+		cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+		cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		window.device->CreateBuffer(&cbDesc, nullptr, &constantBuffer);
+
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		window.device->CreateBlendState(&blendDesc, &blendState);
+
+		D3D11_RASTERIZER_DESC rasterDesc = {};
+		rasterDesc.FillMode = D3D11_FILL_SOLID;
+		rasterDesc.CullMode = D3D11_CULL_NONE;
+		rasterDesc.DepthClipEnable = TRUE;
+		window.device->CreateRasterizerState(&rasterDesc, &rasterizerState);
+
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		window.device->CreateDepthStencilState(&depthDesc, &depthStencilState);
+
+		D3D11_SAMPLER_DESC samplerDesc = {};
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = samplerDesc.AddressV = samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+		window.device->CreateSamplerState(&samplerDesc, &samplerState);
+
+		CreateInstanceBuffer(window, initialCapacity);
+	}
+
+	void OnUnload(Window&) override {
+		if (instanceBuffer) instanceBuffer->Release();
+		if (samplerState) samplerState->Release();
+		if (depthStencilState) depthStencilState->Release();
+		if (rasterizerState) rasterizerState->Release();
+		if (blendState) blendState->Release();
+		if (constantBuffer) constantBuffer->Release();
+		if (inputLayout) inputLayout->Release();
+		if (pixelShader) pixelShader->Release();
+		if (vertexShader) vertexShader->Release();
+		instanceBuffer = nullptr;
+		samplerState = nullptr;
+		depthStencilState = nullptr;
+		rasterizerState = nullptr;
+		blendState = nullptr;
+		constantBuffer = nullptr;
+		inputLayout = nullptr;
+		pixelShader = nullptr;
+		vertexShader = nullptr;
+	}
+
+	void PreRender(Window&) override {
+		Clear();
+	}
+
+	void PostRender(Window& window) override {
+		Flush(window);
+	}
+
+	/// <summary>
+	/// Draws what has been recorded so far into the bound render target and starts over. PostRender
+	/// does this for the frame; call it at the end of a render layer's draw callback to draw into the layer.
+	/// </summary>
+	void Flush(Window& window) {
+		Submit(window);
+		Clear();
+	}
+
+	/// <summary>
+	/// Gets the counters of the last flush.
+	/// </summary>
+	const WBDraw2DStats& GetStats() const {
+		return stats;
+	}
+
+private:
+	void Submit(Window& window) {
+		Build();
+		const std::vector<WBInstance2D>& data = GetInstances();
+		stats = {};
+		stats.primitives = static_cast<uint32_t>(data.size());
+		if (data.empty() || !vertexShader)
+			return;
+
+		UINT count = static_cast<UINT>(data.size());
+		if (count > capacity)
+			CreateInstanceBuffer(window, std::max(count, capacity * 2));
+		if (!instanceBuffer)
+			return;
+
+		// Append with NO_OVERWRITE while the frame fits behind the previous one, start over with DISCARD when it doesn't
+		D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (writeOffset + count > capacity) {
+			mapType = D3D11_MAP_WRITE_DISCARD;
+			writeOffset = 0;
+		}
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(window.context->Map(instanceBuffer, 0, mapType, 0, &mapped)))
+			return;
+		memcpy(static_cast<WBInstance2D*>(mapped.pData) + writeOffset, data.data(), count * sizeof(WBInstance2D));
+		window.context->Unmap(instanceBuffer, 0);
+		stats.bytesUploaded = count * sizeof(WBInstance2D);
+
+		if (SUCCEEDED(window.context->Map(constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			float* constants = static_cast<float*>(mapped.pData);
+			constants[0] = 1.0f / window.width;
+			constants[1] = 1.0f / window.height;
+			constants[2] = constants[3] = 0.0f;
+			window.context->Unmap(constantBuffer, 0);
+		}
+
+		// Positions are in window pixels, the viewport scales them down into a reduced resolution layer
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(window.GetTargetWidth()), static_cast<float>(window.GetTargetHeight()), 0.0f, 1.0f };
+		const UINT stride = sizeof(WBInstance2D), offset = 0;
+		const float blendFactor[4] = {};
+		ID3D11DeviceContext* ctx = window.context;
+		ctx->RSSetViewports(1, &viewport);
+		ctx->RSSetState(rasterizerState);
+		ctx->IASetInputLayout(inputLayout);
+		ctx->IASetVertexBuffers(0, 1, &instanceBuffer, &stride, &offset);
+		ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		ctx->VSSetShader(vertexShader, nullptr, 0);
+		ctx->VSSetConstantBuffers(0, 1, &constantBuffer);
+		ctx->PSSetShader(pixelShader, nullptr, 0);
+		ctx->PSSetSamplers(0, 1, &samplerState);
+		ctx->GSSetShader(nullptr, nullptr, 0);
+		ctx->OMSetBlendState(blendState, blendFactor, 0xFFFFFFFF);
+		ctx->OMSetDepthStencilState(depthStencilState, 0);
+
+		for (const WBBatch2D& batch : GetBatches()) {
+			ID3D11ShaderResourceView* texture = static_cast<ID3D11ShaderResourceView*>(batch.texture);
+			ctx->PSSetShaderResources(0, 1, &texture);
+			ctx->DrawInstanced(4, batch.instanceCount, 0, writeOffset + batch.firstInstance);
+			++stats.drawCalls;
+		}
+		writeOffset += count;
+	}
+
+	void CreateInstanceBuffer(Window& window, UINT instances) {
+		if (instanceBuffer) instanceBuffer->Release();
+		instanceBuffer = nullptr;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = instances * sizeof(WBInstance2D);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		window.device->CreateBuffer(&desc, nullptr, &instanceBuffer);
+		capacity = instanceBuffer ? instances : 0;
+		writeOffset = capacity; // Force a DISCARD on first use
+	}
+
+	static constexpr const char* shaderSource = R"(
+cbuffer Globals : register(b0) { float2 invViewport; float2 unused; };
+Texture2D tex : register(t0);
+SamplerState smp : register(s0);
+
+struct Instance {
+	float2 a : A;
+	float2 b : B;
+	float4 uv : UV;
+	float4 color : COLOR;
+	float thickness : THICKNESS;
+	uint kind : KIND;
+};
+
+struct PSIn {
+	float4 pos : SV_POSITION;
+	float4 color : COLOR;
+	float2 uv : TEXCOORD0;
+	float2 local : TEXCOORD1;
+	float3 params : TEXCOORD2;
+	nointerpolation uint kind : KIND;
+};
+
+PSIn VSMain(Instance inst, uint vertexId : SV_VertexID) {
+	float2 corner = float2(vertexId & 1, vertexId >> 1);
+	PSIn o;
+	o.color = inst.color;
+	o.kind = inst.kind;
+	o.uv = lerp(inst.uv.xy, inst.uv.zw, corner);
+
+	float2 p;
+	if (inst.kind == 1) {
+		// Line: quad along the segment, padded by a pixel for antialiasing
+		float2 d = inst.b - inst.a;
+		float len = max(length(d), 1e-4);
+		float2 dir = d / len;
+		float2 n = float2(-dir.y, dir.x);
+		float h = inst.thickness * 0.5 + 1.0;
+		float along = lerp(-1.0, len + 1.0, corner.x);
+		float across = lerp(-h, h, corner.y);
+		p = inst.a + dir * along + n * across;
+		o.local = float2(along, across);
+		o.params = float3(len, inst.thickness * 0.5, 0);
+	}
+	else if (inst.kind == 2) {
+		// Circle: bounding square of the radius plus a pixel
+		float r = inst.b.x + 1.0;
+		o.local = lerp(-r.xx, r.xx, corner);
+		p = inst.a + o.local;
+		o.params = float3(inst.b.x, inst.thickness, 0);
+	}
+	else {
+		// Rect and image: a and b are the corners
+		p = lerp(inst.a, inst.b, corner);
+		o.local = p - inst.a;
+		o.params = float3(inst.b - inst.a, inst.thickness);
+	}
+
+	o.pos = float4(p * invViewport * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+	return o;
+}
+
+float4 PSMain(PSIn i) : SV_TARGET {
+	float4 c = i.color;
+	if (i.kind == 0) {
+		if (i.params.z > 0.0) {
+			float2 edge = min(i.local, i.params.xy - i.local);
+			if (min(edge.x, edge.y) >= i.params.z)
+				discard;
+		}
+	}
+	else if (i.kind == 1) {
+		c.a *= saturate(i.params.y + 0.5 - abs(i.local.y)) * saturate(0.5 + min(i.local.x, i.params.x - i.local.x));
+	}
+	else if (i.kind == 2) {
+		float d = length(i.local) - i.params.x;
+		if (i.params.y > 0.0)
+			d = abs(d + i.params.y * 0.5) - i.params.y * 0.5;
+		c.a *= saturate(0.5 - d);
+	}
+	else if (i.kind == 4) {
+		// Distance field glyph: 0.5 is the edge, smoothed over one screen pixel at any scale
+		float d = tex.Sample(smp, i.uv).r;
+		float w = max(fwidth(d), 1e-4) * 0.5;
+		c.a *= smoothstep(0.5 - w, 0.5 + w, d);
+	}
+	else {
+		c *= tex.Sample(smp, i.uv);
+	}
+	if (c.a <= 0.0)
+		discard;
+	return c;
+}
+)";
+
+	ID3D11VertexShader* vertexShader = nullptr;
+	ID3D11PixelShader* pixelShader = nullptr;
+	ID3D11InputLayout* inputLayout = nullptr;
+	ID3D11Buffer* constantBuffer = nullptr;
+	ID3D11BlendState* blendState = nullptr;
+	ID3D11RasterizerState* rasterizerState = nullptr;
+	ID3D11DepthStencilState* depthStencilState = nullptr;
+	ID3D11SamplerState* samplerState = nullptr;
+	ID3D11Buffer* instanceBuffer = nullptr;
+	UINT capacity = 0;
+	UINT writeOffset = 0;
+	WBDraw2DStats stats;
+};
+
+/// <summary>
+/// Glyph source backed by GDI. GDI calls are serialized; the distance field transform,
+/// which is most of the cost, still runs in parallel on the WBTextSystem workers.
+/// Codepoints outside the Basic Multilingual Plane are not supported.
+/// </summary>
+class WBGdiGlyphSource : public WBGlyphSource {
+public:
+	explicit WBGdiGlyphSource(const char* face, int weight = FW_NORMAL) : face(face), weight(weight) {
+		dc = CreateCompatibleDC(nullptr);
+	}
+
+	~WBGdiGlyphSource() override {
+		for (auto& [size, font] : fonts)
+			DeleteObject(font.handle);
+		if (dc) DeleteDC(dc);
+	}
+
+	float Advance(uint32_t codepoint, int pixelSize) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		Font& font = Select(pixelSize);
+		auto it = font.advances.find(codepoint);
+		if (it != font.advances.end())
+			return it->second;
+
+		float advance = 0.0f;
+		GLYPHMETRICS metrics = {};
+		if (codepoint <= 0xFFFF && GetGlyphOutlineW(dc, codepoint, GGO_METRICS, &metrics, 0, nullptr, &identity) != GDI_ERROR)
+			advance = static_cast<float>(metrics.gmCellIncX);
+		font.advances.emplace(codepoint, advance);
+		return advance;
+	}
+
+	float LineHeight(int pixelSize) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		const TEXTMETRICW& tm = Select(pixelSize).metrics;
+		return static_cast<float>(tm.tmHeight + tm.tmExternalLeading);
+	}
+
+	float Ascent(int pixelSize) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<float>(Select(pixelSize).metrics.tmAscent);
+	}
+
+	bool Rasterize(uint32_t codepoint, int pixelSize, WBGlyphBitmap& out) override {
+		if (codepoint > 0xFFFF)
+			return false;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Select(pixelSize);
+		GLYPHMETRICS metrics = {};
+		DWORD size = GetGlyphOutlineW(dc, codepoint, GGO_GRAY8_BITMAP, &metrics, 0, nullptr, &identity);
+		if (size == GDI_ERROR || size == 0)
+			return false;
+		buffer.resize(size);
+		if (GetGlyphOutlineW(dc, codepoint, GGO_GRAY8_BITMAP, &metrics, size, buffer.data(), &identity) == GDI_ERROR)
+			return false;
+
+		// GGO_GRAY8_BITMAP has 65 levels and DWORD aligned rows
+		const int pitch = (metrics.gmBlackBoxX + 3) & ~3;
+		out.width = metrics.gmBlackBoxX;
+		out.height = metrics.gmBlackBoxY;
+		out.left = static_cast<float>(metrics.gmptGlyphOrigin.x);
+		out.top = static_cast<float>(metrics.gmptGlyphOrigin.y);
+		out.coverage.resize(size_t(out.width) * out.height);
+		for (int y = 0; y < out.height; ++y)
+			for (int x = 0; x < out.width; ++x)
+				out.coverage[size_t(y) * out.width + x] = static_cast<uint8_t>(std::min(255, buffer[size_t(y) * pitch + x] * 255 / 64));
+		return true;
+	}
+
+private:
+	struct Font {
+		HFONT handle = nullptr;
+		TEXTMETRICW metrics = {};
+		std::unordered_map<uint32_t, float> advances;
+	};
+
+	Font& Select(int pixelSize) {
+		auto [it, inserted] = fonts.try_emplace(pixelSize);
+		Font& font = it->second;
+		if (inserted) {
+			font.handle = CreateFontA(-pixelSize, 0, 0, 0, weight, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+				OUT_TT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, DEFAULT_PITCH, face.c_str());
+			SelectObject(dc, font.handle);
+			GetTextMetricsW(dc, &font.metrics);
+			selected = pixelSize;
+		}
+		else if (selected != pixelSize) {
+			SelectObject(dc, font.handle);
+			selected = pixelSize;
+		}
+		return font;
+	}
+
+	static constexpr MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+
+	std::string face;
+	int weight;
+	HDC dc = nullptr;
+	int selected = 0;
+	std::unordered_map<int, Font> fonts;
+	std::vector<uint8_t> buffer;
+	std::mutex mutex;
+};
+
+/// <summary>
+/// Distance field text drawn through WindowBuilderDraw2D, which must be loaded before it.
+/// Font 0 is Segoe UI unless fonts were added before the window was built. Every size is drawn
+/// from one glyph set, and strings are laid out once and cached, so per-frame labels only cost
+/// a lookup and one instance per glyph.
+/// </summary>
+class WindowBuilderText : public WBPlugin, public WBTextSystem {
+public:
+	void OnLoad(Window& window) override {
+		draw = window.GetPlugin<WindowBuilderDraw2D>();
+		if (!HasFonts())
+			AddFont(std::make_unique<WBGdiGlyphSource>("Segoe UI"));
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = desc.Height = GetAtlasSize();
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		if (SUCCEEDED(window.device->CreateTexture2D(&desc, nullptr, &atlasTexture)))
+			window.device->CreateShaderResourceView(atlasTexture, nullptr, &atlasView);
+	}
+
+	void OnUnload(Window&) override {
+		if (atlasView) atlasView->Release();
+		if (atlasTexture) atlasTexture->Release();
+		atlasView = nullptr;
+		atlasTexture = nullptr;
+		draw = nullptr;
+	}
+
+	void PreRender(Window& window) override {
+		Update();
+		auto [begin, end] = GetDirtyRows();
+		if (begin != end && atlasTexture) {
+			const UINT size = GetAtlasSize();
+			D3D11_BOX box = { 0, static_cast<UINT>(begin), 0, size, static_cast<UINT>(end), 1 };
+			window.context->UpdateSubresource(atlasTexture, 0, &box, GetAtlasPixels() + size_t(begin) * size, size, 0);
+		}
+		ClearDirty();
+	}
+
+	/// <summary>
+	/// Draws UTF-8 text with its top left corner at (x, y). Call from onRender.
+	/// </summary>
+	void Text(float x, float y, std::string_view text, float pixelSize, uint32_t color = 0xFFFFFFFF, FontId font = 0) {
+		if (!draw || !atlasView)
+			return;
+		Draw(font, text, x, y, pixelSize, [&](const WBGlyphQuad& q) {
+			draw->Glyph(atlasView, q.x0, q.y0, q.x1, q.y1, q.u0, q.v0, q.u1, q.v1, color);
+		});
+	}
+
+private:
+	WindowBuilderDraw2D* draw = nullptr;
+	ID3D11Texture2D* atlasTexture = nullptr;
+	ID3D11ShaderResourceView* atlasView = nullptr;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+// Platform independent controller for dynamic resolution: it watches the GPU time of recent frames
+// against a budget and picks the scale the window renders its scene at. It has no clock of its own,
+// so the same frame times always produce the same scales. windowbuilder.h owns the scaled render
+// target and the upscale.
+
+/// <summary>
+/// Budget and limits of a WBDynamicResolution controller.
+/// </summary>
+struct WBDynamicResolutionConfig {
+	double budgetMs = 14.0;         // GPU time a frame should fit in, leave some room below the refresh interval
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float step = 1.0f / 16.0f;      // Scales are multiples of this, so the scene target is rarely reallocated
+	int windowFrames = 30;          // Frames every decision is based on, collected again after each change
+	double percentile = 0.9;        // Frame time of the window compared against the budget
+	double lowerAbove = 1.0;        // Lower the scale when that frame time is above budgetMs * lowerAbove
+	double raiseBelow = 0.7;        // Raise it when it is below budgetMs * raiseBelow and one step up would fit
+};
+
+/// <summary>
+/// Counters of a WBDynamicResolution controller.
+/// </summary>
+struct WBDynamicResolutionStats {
+	uint64_t frames = 0;
+	uint64_t framesOverBudget = 0;
+	uint64_t lowered = 0;
+	uint64_t raised = 0;
+	double lastWindowMs = 0.0;      // Percentile frame time of the last full window
+};
+
+/// <summary>
+/// Picks a render scale from frame times. The cost of a frame is taken to grow with the number of
+/// pixels, so with the square of the scale. Over budget it lowers the scale straight to where the
+/// frame is predicted to fit in the middle of the hysteresis band; with headroom it raises it one
+/// step at a time, and only when the prediction for that step stays inside the band. Every change
+/// discards the collected frames, which were measured at the old scale.
+/// </summary>
+class WBDynamicResolution {
+public:
+	explicit WBDynamicResolution(const WBDynamicResolutionConfig& config = {}) : config(config) {
+		this->config.step = std::max(this->config.step, 1.0f / 256.0f);
+		this->config.windowFrames = std::max(this->config.windowFrames, 1);
+		this->config.minScale = std::min(std::max(this->config.minScale, 1.0f / 64.0f), 1.0f);
+		this->config.maxScale = std::min(std::max(this->config.maxScale, this->config.minScale), 1.0f);
+		scale = this->config.maxScale;
+		window.reserve(static_cast<size_t>(this->config.windowFrames));
+	}
+
+	/// <summary>
+	/// Adds the GPU time of a frame rendered at the current scale.
+	/// </summary>
+	/// <returns>The scale to render the next frame at.</returns>
+	float Update(double frameMs) {
+		++stats.frames;
+		if (frameMs > config.budgetMs)
+			++stats.framesOverBudget;
+		window.push_back(frameMs);
+		if (static_cast<int>(window.size()) < config.windowFrames)
+			return scale;
+
+		sorted = window;
+		size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(config.percentile * sorted.size()));
+		std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+		const double measured = sorted[rank];
+		stats.lastWindowMs = measured;
+		window.clear();
+
+		const double target = config.budgetMs * (config.lowerAbove + config.raiseBelow) * 0.5;
+		if (measured > config.budgetMs * config.lowerAbove && scale > config.minScale) {
+			// Jump to the predicted fit, at least one step down
+			float fit = static_cast<float>(scale * std::sqrt(target / measured));
+			float lower = std::min(Quantize(fit), Quantize(scale) - config.step);
+			Set(std::max(lower, config.minScale));
+			++stats.lowered;
+		}
+		else if (measured < config.budgetMs * config.raiseBelow && scale < config.maxScale) {
+			float higher = std::min(Quantize(scale) + config.step, config.maxScale);
+			double predicted = measured * (higher * higher) / (static_cast<double>(scale) * scale);
+			if (predicted <= target) {
+				Set(higher);
+				++stats.raised;
+			}
+		}
+		return scale;
+	}
+
+	/// <summary>
+	/// Drops the collected frames and goes back to the highest scale, e.g. after a resize.
+	/// </summary>
+	void Reset() {
+		window.clear();
+		scale = config.maxScale;
+	}
+
+	float GetScale() const { return scale; }
+	const WBDynamicResolutionConfig& GetConfig() const { return config; }
+	const WBDynamicResolutionStats& GetStats() const { return stats; }
+
+private:
+	// Rounds down to a multiple of the step, tolerating float error just below one
+	float Quantize(float value) const {
+		return static_cast<float>(std::floor(value / config.step + 1e-4)) * config.step;
+	}
+
+	void Set(float value) {
+		scale = std::min(std::max(value, config.minScale), config.maxScale);
+	}
+
+	WBDynamicResolutionConfig config;
+	WBDynamicResolutionStats stats;
+	std::vector<double> window;
+	std::vector<double> sorted;
+	float scale = 1.0f;
+};
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "windowbuilder_simd.h"
+
+// Shared-memory transport for finished frames. A producer (Window) publishes RGBA8 frames
+// into a ring of slots that any other process can map. Every slot carries a per-tile dirty
+// bitmap so consumers only copy or encode the tiles that changed.
+//
+// Memory layout: WBFrameRingHeader, then slotCount slots of
+// [WBFrameSlotHeader][bitmap words][pixels, capacityWidth * capacityHeight * 4].
+//
+// Slots are guarded by a sequence lock: the writer stores 2 * frame + 1 before touching a slot
+// and 2 * frame + 2 after. A reader that sees the same even value before and after copying
+// knows the copy is consistent; anything else means the producer lapped it.
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Frame ring needs lock-free 64-bit atomics");
+
+constexpr uint32_t WBFrameRingMagic = 0x47525742; // "BWRG"
+constexpr uint32_t WBFrameRingVersion = 1;
+
+struct WBFrameRingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacityWidth;
+	uint32_t capacityHeight;
+	uint32_t tileSize;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t bitmapWords;
+	uint32_t slotCount;
+	uint32_t reserved;
+	uint64_t slotBytes;
+	std::atomic<uint64_t> published; // Frames published so far, the newest is published - 1
+};
+
+struct WBFrameSlotHeader {
+	std::atomic<uint64_t> sequence;
+	uint64_t frame;
+	uint64_t timestampNs;
+	uint32_t width;
+	uint32_t height;
+	uint32_t dirtyTiles;
+	uint32_t reserved;
+};
+
+/// <summary>
+/// A named, process-shared memory mapping. POSIX shared memory on Linux, a pagefile-backed
+/// file mapping on Windows.
+/// </summary>
+class WBSharedMemory {
+public:
+	WBSharedMemory() = default;
+	WBSharedMemory(const WBSharedMemory&) = delete;
+	WBSharedMemory& operator=(const WBSharedMemory&) = delete;
+
+	~WBSharedMemory() {
+		Close();
+	}
+
+	/// <summary>
+	/// Creates a mapping. The name is local to the session, e.g. "WindowBuilderFrames". Fails if the
+	/// name is already in use, so a second producer cannot take over the ring of a running one.
+	/// </summary>
+	bool Create(const std::string& name, size_t bytes) {
+		Close();
+#ifdef _WIN32
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32), static_cast<DWORD>(bytes), ("Local\\" + name).c_str());
+		if (!mapping) return false;
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			Close();
+			return false;
+		}
+		data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes));
+#else
+		int fd = shm_open(("/" + name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) return false;
+		path = "/" + name;
+		owner = true;
+		if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+			close(fd);
+			Close();
+			return false;
+		}
+		void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		data = view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+#endif
+		size = data ? bytes : 0;
+		return data != nullptr;
+	}
+
+	/// <summary>
+	/// Removes a name left behind by a producer that crashed. POSIX names outlive their processes;
+	/// on Windows the mapping goes away with its last handle, so this does nothing there.
+	/// </summary>
+	static void Remove(const std::string& name) {
+#ifndef _WIN32
+		shm_unlink(("/" + name).c_str());
+#else
+		(void)name;
+#endif
+	}
+
+	/// <summary>
+	/// Opens a mapping created by another process. The size is taken from the mapping itself.
+	/// </summary>
+	bool Open(const std::string& name) {
+		Close();
+#ifdef _WIN32
+		mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, ("Local\\" + name).c_str());
+		if (!mapping) return false;
+		data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		MEMORY_BASIC_INFORMATION info = {};
+		if (data && VirtualQuery(data, &info, sizeof(info)))
+			size = info.RegionSize;
+#else
+		path = "/" + name;
+		int fd = shm_open(path.c_str(), O_RDWR, 0600);
+		if (fd < 0) return false;
+		struct stat st = {};
+		fstat(fd, &st);
+		size = static_cast<size_t>(st.st_size);
+		void* view = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		close(fd);
+		data = view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+#endif
+		return data != nullptr;
+	}
+
+	void Close() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		mapping = nullptr;
+#else
+		if (data) munmap(data, size);
+		if (owner && !path.empty()) shm_unlink(path.c_str());
+		path.clear();
+		owner = false;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	uint8_t* data = nullptr;
+	size_t size = 0;
+	bool owner = false;
+#ifdef _WIN32
+	HANDLE mapping = nullptr;
+#else
+	std::string path;
+#endif
+};
+
+/// <summary>
+/// Diffs one pixel row of two frames tile by tile. Sets flags[t] for every tile whose bytes differ,
+/// skipping tiles that are already flagged. Tiles are tileBytes wide, the last one may be shorter.
+/// </summary>
+inline void WBDiffTileRow(const uint8_t* a, const uint8_t* b, size_t rowBytes, size_t tileBytes, uint8_t* flags) {
+#if WB_HAS_SSE2
+	struct Kernels {
+		static bool SSE2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+			__m128i diff = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 16 <= bytes; i += 16)
+				diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF || memcmp(a + i, b + i, bytes - i) != 0;
+		}
+
+		WB_TARGET_AVX2 static void AVX2(const uint8_t* a, const uint8_t* b, size_t rowBytes, size_t tileBytes, uint8_t* flags) {
+			for (size_t start = 0, tile = 0; start < rowBytes; start += tileBytes, ++tile) {
+				if (flags[tile])
+					continue;
+				size_t bytes = std::min(tileBytes, rowBytes - start);
+				const uint8_t* x = a + start;
+				const uint8_t* y = b + start;
+				__m256i diff = _mm256_setzero_si256();
+				size_t i = 0;
+				for (; i + 32 <= bytes; i += 32)
+					diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+						_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i))));
+				flags[tile] = !_mm256_testz_si256(diff, diff) || SSE2(x + i, y + i, bytes - i);
+			}
+		}
+	};
+
+	if (WBCpuHasAVX2()) {
+		Kernels::AVX2(a, b, rowBytes, tileBytes, flags);
+		return;
+	}
+	for (size_t start = 0, tile = 0; start < rowBytes; start += tileBytes, ++tile)
+		if (!flags[tile])
+			flags[tile] = Kernels::SSE2(a + start, b + start, std::min(tileBytes, rowBytes - start));
+#else
+	for (size_t start = 0, tile = 0; start < rowBytes; start += tileBytes, ++tile)
+		if (!flags[tile])
+			flags[tile] = memcmp(a + start, b + start, std::min(tileBytes, rowBytes - start)) != 0;
+#endif
+}
+
+/// <summary>
+/// Shared geometry helpers for producer and consumer.
+/// </summary>
+class WBFrameRingView {
+public:
+	const WBFrameRingHeader* Header() const { return reinterpret_cast<const WBFrameRingHeader*>(memory.Data()); }
+	WBFrameRingHeader* Header() { return reinterpret_cast<WBFrameRingHeader*>(memory.Data()); }
+
+	WBFrameSlotHeader* Slot(uint64_t frame) {
+		return reinterpret_cast<WBFrameSlotHeader*>(memory.Data() + SlotsOffset() + (frame % Header()->slotCount) * Header()->slotBytes);
+	}
+
+	uint64_t* Bitmap(WBFrameSlotHeader* slot) {
+		return reinterpret_cast<uint64_t*>(slot + 1);
+	}
+
+	uint8_t* Pixels(WBFrameSlotHeader* slot) {
+		return reinterpret_cast<uint8_t*>(Bitmap(slot) + Header()->bitmapWords);
+	}
+
+	static size_t SlotsOffset() {
+		return (sizeof(WBFrameRingHeader) + 63) & ~size_t(63);
+	}
+
+	/// <summary>
+	/// Checks that a header describes a ring that fits in mappedBytes: the tile grid covers the
+	/// capacity, a slot holds its header, bitmap and a full frame, and all slots are mapped.
+	/// </summary>
+	static bool FitsIn(const WBFrameRingHeader& header, size_t mappedBytes) {
+		if (header.slotCount == 0 || header.tileSize == 0 || header.capacityWidth == 0 || header.capacityHeight == 0)
+			return false;
+		const uint64_t tilesX = (uint64_t(header.capacityWidth) + header.tileSize - 1) / header.tileSize;
+		const uint64_t tilesY = (uint64_t(header.capacityHeight) + header.tileSize - 1) / header.tileSize;
+		if (header.tilesX != tilesX || header.tilesY != tilesY || header.bitmapWords != (tilesX * tilesY + 63) / 64)
+			return false;
+		const uint64_t fixed = sizeof(WBFrameSlotHeader) + uint64_t(header.bitmapWords) * 8;
+		if (header.slotBytes < fixed || (header.slotBytes - fixed) / header.capacityHeight / 4 < header.capacityWidth)
+			return false;
+		if (mappedBytes < SlotsOffset())
+			return false;
+		return header.slotBytes <= (mappedBytes - SlotsOffset()) / header.slotCount;
+	}
+
+	static void SetBit(uint64_t* bitmap, uint32_t tile) { bitmap[tile / 64] |= uint64_t(1) << (tile % 64); }
+	static bool TestBit(const uint64_t* bitmap, uint32_t tile) { return (bitmap[tile / 64] >> (tile % 64)) & 1; }
+
+protected:
+	WBSharedMemory memory;
+};
+
+/// <summary>
+/// Publishes frames into a shared-memory ring. Single writer.
+/// Slots always hold complete frames, but a slot is only rewritten where tiles changed since
+/// it last held a frame, i.e. the union of the dirty bitmaps of the last slotCount frames.
+/// </summary>
+class WBFrameRingProducer : public WBFrameRingView {
+public:
+	/// <summary>
+	/// Creates the ring. Fails if another ring already uses the name.
+	/// </summary>
+	/// <param name="name">Mapping name consumers open.</param>
+	/// <param name="width">Largest frame width that will be published. Wider frames are cropped to it, the ring is never reallocated.</param>
+	/// <param name="height">Largest frame height that will be published, taller frames are cropped the same way.</param>
+	/// <param name="slotCount">Frames kept in the ring, at least 2.</param>
+	/// <param name="tileSize">Edge length of a dirty tile in pixels.</param>
+	bool Create(const std::string& name, uint32_t width, uint32_t height, uint32_t slotCount = 3, uint32_t tileSize = 32) {
+		if (width == 0 || height == 0 || tileSize == 0)
+			return false;
+		slotCount = std::max(2u, slotCount);
+		uint32_t tilesX = (width + tileSize - 1) / tileSize;
+		uint32_t tilesY = (height + tileSize - 1) / tileSize;
+		uint32_t bitmapWords = (tilesX * tilesY + 63) / 64;
+		uint64_t slotBytes = (sizeof(WBFrameSlotHeader) + bitmapWords * 8ull + uint64_t(width) * height * 4 + 63) & ~uint64_t(63);
+
+		if (!memory.Create(name, SlotsOffset() + slotBytes * slotCount))
+			return false;
+
+		WBFrameRingHeader* header = Header();
+		header->magic = WBFrameRingMagic;
+		header->version = WBFrameRingVersion;
+		header->capacityWidth = width;
+		header->capacityHeight = height;
+		header->tileSize = tileSize;
+		header->tilesX = tilesX;
+		header->tilesY = tilesY;
+		header->bitmapWords = bitmapWords;
+		header->slotCount = slotCount;
+		header->slotBytes = slotBytes;
+		header->published.store(0, std::memory_order_release);
+
+		// Every slot starts out stale everywhere
+		history.assign(slotCount, std::vector<uint64_t>(bitmapWords, ~uint64_t(0)));
+		return true;
+	}
+
+	bool IsOpen() const { return memory.Data() != nullptr; }
+
+	/// <summary>
+	/// Publishes a frame.
+	/// </summary>
+	/// <param name="rgba">Top-down RGBA8 pixels.</param>
+	/// <param name="width">Frame width. Pixels right of the ring capacity are dropped and the slot records the cropped width.</param>
+	/// <param name="height">Frame height. Rows below the ring capacity are dropped the same way.</param>
+	/// <param name="pitch">Bytes between source rows.</param>
+	/// <returns>Number of dirty tiles in this frame.</returns>
+	uint32_t Publish(const uint8_t* rgba, uint32_t width, uint32_t height, size_t pitch) {
+		WBFrameRingHeader* header = Header();
+		width = std::min(width, header->capacityWidth);
+		height = std::min(height, header->capacityHeight);
+
+		const uint64_t frame = header->published.load(std::memory_order_relaxed);
+		WBFrameSlotHeader* slot = Slot(frame);
+		WBFrameSlotHeader* previous = frame > 0 ? Slot(frame - 1) : nullptr;
+		const bool resized = !previous || previous->width != width || previous->height != height;
+		const size_t rowBytes = size_t(header->capacityWidth) * 4;
+
+		// Dirty tiles of this frame, compared against the previous slot one tile row at a time
+		std::vector<uint64_t>& dirty = history[frame % header->slotCount];
+		std::fill(dirty.begin(), dirty.end(), 0);
+		uint32_t dirtyTiles = 0;
+		const uint32_t usedTilesX = (width + header->tileSize - 1) / header->tileSize;
+		const uint32_t usedTilesY = (height + header->tileSize - 1) / header->tileSize;
+		flags.resize(usedTilesX);
+		for (uint32_t ty = 0; ty < usedTilesY; ++ty) {
+			std::fill(flags.begin(), flags.end(), resized ? 1 : 0);
+			for (uint32_t y = ty * header->tileSize; y < std::min(height, (ty + 1) * header->tileSize) && !resized; ++y)
+				WBDiffTileRow(rgba + y * pitch, Pixels(previous) + y * rowBytes, size_t(width) * 4, size_t(header->tileSize) * 4, flags.data());
+			for (uint32_t tx = 0; tx < usedTilesX; ++tx) {
+				if (flags[tx]) {
+					SetBit(dirty.data(), ty * header->tilesX + tx);
+					++dirtyTiles;
+				}
+			}
+		}
+
+		// Tiles that changed since this slot last held a frame
+		std::vector<uint64_t> stale(header->bitmapWords, 0);
+		for (const auto& bitmap : history)
+			for (uint32_t w = 0; w < header->bitmapWords; ++w)
+				stale[w] |= bitmap[w];
+
+		slot->sequence.store(frame * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint8_t* pixels = Pixels(slot);
+		for (uint32_t tile = 0; tile < header->tilesX * header->tilesY; ++tile) {
+			if (!TestBit(stale.data(), tile))
+				continue;
+			uint32_t x0 = (tile % header->tilesX) * header->tileSize, y0 = (tile / header->tilesX) * header->tileSize;
+			if (x0 >= width || y0 >= height)
+				continue;
+			uint32_t x1 = std::min(width, x0 + header->tileSize), y1 = std::min(height, y0 + header->tileSize);
+			for (uint32_t y = y0; y < y1; ++y)
+				memcpy(pixels + y * rowBytes + x0 * 4, rgba + y * pitch + x0 * 4, (x1 - x0) * 4);
+		}
+		memcpy(Bitmap(slot), dirty.data(), dirty.size() * 8);
+		slot->frame = frame;
+		slot->timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+		slot->width = width;
+		slot->height = height;
+		slot->dirtyTiles = dirtyTiles;
+
+		slot->sequence.store(frame * 2 + 2, std::memory_order_release);
+		header->published.store(frame + 1, std::memory_order_release);
+		return dirtyTiles;
+	}
+
+private:
+	std::vector<std::vector<uint64_t>> history; // Dirty bitmaps of the frames currently in the ring
+	std::vector<uint8_t> flags;                 // Per-tile scratch for the current tile row
+};
+
+/// <summary>
+/// A frame handed out by WBFrameRingConsumer.
+/// </summary>
+struct WBConsumedFrame {
+	uint64_t frame = 0;
+	uint64_t timestampNs = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t skipped = 0;             // Frames published between the previous Poll and this one
+	bool overrun = false;             // Skipped frames were already overwritten
+	bool full = false;                // Every tile is reported dirty (first frame, overrun or torn read)
+	std::vector<uint64_t> dirty;      // Tiles that changed since the previous frame this consumer saw
+	uint32_t dirtyTiles = 0;
+};
+
+/// <summary>
+/// Reference consumer. Keeps its own copy of the newest frame, updating only dirty tiles.
+/// When it falls behind it merges the dirty bitmaps of the frames it skipped, or treats the whole
+/// frame as dirty if some of those frames were already overwritten.
+/// </summary>
+class WBFrameRingConsumer : public WBFrameRingView {
+public:
+	/// <summary>
+	/// Maps a ring by name. Fails if there is none, or if its header does not match the mapping's size.
+	/// </summary>
+	bool Open(const std::string& name) {
+		if (!memory.Open(name) || memory.Size() < sizeof(WBFrameRingHeader))
+			return false;
+		const WBFrameRingHeader* header = Header();
+		if (header->magic != WBFrameRingMagic || header->version != WBFrameRingVersion || !FitsIn(*header, memory.Size())) {
+			memory.Close();
+			return false;
+		}
+		frame.assign(size_t(header->capacityWidth) * header->capacityHeight * 4, 0);
+		nextFrame = 0;
+		needFull = true;
+		return true;
+	}
+
+	/// <summary>
+	/// Takes the newest frame if there is one.
+	/// </summary>
+	/// <param name="out">Receives the frame metadata and dirty bitmap.</param>
+	/// <returns>False if nothing new was published.</returns>
+	bool Poll(WBConsumedFrame& out) {
+		WBFrameRingHeader* header = Header();
+		for (;;) {
+			uint64_t published = header->published.load(std::memory_order_acquire);
+			if (published == 0 || published <= nextFrame)
+				return false;
+
+			const uint64_t latest = published - 1;
+			out.frame = latest;
+			out.skipped = latest - nextFrame;
+			out.dirty.assign(header->bitmapWords, 0);
+
+			// Frames nextFrame..latest must all still be in the ring to merge their bitmaps
+			out.overrun = !needFull && latest - nextFrame >= header->slotCount;
+			out.full = needFull || out.overrun;
+			for (uint64_t f = nextFrame; !out.full && f <= latest; ++f) {
+				WBFrameSlotHeader* slot = Slot(f);
+				uint64_t before = slot->sequence.load(std::memory_order_acquire);
+				const uint64_t* bitmap = Bitmap(slot);
+				for (uint32_t w = 0; w < header->bitmapWords; ++w)
+					out.dirty[w] |= bitmap[w];
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (before != f * 2 + 2 || slot->sequence.load(std::memory_order_relaxed) != before)
+					out.overrun = out.full = true;
+			}
+			if (out.full)
+				std::fill(out.dirty.begin(), out.dirty.end(), ~uint64_t(0));
+
+			WBFrameSlotHeader* slot = Slot(latest);
+			uint64_t before = slot->sequence.load(std::memory_order_acquire);
+			if (before != latest * 2 + 2) {
+				++retries;
+				continue;
+			}
+			out.width = slot->width;
+			out.height = slot->height;
+			out.timestampNs = slot->timestampNs;
+			out.dirtyTiles = CopyDirtyTiles(slot, out.dirty, out.width, out.height);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot->sequence.load(std::memory_order_relaxed) != before) {
+				// Lapped while copying, the copy may be torn. Start over and take everything.
+				++retries;
+				needFull = true;
+				continue;
+			}
+
+			nextFrame = latest + 1;
+			needFull = false;
+			return true;
+		}
+	}
+
+	/// <summary>
+	/// The consumer's copy of the newest frame, capacityWidth * 4 bytes per row.
+	/// </summary>
+	const uint8_t* GetPixels() const { return frame.data(); }
+	uint32_t GetPitch() const { return Header()->capacityWidth * 4; }
+	uint32_t GetTileSize() const { return Header()->tileSize; }
+	uint32_t GetTilesX() const { return Header()->tilesX; }
+	uint32_t GetTilesY() const { return Header()->tilesY; }
+	uint64_t GetRetries() const { return retries; }
+
+private:
+	uint32_t CopyDirtyTiles(WBFrameSlotHeader* slot, const std::vector<uint64_t>& dirty, uint32_t width, uint32_t height) {
+		const WBFrameRingHeader* header = Header();
+		const size_t rowBytes = size_t(header->capacityWidth) * 4;
+		const uint8_t* src = Pixels(slot);
+		uint32_t copied = 0;
+		for (uint32_t tile = 0; tile < header->tilesX * header->tilesY; ++tile) {
+			if (!TestBit(dirty.data(), tile))
+				continue;
+			uint32_t x0 = (tile % header->tilesX) * header->tileSize, y0 = (tile / header->tilesX) * header->tileSize;
+			if (x0 >= width || y0 >= height)
+				continue;
+			uint32_t x1 = std::min(width, x0 + header->tileSize), y1 = std::min(height, y0 + header->tileSize);
+			for (uint32_t y = y0; y < y1; ++y)
+				memcpy(frame.data() + y * rowBytes + x0 * 4, src + y * rowBytes + x0 * 4, (x1 - x0) * 4);
+			++copied;
+		}
+		return copied;
+	}
+
+	std::vector<uint8_t> frame;
+	uint64_t nextFrame = 0;
+	bool needFull = true;
+	uint64_t retries = 0;
+};
@@ -1,13 +1,453 @@
 #pragma once
 
 #include "windowbuilder.h"
+#include "windowbuilder_imgui_batch.h"
 
 #include <imgui.h>
 #include <imgui_impl_win32.h>
-#include <imgui_impl_dx11.h>
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
+/// <summary>
+/// DX11 renderer for ImDrawData, used by WindowBuilderImGui in place of imgui_impl_dx11.
+/// Vertices and indices go into persistent dynamic buffers that are sub-allocated as rings
+/// and only ever mapped with NO_OVERWRITE; each frame ends with an event query, and ring space
+/// is reused once the query for the frame that used it has completed. Buffers grow geometrically
+/// when they can't hold a few frames in flight, and consecutive commands with the same texture
+/// and clip rect are merged into one draw call (WBImGuiBatcher).
+/// Like imgui_impl_dx11, RenderDrawData saves the pipeline state it touches and restores it when
+/// it is done, so code drawing after it does not inherit ImGui's scissor rect, scissor-enabled
+/// rasterizer state, viewport, blend state or shaders. Render targets are never changed.
+/// </summary>
+class WBImGuiRendererDX11 {
+public:
+	static constexpr size_t initialVertices = 64 * 1024;
+	static constexpr size_t initialIndices = 128 * 1024;
+	static constexpr size_t framesOfHeadroom = 3; // Ring size kept per frame of geometry before waiting instead of growing
+
+	bool Init(ID3D11Device* newDevice, ID3D11DeviceContext* newContext) {
+		device = newDevice;
+		context = newContext;
+
+		ID3DBlob* vsBlob = WBCompileShader(shaderSource, "VSMain", "vs_4_0");
+		ID3DBlob* psBlob = WBCompileShader(shaderSource, "PSMain", "ps_4_0");
+		if (!vsBlob || !psBlob) {
+			if (vsBlob) vsBlob->Release();
+			if (psBlob) psBlob->Release();
+			return false;
+		}
+		device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
+		device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] = {
+			{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, (UINT)offsetof(ImDrawVert, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, (UINT)offsetof(ImDrawVert, uv), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, (UINT)offsetof(ImDrawVert, col), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		device->CreateInputLayout(layout, ARRAYSIZE(layout), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &inputLayout);
+		vsBlob->Release();
+		psBlob->Release();
+
+		D3D11_BUFFER_DESC cbDesc = {};
+		cbDesc.ByteWidth = sizeof(float) * 16;
+		cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+		cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&cbDesc, nullptr, &constantBuffer);
+
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		device->CreateBlendState(&blendDesc, &blendState);
+
+		D3D11_RASTERIZER_DESC rasterDesc = {};
+		rasterDesc.FillMode = D3D11_FILL_SOLID;
+		rasterDesc.CullMode = D3D11_CULL_NONE;
+		rasterDesc.ScissorEnable = TRUE;
+		rasterDesc.DepthClipEnable = TRUE;
+		device->CreateRasterizerState(&rasterDesc, &rasterizerState);
+
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		device->CreateDepthStencilState(&depthDesc, &depthStencilState);
+
+		D3D11_SAMPLER_DESC samplerDesc = {};
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = samplerDesc.AddressV = samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+		device->CreateSamplerState(&samplerDesc, &samplerState);
+
+		CreateRingBuffer(vertexBuffer, vertexRing, initialVertices, sizeof(ImDrawVert), D3D11_BIND_VERTEX_BUFFER);
+		CreateRingBuffer(indexBuffer, indexRing, initialIndices, sizeof(ImDrawIdx), D3D11_BIND_INDEX_BUFFER);
+		return vertexShader && pixelShader && vertexBuffer && indexBuffer;
+	}
+
+	void Shutdown() {
+		for (const PendingFence& pending : fences)
+			pending.query->Release();
+		for (ID3D11Query* query : freeQueries)
+			query->Release();
+		fences.clear();
+		freeQueries.clear();
+
+		ID3D11DeviceChild* objects[] = { fontView, vertexBuffer, indexBuffer, samplerState, depthStencilState,
+			rasterizerState, blendState, constantBuffer, inputLayout, pixelShader, vertexShader };
+		for (ID3D11DeviceChild* object : objects)
+			if (object) object->Release();
+		fontView = nullptr;
+		vertexBuffer = indexBuffer = constantBuffer = nullptr;
+		samplerState = nullptr;
+		depthStencilState = nullptr;
+		rasterizerState = nullptr;
+		blendState = nullptr;
+		inputLayout = nullptr;
+		pixelShader = nullptr;
+		vertexShader = nullptr;
+	}
+
+	/// <summary>
+	/// Uploads the font atlas of the current ImGui context. Called lazily before the first frame,
+	/// so fonts added after the plugin loaded are still picked up.
+	/// </summary>
+	void CreateFontTexture() {
+		ImGuiIO& io = ImGui::GetIO();
+		unsigned char* pixels = nullptr;
+		int width = 0, height = 0;
+		io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		D3D11_SUBRESOURCE_DATA initial = { pixels, static_cast<UINT>(width * 4), 0 };
+
+		ID3D11Texture2D* texture = nullptr;
+		if (SUCCEEDED(device->CreateTexture2D(&desc, &initial, &texture))) {
+			device->CreateShaderResourceView(texture, nullptr, &fontView);
+			texture->Release();
+		}
+		io.Fonts->SetTexID((ImTextureID)fontView);
+	}
+
+	bool HasFontTexture() const { return fontView != nullptr; }
+
+	void RenderDrawData(ImDrawData* data) {
+		if (!data || data->DisplaySize.x <= 0.0f || data->DisplaySize.y <= 0.0f || !vertexShader)
+			return;
+
+		const int framebufferWidth = static_cast<int>(data->DisplaySize.x * data->FramebufferScale.x);
+		const int framebufferHeight = static_cast<int>(data->DisplaySize.y * data->FramebufferScale.y);
+		batcher.Build(data, framebufferWidth, framebufferHeight);
+		stats.commands = batcher.GetCommandCount();
+		stats.drawCalls = 0;
+		stats.bytesUploaded = 0;
+		if (batcher.GetVertexCount() == 0 || batcher.GetIndexCount() == 0)
+			return;
+
+		RetireCompletedFrames(false);
+		size_t vertexOffset = Reserve(vertexBuffer, vertexRing, vertexFresh, batcher.GetVertexCount(), sizeof(ImDrawVert), D3D11_BIND_VERTEX_BUFFER);
+		size_t indexOffset = Reserve(indexBuffer, indexRing, indexFresh, batcher.GetIndexCount(), sizeof(ImDrawIdx), D3D11_BIND_INDEX_BUFFER);
+		if (vertexOffset == WBRingAllocator::invalid || indexOffset == WBRingAllocator::invalid)
+			return;
+
+		// A freshly created buffer is mapped once with DISCARD, everything after that appends with NO_OVERWRITE
+		D3D11_MAPPED_SUBRESOURCE vertexMap = {}, indexMap = {};
+		if (FAILED(context->Map(vertexBuffer, 0, vertexFresh ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &vertexMap)))
+			return;
+		if (FAILED(context->Map(indexBuffer, 0, indexFresh ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &indexMap))) {
+			context->Unmap(vertexBuffer, 0);
+			return;
+		}
+		vertexFresh = indexFresh = false;
+		batcher.Write(data, static_cast<ImDrawVert*>(vertexMap.pData) + vertexOffset, static_cast<ImDrawIdx*>(indexMap.pData) + indexOffset);
+		context->Unmap(vertexBuffer, 0);
+		context->Unmap(indexBuffer, 0);
+		stats.bytesUploaded = batcher.GetVertexCount() * sizeof(ImDrawVert) + batcher.GetIndexCount() * sizeof(ImDrawIdx);
+
+		SavedState saved;
+		saved.Save(context);
+		SetupRenderState(data);
+		void* boundTexture = nullptr;
+		for (const WBImGuiDraw& draw : batcher.GetDraws()) {
+			if (draw.callback) {
+				if (draw.callback->UserCallback == ImDrawCallback_ResetRenderState)
+					SetupRenderState(data);
+				else
+					draw.callback->UserCallback(draw.list, draw.callback);
+				boundTexture = nullptr;
+				continue;
+			}
+
+			const D3D11_RECT scissor = { draw.clip[0], draw.clip[1], draw.clip[2], draw.clip[3] };
+			context->RSSetScissorRects(1, &scissor);
+			if ((void*)draw.texture != boundTexture) {
+				ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)draw.texture;
+				context->PSSetShaderResources(0, 1, &texture);
+				boundTexture = (void*)draw.texture;
+			}
+			context->DrawIndexed(draw.indexCount, static_cast<UINT>(indexOffset + draw.indexOffset),
+				static_cast<INT>(vertexOffset + draw.baseVertex));
+			++stats.drawCalls;
+		}
+		saved.Restore(context);
+
+		// Fence the frame so its ring space can be reused once the GPU is done with it
+		ID3D11Query* query = AcquireQuery();
+		if (query) {
+			context->End(query);
+			fences.push_back({ query, nextFence });
+		}
+		vertexRing.EndFrame(nextFence);
+		indexRing.EndFrame(nextFence);
+		++nextFence;
+	}
+
+	const WBImGuiRenderStats& GetStats() const { return stats; }
+
+private:
+	struct PendingFence {
+		ID3D11Query* query;
+		uint64_t fence;
+	};
+
+	// The state SetupRenderState and the draws change, saved and restored the way imgui_impl_dx11 does
+	struct SavedState {
+		UINT scissorCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+		UINT viewportCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+		D3D11_RECT scissors[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+		D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+		ID3D11RasterizerState* rasterizerState = nullptr;
+		ID3D11BlendState* blendState = nullptr;
+		FLOAT blendFactor[4] = {};
+		UINT sampleMask = 0;
+		UINT stencilRef = 0;
+		ID3D11DepthStencilState* depthStencilState = nullptr;
+		ID3D11ShaderResourceView* shaderResource = nullptr;
+		ID3D11SamplerState* sampler = nullptr;
+		ID3D11PixelShader* pixelShader = nullptr;
+		ID3D11VertexShader* vertexShader = nullptr;
+		ID3D11GeometryShader* geometryShader = nullptr;
+		ID3D11ClassInstance* psInstances[256] = {};
+		ID3D11ClassInstance* vsInstances[256] = {};
+		ID3D11ClassInstance* gsInstances[256] = {};
+		UINT psInstanceCount = 256, vsInstanceCount = 256, gsInstanceCount = 256;
+		ID3D11Buffer* vsConstantBuffer = nullptr;
+		D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+		ID3D11Buffer* indexBuffer = nullptr;
+		DXGI_FORMAT indexFormat = DXGI_FORMAT_UNKNOWN;
+		UINT indexOffset = 0;
+		ID3D11Buffer* vertexBuffer = nullptr;
+		UINT vertexStride = 0, vertexOffset = 0;
+		ID3D11InputLayout* inputLayout = nullptr;
+
+		void Save(ID3D11DeviceContext* context) {
+			context->RSGetScissorRects(&scissorCount, scissors);
+			context->RSGetViewports(&viewportCount, viewports);
+			context->RSGetState(&rasterizerState);
+			context->OMGetBlendState(&blendState, blendFactor, &sampleMask);
+			context->OMGetDepthStencilState(&depthStencilState, &stencilRef);
+			context->PSGetShaderResources(0, 1, &shaderResource);
+			context->PSGetSamplers(0, 1, &sampler);
+			context->PSGetShader(&pixelShader, psInstances, &psInstanceCount);
+			context->VSGetShader(&vertexShader, vsInstances, &vsInstanceCount);
+			context->GSGetShader(&geometryShader, gsInstances, &gsInstanceCount);
+			context->VSGetConstantBuffers(0, 1, &vsConstantBuffer);
+			context->IAGetPrimitiveTopology(&topology);
+			context->IAGetIndexBuffer(&indexBuffer, &indexFormat, &indexOffset);
+			context->IAGetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+			context->IAGetInputLayout(&inputLayout);
+		}
+
+		// Rebinds everything and drops the references the getters took
+		void Restore(ID3D11DeviceContext* context) {
+			context->RSSetScissorRects(scissorCount, scissors);
+			context->RSSetViewports(viewportCount, viewports);
+			context->RSSetState(rasterizerState);
+			context->OMSetBlendState(blendState, blendFactor, sampleMask);
+			context->OMSetDepthStencilState(depthStencilState, stencilRef);
+			context->PSSetShaderResources(0, 1, &shaderResource);
+			context->PSSetSamplers(0, 1, &sampler);
+			context->PSSetShader(pixelShader, psInstances, psInstanceCount);
+			context->VSSetShader(vertexShader, vsInstances, vsInstanceCount);
+			context->GSSetShader(geometryShader, gsInstances, gsInstanceCount);
+			context->VSSetConstantBuffers(0, 1, &vsConstantBuffer);
+			context->IASetPrimitiveTopology(topology);
+			context->IASetIndexBuffer(indexBuffer, indexFormat, indexOffset);
+			context->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+			context->IASetInputLayout(inputLayout);
+
+			IUnknown* held[] = { rasterizerState, blendState, depthStencilState, shaderResource, sampler, pixelShader,
+				vertexShader, geometryShader, vsConstantBuffer, indexBuffer, vertexBuffer, inputLayout };
+			for (IUnknown* object : held)
+				if (object) object->Release();
+			for (UINT i = 0; i < psInstanceCount; ++i) if (psInstances[i]) psInstances[i]->Release();
+			for (UINT i = 0; i < vsInstanceCount; ++i) if (vsInstances[i]) vsInstances[i]->Release();
+			for (UINT i = 0; i < gsInstanceCount; ++i) if (gsInstances[i]) gsInstances[i]->Release();
+		}
+	};
+
+	void SetupRenderState(ImDrawData* data) {
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, data->DisplaySize.x * data->FramebufferScale.x,
+			data->DisplaySize.y * data->FramebufferScale.y, 0.0f, 1.0f };
+		context->RSSetViewports(1, &viewport);
+
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (SUCCEEDED(context->Map(constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			const float l = data->DisplayPos.x, r = data->DisplayPos.x + data->DisplaySize.x;
+			const float t = data->DisplayPos.y, b = data->DisplayPos.y + data->DisplaySize.y;
+			const float mvp[16] = {
+				2.0f / (r - l),    0.0f,              0.0f, 0.0f,
+				0.0f,              2.0f / (t - b),    0.0f, 0.0f,
+				0.0f,              0.0f,              0.5f, 0.0f,
+				(r + l) / (l - r), (t + b) / (b - t), 0.5f, 1.0f,
+			};
+			memcpy(mapped.pData, mvp, sizeof(mvp));
+			context->Unmap(constantBuffer, 0);
+		}
+
+		const UINT stride = sizeof(ImDrawVert), offset = 0;
+		const float blendFactor[4] = {};
+		context->IASetInputLayout(inputLayout);
+		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		context->IASetIndexBuffer(indexBuffer, sizeof(ImDrawIdx) == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		context->VSSetShader(vertexShader, nullptr, 0);
+		context->VSSetConstantBuffers(0, 1, &constantBuffer);
+		context->PSSetShader(pixelShader, nullptr, 0);
+		context->PSSetSamplers(0, 1, &samplerState);
+		context->GSSetShader(nullptr, nullptr, 0);
+		context->OMSetBlendState(blendState, blendFactor, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(depthStencilState, 0);
+		context->RSSetState(rasterizerState);
+	}
+
+	/// <summary>
+	/// Finds space for count elements, retiring finished frames, then waiting for the GPU when
+	/// the ring is large enough and only busy, and growing it when it is simply too small.
+	/// </summary>
+	size_t Reserve(ID3D11Buffer*& buffer, WBRingAllocator& ring, bool& fresh, size_t count, UINT elementSize, UINT bindFlags) {
+		size_t offset = ring.Allocate(count);
+		while (offset == WBRingAllocator::invalid && ring.GetCapacity() >= count * framesOfHeadroom && !fences.empty()) {
+			RetireCompletedFrames(true);
+			++stats.fenceWaits;
+			offset = ring.Allocate(count);
+		}
+		if (offset != WBRingAllocator::invalid)
+			return offset;
+
+		CreateRingBuffer(buffer, ring, std::max(ring.GetCapacity() * 2, count * framesOfHeadroom), elementSize, bindFlags);
+		fresh = true;
+		++stats.bufferGrowths;
+		return ring.Allocate(count);
+	}
+
+	void CreateRingBuffer(ID3D11Buffer*& buffer, WBRingAllocator& ring, size_t elements, UINT elementSize, UINT bindFlags) {
+		// The old buffer stays alive until the GPU is done with the frames that reference it
+		if (buffer) buffer->Release();
+		buffer = nullptr;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = static_cast<UINT>(elements * elementSize);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = bindFlags;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&desc, nullptr, &buffer);
+		ring.Reset(buffer ? elements : 0);
+	}
+
+	/// <summary>
+	/// Retires every frame whose query has completed. With wait, blocks until at least the oldest one has.
+	/// </summary>
+	void RetireCompletedFrames(bool wait) {
+		bool waited = !wait;
+		while (!fences.empty()) {
+			PendingFence& oldest = fences.front();
+			HRESULT result = context->GetData(oldest.query, nullptr, 0, waited ? D3D11_ASYNC_GETDATA_DONOTFLUSH : 0);
+			if (result == S_FALSE) {
+				if (waited)
+					break;
+				YieldProcessor();
+				continue;
+			}
+			// S_OK, or the device was lost and nothing is in flight anymore
+			waited = true;
+			vertexRing.Retire(oldest.fence);
+			indexRing.Retire(oldest.fence);
+			freeQueries.push_back(oldest.query);
+			fences.pop_front();
+		}
+	}
+
+	ID3D11Query* AcquireQuery() {
+		if (!freeQueries.empty()) {
+			ID3D11Query* query = freeQueries.back();
+			freeQueries.pop_back();
+			return query;
+		}
+		D3D11_QUERY_DESC desc = { D3D11_QUERY_EVENT, 0 };
+		ID3D11Query* query = nullptr;
+		device->CreateQuery(&desc, &query);
+		return query;
+	}
+
+	static constexpr const char* shaderSource = R"(
+cbuffer vertexBuffer : register(b0) { float4x4 ProjectionMatrix; };
+Texture2D texture0 : register(t0);
+SamplerState sampler0 : register(s0);
+
+struct VSIn { float2 pos : POSITION; float4 col : COLOR0; float2 uv : TEXCOORD0; };
+struct PSIn { float4 pos : SV_POSITION; float4 col : COLOR0; float2 uv : TEXCOORD0; };
+
+PSIn VSMain(VSIn input) {
+	PSIn output;
+	output.pos = mul(ProjectionMatrix, float4(input.pos.xy, 0.0, 1.0));
+	output.col = input.col;
+	output.uv = input.uv;
+	return output;
+}
+
+float4 PSMain(PSIn input) : SV_TARGET {
+	return input.col * texture0.Sample(sampler0, input.uv);
+}
+)";
+
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* context = nullptr;
+	ID3D11VertexShader* vertexShader = nullptr;
+	ID3D11PixelShader* pixelShader = nullptr;
+	ID3D11InputLayout* inputLayout = nullptr;
+	ID3D11Buffer* constantBuffer = nullptr;
+	ID3D11BlendState* blendState = nullptr;
+	ID3D11RasterizerState* rasterizerState = nullptr;
+	ID3D11DepthStencilState* depthStencilState = nullptr;
+	ID3D11SamplerState* samplerState = nullptr;
+	ID3D11ShaderResourceView* fontView = nullptr;
+
+	ID3D11Buffer* vertexBuffer = nullptr;
+	ID3D11Buffer* indexBuffer = nullptr;
+	WBRingAllocator vertexRing;
+	WBRingAllocator indexRing;
+	bool vertexFresh = true;
+	bool indexFresh = true;
+	std::deque<PendingFence> fences;
+	std::vector<ID3D11Query*> freeQueries;
+	uint64_t nextFence = 1;
+
+	WBImGuiBatcher batcher;
+	WBImGuiRenderStats stats;
+};
+
 class WindowBuilderImGui : public WBPlugin {
 public:
 	void OnLoad(Window& window) override {
@@ -18,29 +458,47 @@ public:
 		io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;        // Enable Gamepad Controls
 		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;           // Enable Docking
 		io.IniFilename = nullptr;									// Disable .ini file
+		io.BackendRendererName = "windowbuilder_dx11";
+		io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;  // Large meshes are drawn with a base vertex
 		ImGui::StyleColorsDark();
 		ImGui_ImplWin32_Init(window.hWnd);
-		ImGui_ImplDX11_Init(window.device, window.context);
+		renderer.Init(window.device, window.context);
 	}
 
 	void OnUnload(Window& window) override {
-		ImGui_ImplDX11_Shutdown();
+		renderer.Shutdown();
 		ImGui_ImplWin32_Shutdown();
 		ImGui::DestroyContext();
 	}
 
 	void PreRender(Window& window) override {
-		ImGui_ImplDX11_NewFrame();
+		if (!renderer.HasFontTexture())
+			renderer.CreateFontTexture();
 		ImGui_ImplWin32_NewFrame();
 		ImGui::NewFrame();
 	}
 
 	void PostRender(Window& window) override {
 		ImGui::Render();
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		renderer.RenderDrawData(ImGui::GetDrawData());
 	}
 
 	void HandleMessage(Window& window, UINT message, WPARAM wParam, LPARAM lParam) override {
 		ImGui_ImplWin32_WndProcHandler(window.hWnd, message, wParam, lParam);
 	}
+
+	// Draw data is in window pixels with scissor rects to match, and text should stay sharp
+	bool ScalesWithResolution() const override {
+		return false;
+	}
+
+	/// <summary>
+	/// Gets the renderer counters: commands, draw calls and bytes uploaded in the last frame.
+	/// </summary>
+	const WBImGuiRenderStats& GetRenderStats() const {
+		return renderer.GetStats();
+	}
+
+private:
+	WBImGuiRendererDX11 renderer;
 };
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <imgui.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "windowbuilder_ring.h"
+
+// Platform independent half of the WindowBuilderImGui renderer: lays out a frame's vertices and
+// indices as one contiguous block and merges draw commands. The DX11 side only uploads and draws.
+
+/// <summary>
+/// One draw call after merging. Offsets are relative to the start of the frame's block.
+/// </summary>
+struct WBImGuiDraw {
+	ImTextureID texture = ImTextureID();
+	int clip[4] = {};                     // Scissor rectangle in framebuffer pixels: x0, y0, x1, y1
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	int32_t baseVertex = 0;
+	const ImDrawList* list = nullptr;     // Set with callback for user callbacks
+	const ImDrawCmd* callback = nullptr;  // Non-null: no geometry, run the callback instead
+};
+
+/// <summary>
+/// Counters of the last frame rendered by the ImGui plugin.
+/// </summary>
+struct WBImGuiRenderStats {
+	uint32_t commands = 0;      // ImDrawCmd submitted by ImGui
+	uint32_t drawCalls = 0;     // DrawIndexed issued after merging
+	size_t bytesUploaded = 0;   // Vertex and index bytes written this frame
+	uint32_t bufferGrowths = 0; // Times a ring buffer was recreated larger, since startup
+	uint32_t fenceWaits = 0;    // Frames that had to wait for the GPU to free ring space, since startup
+};
+
+/// <summary>
+/// Builds the merged draw list for an ImDrawData. When every vertex of the frame is addressable
+/// by ImDrawIdx, indices are rebased onto one shared base vertex while they are copied, so
+/// consecutive commands with the same texture and clip rect merge even across draw lists.
+/// Otherwise each list keeps its own base vertex and only commands inside a list merge.
+/// </summary>
+class WBImGuiBatcher {
+public:
+	/// <summary>
+	/// Plans the frame: computes the merged draws and whether indices are rebased.
+	/// </summary>
+	/// <param name="data">The frame from ImGui::GetDrawData().</param>
+	/// <param name="framebufferWidth">Clip rects are clamped to the framebuffer.</param>
+	/// <param name="framebufferHeight">Clip rects are clamped to the framebuffer.</param>
+	void Build(const ImDrawData* data, int framebufferWidth, int framebufferHeight) {
+		draws.clear();
+		commands = 0;
+		vertexCount = data ? static_cast<uint32_t>(data->TotalVtxCount) : 0;
+		indexCount = data ? static_cast<uint32_t>(data->TotalIdxCount) : 0;
+		if (!data || data->CmdListsCount == 0)
+			return;
+
+		rebase = uint64_t(vertexCount) <= uint64_t(ImDrawIdx(~ImDrawIdx(0))) + 1;
+		const ImVec2 offset = data->DisplayPos;
+		const ImVec2 scale = data->FramebufferScale;
+
+		uint32_t vertexBase = 0, indexBase = 0;
+		for (int n = 0; n < data->CmdListsCount; ++n) {
+			const ImDrawList* list = data->CmdLists[n];
+			for (int c = 0; c < list->CmdBuffer.Size; ++c) {
+				const ImDrawCmd* cmd = &list->CmdBuffer[c];
+				++commands;
+				if (cmd->UserCallback) {
+					WBImGuiDraw draw;
+					draw.list = list;
+					draw.callback = cmd;
+					draws.push_back(draw);
+					continue;
+				}
+
+				WBImGuiDraw draw;
+				draw.clip[0] = std::max(0, static_cast<int>((cmd->ClipRect.x - offset.x) * scale.x));
+				draw.clip[1] = std::max(0, static_cast<int>((cmd->ClipRect.y - offset.y) * scale.y));
+				draw.clip[2] = std::min(framebufferWidth, static_cast<int>((cmd->ClipRect.z - offset.x) * scale.x));
+				draw.clip[3] = std::min(framebufferHeight, static_cast<int>((cmd->ClipRect.w - offset.y) * scale.y));
+				if (draw.clip[2] <= draw.clip[0] || draw.clip[3] <= draw.clip[1] || cmd->ElemCount == 0)
+					continue;
+
+				draw.texture = cmd->GetTexID();
+				draw.indexOffset = indexBase + cmd->IdxOffset;
+				draw.indexCount = cmd->ElemCount;
+				draw.baseVertex = rebase ? 0 : static_cast<int32_t>(vertexBase + cmd->VtxOffset);
+
+				if (!draws.empty()) {
+					WBImGuiDraw& last = draws.back();
+					if (!last.callback && last.texture == draw.texture && last.baseVertex == draw.baseVertex
+						&& last.indexOffset + last.indexCount == draw.indexOffset
+						&& memcmp(last.clip, draw.clip, sizeof(draw.clip)) == 0) {
+						last.indexCount += draw.indexCount;
+						continue;
+					}
+				}
+				draws.push_back(draw);
+			}
+			vertexBase += list->VtxBuffer.Size;
+			indexBase += list->IdxBuffer.Size;
+		}
+	}
+
+	/// <summary>
+	/// Copies the frame planned by Build into mapped vertex and index memory.
+	/// </summary>
+	void Write(const ImDrawData* data, ImDrawVert* vertices, ImDrawIdx* indices) const {
+		uint32_t vertexBase = 0;
+		for (int n = 0; n < data->CmdListsCount; ++n) {
+			const ImDrawList* list = data->CmdLists[n];
+			memcpy(vertices, list->VtxBuffer.Data, list->VtxBuffer.Size * sizeof(ImDrawVert));
+			if (!rebase) {
+				memcpy(indices, list->IdxBuffer.Data, list->IdxBuffer.Size * sizeof(ImDrawIdx));
+			}
+			else {
+				for (int c = 0; c < list->CmdBuffer.Size; ++c) {
+					const ImDrawCmd& cmd = list->CmdBuffer[c];
+					if (cmd.UserCallback)
+						continue;
+					const ImDrawIdx add = static_cast<ImDrawIdx>(vertexBase + cmd.VtxOffset);
+					const ImDrawIdx* src = list->IdxBuffer.Data + cmd.IdxOffset;
+					ImDrawIdx* dst = indices + cmd.IdxOffset;
+					for (uint32_t i = 0; i < cmd.ElemCount; ++i)
+						dst[i] = static_cast<ImDrawIdx>(src[i] + add);
+				}
+			}
+			vertices += list->VtxBuffer.Size;
+			indices += list->IdxBuffer.Size;
+			vertexBase += list->VtxBuffer.Size;
+		}
+	}
+
+	const std::vector<WBImGuiDraw>& GetDraws() const { return draws; }
+	uint32_t GetVertexCount() const { return vertexCount; }
+	uint32_t GetIndexCount() const { return indexCount; }
+	uint32_t GetCommandCount() const { return commands; }
+	bool IsRebased() const { return rebase; }
+
+private:
+	std::vector<WBImGuiDraw> draws;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t commands = 0;
+	bool rebase = false;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Platform independent frame latency bookkeeping. Window::Show() stamps input with the OS event
+// time, simulation start, late latch, submit and present; the clock is injectable so the
+// bookkeeping can be driven by a virtual clock in tests.
+
+/// <summary>
+/// Monotonic clock in nanoseconds, the default for WBLatencyTracker.
+/// </summary>
+inline uint64_t WBSteadyNowNs() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>
+/// Converts the time of an OS input event, in milliseconds of the tick count (MSG::time,
+/// GetMessageTime, MOUSEMOVEPOINT::time on Windows), to a clock in nanoseconds. nowNs and nowTick
+/// must be read at the same moment. Tick counts wrap every 49.7 days, so the age is taken modulo
+/// 2^32; an event that appears to be in the future is taken as now.
+/// </summary>
+inline uint64_t WBEventTimeNs(uint64_t nowNs, uint32_t nowTick, uint32_t eventTick) {
+	const uint32_t ageMs = nowTick - eventTick;
+	if (ageMs > 0x80000000u)
+		return nowNs;
+	const uint64_t ageNs = uint64_t(ageMs) * 1000000;
+	return ageNs < nowNs ? nowNs - ageNs : 0;
+}
+
+/// <summary>
+/// Timestamps of one frame, in the tracker's clock. Input stamps are 0 when the frame consumed no input.
+/// </summary>
+struct WBFrameTiming {
+	uint64_t frame = 0;
+	uint32_t inputCount = 0;   // Input events consumed by this frame
+	uint64_t oldestInput = 0;  // Event time of the oldest consumed input
+	uint64_t newestInput = 0;  // Event time of the newest consumed input
+	uint64_t simulation = 0;   // Frame start, before onRender
+	uint64_t latch = 0;        // Late latch, 0 when none ran
+	uint64_t submit = 0;       // Right before Present
+	uint64_t present = 0;      // Present returned
+};
+
+/// <summary>
+/// Distribution of one latency over the tracker's sample window, in milliseconds.
+/// </summary>
+struct WBLatencySummary {
+	size_t count = 0;
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+/// <summary>
+/// Latency distributions of the most recent frames.
+/// </summary>
+struct WBLatencyStats {
+	uint64_t frames = 0;              // Frames presented since startup
+	uint64_t framesWithInput = 0;
+	WBLatencySummary oldestInputToPresent; // Worst case input to photon, frames with input only
+	WBLatencySummary newestInputToPresent; // What a pointer that was latched last sees
+	WBLatencySummary simulationToPresent;  // Frame start to present, every frame
+	WBLatencySummary submitToPresent;      // Time spent in Present, every frame
+};
+
+/// <summary>
+/// Attributes input events to the frame that consumed them and keeps per-frame timestamps.
+/// Inputs received before BeginFrame are consumed by that frame; inputs received during a frame
+/// wait for the next one unless a late latch picks them up. All calls come from the render thread.
+/// </summary>
+class WBLatencyTracker {
+public:
+	using Clock = std::function<uint64_t()>;
+
+	/// <param name="clock">Time source in nanoseconds.</param>
+	/// <param name="window">Number of recent frames the distributions are computed over.</param>
+	explicit WBLatencyTracker(Clock clock = WBSteadyNowNs, size_t window = 1024)
+		: clock(std::move(clock)), window(std::max<size_t>(1, window)) {}
+
+	uint64_t Now() const { return clock(); }
+
+	/// <summary>
+	/// Records an input event received now.
+	/// </summary>
+	void InputReceived() {
+		InputReceived(clock());
+	}
+
+	/// <summary>
+	/// Records an input event with a known event time, e.g. the message time converted with WBEventTimeNs.
+	/// </summary>
+	void InputReceived(uint64_t time) {
+		if (pendingCount == 0 || time < pendingOldest)
+			pendingOldest = time;
+		pendingNewest = std::max(pendingNewest, time);
+		++pendingCount;
+	}
+
+	/// <summary>
+	/// Starts a frame: stamps the simulation start and consumes the pending input.
+	/// </summary>
+	void BeginFrame() {
+		current = {};
+		current.frame = nextFrame++;
+		current.simulation = clock();
+		Consume();
+		inFrame = true;
+	}
+
+	/// <summary>
+	/// Stamps a late latch: input received since BeginFrame is consumed by this frame as well.
+	/// </summary>
+	void LateLatch() {
+		if (!inFrame)
+			return;
+		current.latch = clock();
+		Consume();
+	}
+
+	void Submit() {
+		if (inFrame)
+			current.submit = clock();
+	}
+
+	/// <summary>
+	/// Stamps the present and records the frame into the distributions.
+	/// </summary>
+	void Present() {
+		if (!inFrame)
+			return;
+		current.present = clock();
+		if (!current.submit)
+			current.submit = current.present;
+		inFrame = false;
+		last = current;
+
+		if (samples.size() < window)
+			samples.push_back(current);
+		else
+			samples[next] = current;
+		next = (next + 1) % window;
+		++frames;
+		if (current.inputCount)
+			++framesWithInput;
+	}
+
+	/// <summary>
+	/// Gets the timestamps of the last presented frame.
+	/// </summary>
+	const WBFrameTiming& GetLastFrame() const { return last; }
+
+	/// <summary>
+	/// Computes the latency distributions over the sample window.
+	/// </summary>
+	WBLatencyStats GetStats() const {
+		WBLatencyStats stats;
+		stats.frames = frames;
+		stats.framesWithInput = framesWithInput;
+		stats.oldestInputToPresent = Summarize([](const WBFrameTiming& f) { return f.inputCount ? f.present - f.oldestInput : UINT64_MAX; });
+		stats.newestInputToPresent = Summarize([](const WBFrameTiming& f) { return f.inputCount ? f.present - f.newestInput : UINT64_MAX; });
+		stats.simulationToPresent = Summarize([](const WBFrameTiming& f) { return f.present - f.simulation; });
+		stats.submitToPresent = Summarize([](const WBFrameTiming& f) { return f.present - f.submit; });
+		return stats;
+	}
+
+private:
+	void Consume() {
+		if (pendingCount == 0)
+			return;
+		if (current.inputCount == 0 || pendingOldest < current.oldestInput)
+			current.oldestInput = pendingOldest;
+		current.newestInput = std::max(current.newestInput, pendingNewest);
+		current.inputCount += pendingCount;
+		pendingCount = 0;
+		pendingOldest = pendingNewest = 0;
+	}
+
+	// Samples returning UINT64_MAX are skipped
+	template<typename Latency>
+	WBLatencySummary Summarize(Latency latency) const {
+		WBLatencySummary summary;
+		scratch.clear();
+		for (const WBFrameTiming& frame : samples) {
+			uint64_t value = latency(frame);
+			if (value != UINT64_MAX)
+				scratch.push_back(value);
+		}
+		if (scratch.empty())
+			return summary;
+
+		std::sort(scratch.begin(), scratch.end());
+		auto ms = [](uint64_t ns) { return ns / 1e6; };
+		auto percentile = [&](double p) { return ms(scratch[std::min(scratch.size() - 1, static_cast<size_t>(p * scratch.size()))]); };
+		double sum = 0.0;
+		for (uint64_t value : scratch)
+			sum += value;
+		summary.count = scratch.size();
+		summary.mean = ms(static_cast<uint64_t>(sum / scratch.size()));
+		summary.p50 = percentile(0.50);
+		summary.p90 = percentile(0.90);
+		summary.p99 = percentile(0.99);
+		summary.max = ms(scratch.back());
+		return summary;
+	}
+
+	Clock clock;
+	size_t window;
+
+	uint32_t pendingCount = 0;
+	uint64_t pendingOldest = 0;
+	uint64_t pendingNewest = 0;
+
+	bool inFrame = false;
+	uint64_t nextFrame = 0;
+	WBFrameTiming current;
+	WBFrameTiming last;
+
+	std::vector<WBFrameTiming> samples;
+	size_t next = 0;
+	uint64_t frames = 0;
+	uint64_t framesWithInput = 0;
+	mutable std::vector<uint64_t> scratch;
+};
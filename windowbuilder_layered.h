@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "windowbuilder_simd.h"
+
+// Platform independent pixel conversion for per-pixel alpha windows: RGBA8 frames into the
+// premultiplied BGRA8 that UpdateLayeredWindow expects. The kernels compare against the
+// previous contents of the destination while writing, so unchanged rows cost no upload.
+
+/// <summary>
+/// How the alpha channel of a rendered frame relates to its color.
+/// </summary>
+enum class WBLayeredAlpha {
+	Premultiplied, // Color already multiplied by alpha, what blending over a transparent clear produces
+	Straight       // Color independent of alpha, premultiplied during the conversion
+};
+
+/// <summary>
+/// A range of rows, [first, last). Empty when first == last.
+/// </summary>
+struct WBDirtyRows {
+	int first = 0;
+	int last = 0;
+
+	bool Empty() const { return first == last; }
+};
+
+/// <summary>
+/// Totals of a per-pixel alpha window since it was created.
+/// </summary>
+struct WBLayeredStats {
+	uint64_t frames = 0;        // Frames converted
+	uint64_t framesSkipped = 0; // Frames identical to the previous one, not handed to the window
+	uint64_t rowsConverted = 0;
+	uint64_t rowsUploaded = 0;  // Rows inside the dirty rectangles passed to UpdateLayeredWindowIndirect
+};
+
+/// <summary>
+/// Scalar reference for WBRGBAToBGRARow.
+/// </summary>
+inline bool WBRGBAToBGRARowScalar(const uint8_t* rgba, uint8_t* bgra, size_t pixels, bool premultiply) {
+	bool changed = false;
+	for (size_t i = 0; i < pixels; ++i, rgba += 4, bgra += 4) {
+		uint8_t a = rgba[3];
+		uint8_t b = premultiply ? static_cast<uint8_t>(WBDiv255(rgba[2] * a)) : rgba[2];
+		uint8_t g = premultiply ? static_cast<uint8_t>(WBDiv255(rgba[1] * a)) : rgba[1];
+		uint8_t r = premultiply ? static_cast<uint8_t>(WBDiv255(rgba[0] * a)) : rgba[0];
+		changed |= bgra[0] != b || bgra[1] != g || bgra[2] != r || bgra[3] != a;
+		bgra[0] = b;
+		bgra[1] = g;
+		bgra[2] = r;
+		bgra[3] = a;
+	}
+	return changed;
+}
+
+/// <summary>
+/// Converts one row of RGBA8 into BGRA8, premultiplying the color by alpha if asked to.
+/// Uses AVX2 or SSE2 when available, bit-exact with WBRGBAToBGRARowScalar.
+/// </summary>
+/// <returns>True if the destination row changed.</returns>
+inline bool WBRGBAToBGRARow(const uint8_t* rgba, uint8_t* bgra, size_t pixels, bool premultiply) {
+#if WB_HAS_SSE2
+	struct Kernels {
+		// Swaps R and B in every 32-bit pixel
+		static __m128i Swizzle(__m128i v) {
+			const __m128i ga = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+			const __m128i low = _mm_set1_epi32(0xFF);
+			return _mm_or_si128(_mm_and_si128(v, ga),
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low), _mm_slli_epi32(_mm_and_si128(v, low), 16)));
+		}
+
+		// Premultiplies two BGRA pixels widened to 16 bits; alpha is multiplied by 255 so it stays exact
+		static __m128i Premultiply16(__m128i v) {
+			__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128i alphaLane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+			alpha = _mm_or_si128(_mm_andnot_si128(alphaLane, alpha), _mm_and_si128(alphaLane, _mm_set1_epi16(255)));
+			__m128i x = _mm_add_epi16(_mm_mullo_epi16(v, alpha), _mm_set1_epi16(128));
+			return _mm_mulhi_epu16(x, _mm_set1_epi16(257)); // (x + (x >> 8)) >> 8
+		}
+
+		static bool SSE2(const uint8_t* rgba, uint8_t* bgra, size_t pixels, bool premultiply) {
+			const __m128i zero = _mm_setzero_si128();
+			__m128i same = _mm_set1_epi8(-1);
+			size_t i = 0;
+			for (; i + 4 <= pixels; i += 4) {
+				__m128i v = Swizzle(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4)));
+				if (premultiply)
+					v = _mm_packus_epi16(Premultiply16(_mm_unpacklo_epi8(v, zero)), Premultiply16(_mm_unpackhi_epi8(v, zero)));
+				__m128i* out = reinterpret_cast<__m128i*>(bgra + i * 4);
+				same = _mm_and_si128(same, _mm_cmpeq_epi8(v, _mm_loadu_si128(out)));
+				_mm_storeu_si128(out, v);
+			}
+			bool changed = _mm_movemask_epi8(same) != 0xFFFF;
+			return WBRGBAToBGRARowScalar(rgba + i * 4, bgra + i * 4, pixels - i, premultiply) || changed;
+		}
+
+		WB_TARGET_AVX2 static bool AVX2(const uint8_t* rgba, uint8_t* bgra, size_t pixels, bool premultiply) {
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i ga = _mm256_set1_epi32(static_cast<int>(0xFF00FF00));
+			const __m256i low = _mm256_set1_epi32(0xFF);
+			const __m256i alphaLane = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+			const __m256i opaque = _mm256_set1_epi16(255);
+			const __m256i round = _mm256_set1_epi16(128);
+			const __m256i div = _mm256_set1_epi16(257);
+			auto premultiply16 = [&](__m256i w) WB_TARGET_AVX2 {
+				__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(w, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				alpha = _mm256_blendv_epi8(alpha, opaque, alphaLane);
+				return _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_mullo_epi16(w, alpha), round), div);
+			};
+
+			__m256i same = _mm256_set1_epi8(-1);
+			size_t i = 0;
+			for (; i + 8 <= pixels; i += 8) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+				v = _mm256_or_si256(_mm256_and_si256(v, ga),
+					_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 16), low), _mm256_slli_epi32(_mm256_and_si256(v, low), 16)));
+				// unpack and pack both work within 128-bit lanes, so pixel order is preserved
+				if (premultiply)
+					v = _mm256_packus_epi16(premultiply16(_mm256_unpacklo_epi8(v, zero)), premultiply16(_mm256_unpackhi_epi8(v, zero)));
+				__m256i* out = reinterpret_cast<__m256i*>(bgra + i * 4);
+				same = _mm256_and_si256(same, _mm256_cmpeq_epi8(v, _mm256_loadu_si256(out)));
+				_mm256_storeu_si256(out, v);
+			}
+			bool changed = static_cast<uint32_t>(_mm256_movemask_epi8(same)) != 0xFFFFFFFFu;
+			return SSE2(rgba + i * 4, bgra + i * 4, pixels - i, premultiply) || changed;
+		}
+	};
+
+	if (WBCpuHasAVX2())
+		return Kernels::AVX2(rgba, bgra, pixels, premultiply);
+	return Kernels::SSE2(rgba, bgra, pixels, premultiply);
+#else
+	return WBRGBAToBGRARowScalar(rgba, bgra, pixels, premultiply);
+#endif
+}
+
+/// <summary>
+/// Converts a whole frame with WBRGBAToBGRARow.
+/// </summary>
+/// <returns>The rows whose destination changed, first to last changed row.</returns>
+inline WBDirtyRows WBRGBAToBGRAFrame(const uint8_t* rgba, size_t srcPitch, uint8_t* bgra, size_t dstPitch,
+	int width, int height, WBLayeredAlpha alpha) {
+	WBDirtyRows dirty;
+	const bool premultiply = alpha == WBLayeredAlpha::Straight;
+	for (int y = 0; y < height; ++y) {
+		if (WBRGBAToBGRARow(rgba + y * srcPitch, bgra + y * dstPitch, static_cast<size_t>(width), premultiply)) {
+			if (dirty.Empty())
+				dirty.first = y;
+			dirty.last = y + 1;
+		}
+	}
+	return dirty;
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// Platform independent bookkeeping for retained render layers: which layers must be redrawn,
+// their size at a reduced resolution, the order they are composited in and what they cost.
+// windowbuilder.h owns the layer textures and does the drawing and compositing.
+
+/// <summary>
+/// How a layer is composited and at what resolution it is rendered.
+/// </summary>
+struct WBLayerDesc {
+	const char* name = nullptr;  // For lookups and stats, optional
+	int z = 0;                   // Composited back to front by z; equal z in creation order
+	float opacity = 1.0f;        // 0 hides the layer without dropping its contents
+	float scale = 1.0f;          // Resolution relative to the window, (0, 1]
+	// With dynamic resolution, composited over the upscaled scene instead of into it. Such a layer
+	// then ends up above onRender, the scaling plugins and every layer without the flag, whatever
+	// their z; z only orders it among the other full resolution layers. Without dynamic resolution
+	// the flag has no effect and z alone decides.
+	bool fullResolution = false;
+};
+
+/// <summary>
+/// Counters of one layer since it was created.
+/// </summary>
+struct WBLayerStats {
+	const char* name = nullptr;
+	int width = 0;
+	int height = 0;
+	uint64_t redraws = 0;
+	uint64_t composites = 0;
+	double lastRedrawMs = 0.0;      // CPU time of the last redraw
+	double totalRedrawMs = 0.0;
+	double lastCompositeMs = 0.0;   // CPU time of the last composite draw
+	uint64_t compositedPixels = 0;  // Pixels written by composite passes
+};
+
+/// <summary>
+/// Tracks retained layers. Layers start dirty and become dirty again when marked or when the
+/// window resize changes their pixel size; a frame redraws only the dirty, visible ones and then
+/// composites every visible layer in z order. With dynamic resolution the window composites in
+/// two passes, into the scaled scene and then over the upscaled one, so z orders layers within a
+/// pass and every fullResolution layer lands above every other one (see WBLayerDesc).
+/// </summary>
+class WBLayerStack {
+public:
+	using Id = uint32_t;
+	static constexpr Id invalid = 0;
+
+	/// <summary>
+	/// Adds a layer, dirty so it is drawn in the next frame.
+	/// </summary>
+	Id Add(const WBLayerDesc& desc) {
+		Layer layer;
+		layer.id = nextId++;
+		layer.desc = desc;
+		layer.desc.scale = ClampScale(desc.scale);
+		layer.stats.name = desc.name;
+		Size(layer);
+		layers.push_back(layer);
+		orderDirty = true;
+		return layer.id;
+	}
+
+	bool Remove(Id id) {
+		auto it = std::find_if(layers.begin(), layers.end(), [id](const Layer& layer) { return layer.id == id; });
+		if (it == layers.end())
+			return false;
+		layers.erase(it);
+		orderDirty = true;
+		return true;
+	}
+
+	bool Contains(Id id) const { return Get(id) != nullptr; }
+	size_t Count() const { return layers.size(); }
+
+	/// <summary>
+	/// Finds a layer by the name it was created with.
+	/// </summary>
+	/// <returns>The layer, or invalid.</returns>
+	Id Find(const char* name) const {
+		for (const Layer& layer : layers)
+			if (name && layer.desc.name && strcmp(layer.desc.name, name) == 0)
+				return layer.id;
+		return invalid;
+	}
+
+	void MarkDirty(Id id) {
+		if (Layer* layer = Get(id))
+			layer->dirty = true;
+	}
+
+	void MarkAllDirty() {
+		for (Layer& layer : layers)
+			layer.dirty = true;
+	}
+
+	bool IsDirty(Id id) const {
+		const Layer* layer = Get(id);
+		return layer && layer->dirty;
+	}
+
+	void SetZ(Id id, int z) {
+		Layer* layer = Get(id);
+		if (layer && layer->desc.z != z) {
+			layer->desc.z = z;
+			orderDirty = true;
+		}
+	}
+
+	/// <summary>
+	/// Changes how strongly the layer is blended in. Does not redraw it.
+	/// </summary>
+	void SetOpacity(Id id, float opacity) {
+		Layer* layer = Get(id);
+		if (layer && layer->desc.opacity != opacity) {
+			layer->desc.opacity = opacity;
+			orderDirty = true;
+		}
+	}
+
+	void SetScale(Id id, float scale) {
+		Layer* layer = Get(id);
+		if (layer && layer->desc.scale != ClampScale(scale)) {
+			layer->desc.scale = ClampScale(scale);
+			Size(*layer);
+		}
+	}
+
+	const WBLayerDesc* GetDesc(Id id) const {
+		const Layer* layer = Get(id);
+		return layer ? &layer->desc : nullptr;
+	}
+
+	/// <summary>
+	/// Sets the window size. Layers whose pixel size changes become dirty.
+	/// </summary>
+	void Resize(int width, int height) {
+		if (width == windowWidth && height == windowHeight)
+			return;
+		windowWidth = width;
+		windowHeight = height;
+		for (Layer& layer : layers)
+			Size(layer);
+	}
+
+	/// <summary>
+	/// Gets the size a layer is rendered at.
+	/// </summary>
+	bool GetSize(Id id, int& width, int& height) const {
+		const Layer* layer = Get(id);
+		if (!layer)
+			return false;
+		width = layer->stats.width;
+		height = layer->stats.height;
+		return true;
+	}
+
+	/// <summary>
+	/// Takes the visible dirty layers, back to front, and clears their dirty flag. A layer marked
+	/// dirty while it is being redrawn is redrawn again next frame, so a caller that could not
+	/// redraw one marks it dirty again. Hidden layers stay dirty.
+	/// </summary>
+	const std::vector<Id>& CollectDirty() {
+		dirtyScratch.clear();
+		for (Id id : CompositeOrder()) {
+			Layer* layer = Get(id);
+			if (layer->dirty) {
+				layer->dirty = false;
+				dirtyScratch.push_back(id);
+			}
+		}
+		return dirtyScratch;
+	}
+
+	/// <summary>
+	/// Records a finished redraw.
+	/// </summary>
+	void Redrawn(Id id, double ms) {
+		if (Layer* layer = Get(id)) {
+			++layer->stats.redraws;
+			layer->stats.lastRedrawMs = ms;
+			layer->stats.totalRedrawMs += ms;
+		}
+	}
+
+	/// <summary>
+	/// Visible layers (opacity above 0) back to front.
+	/// </summary>
+	const std::vector<Id>& CompositeOrder() {
+		if (orderDirty) {
+			std::sort(layers.begin(), layers.end(), [](const Layer& a, const Layer& b) {
+				return a.desc.z != b.desc.z ? a.desc.z < b.desc.z : a.id < b.id;
+			});
+			order.clear();
+			for (const Layer& layer : layers)
+				if (layer.desc.opacity > 0.0f)
+					order.push_back(layer.id);
+			orderDirty = false;
+		}
+		return order;
+	}
+
+	/// <summary>
+	/// Records a composite draw of a layer over a whole render target of the given size: the
+	/// window, or the scaled scene with dynamic resolution.
+	/// </summary>
+	void Composited(Id id, double ms, int targetWidth, int targetHeight) {
+		if (Layer* layer = Get(id)) {
+			++layer->stats.composites;
+			layer->stats.lastCompositeMs = ms;
+			layer->stats.compositedPixels += static_cast<uint64_t>(std::max(targetWidth, 0)) * static_cast<uint64_t>(std::max(targetHeight, 0));
+		}
+	}
+
+	WBLayerStats GetStats(Id id) const {
+		const Layer* layer = Get(id);
+		return layer ? layer->stats : WBLayerStats();
+	}
+
+	/// <summary>
+	/// Stats of every layer, back to front.
+	/// </summary>
+	std::vector<WBLayerStats> GetAllStats() {
+		CompositeOrder();
+		std::vector<WBLayerStats> all;
+		for (const Layer& layer : layers)
+			all.push_back(layer.stats);
+		return all;
+	}
+
+private:
+	struct Layer {
+		Id id = invalid;
+		WBLayerDesc desc;
+		bool dirty = true;
+		WBLayerStats stats;
+	};
+
+	static float ClampScale(float scale) {
+		return std::min(1.0f, std::max(scale, 1.0f / 64.0f));
+	}
+
+	Layer* Get(Id id) {
+		for (Layer& layer : layers)
+			if (layer.id == id)
+				return &layer;
+		return nullptr;
+	}
+
+	const Layer* Get(Id id) const {
+		return const_cast<WBLayerStack*>(this)->Get(id);
+	}
+
+	void Size(Layer& layer) {
+		int width = std::max(1, static_cast<int>(std::lround(windowWidth * layer.desc.scale)));
+		int height = std::max(1, static_cast<int>(std::lround(windowHeight * layer.desc.scale)));
+		if (width != layer.stats.width || height != layer.stats.height) {
+			layer.stats.width = width;
+			layer.stats.height = height;
+			layer.dirty = true;
+		}
+	}
+
+	std::vector<Layer> layers;
+	std::vector<Id> order;
+	std::vector<Id> dirtyScratch;
+	bool orderDirty = false;
+	Id nextId = 1;
+	int windowWidth = 1;
+	int windowHeight = 1;
+};
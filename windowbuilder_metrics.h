@@ -0,0 +1,642 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+// Runtime counters of a window and an exporter that serves them in the Prometheus text format.
+// The render thread only does relaxed atomic adds and stores, which are wait-free; everything
+// else (formatting, quantiles, sockets) runs on the exporter's threads and reads the atomics
+// without ever taking a lock the render thread could be waiting on.
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Metrics need lock-free 64-bit atomics");
+
+/// <summary>
+/// Monotonic counter, written by one or more threads with relaxed adds.
+/// </summary>
+class WBMetricCounter {
+public:
+	void Add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t Load() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value = 0;
+};
+
+/// <summary>
+/// Last-value gauge.
+/// </summary>
+class WBMetricGauge {
+public:
+	void Set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+	int64_t Load() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> value = 0;
+};
+
+/// <summary>
+/// Frame time histogram with four log-spaced buckets per octave, from 0.25 ms to about 860 ms,
+/// plus an overflow bucket. Recording is a binary search and two relaxed adds.
+/// </summary>
+class WBFrameTimeHistogram {
+public:
+	static constexpr size_t bucketCount = 48; // Finite buckets, the overflow bucket comes after them
+
+	struct Snapshot {
+		std::array<uint64_t, bucketCount + 1> buckets = {}; // Per bucket, not cumulative
+		uint64_t count = 0;
+		uint64_t sumNs = 0;
+
+		/// <summary>
+		/// Estimates a quantile by interpolating inside the bucket it falls in.
+		/// </summary>
+		/// <returns>Milliseconds, or NaN without samples.</returns>
+		double Quantile(double q) const {
+			if (count == 0)
+				return std::nan("");
+			double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(count);
+			uint64_t below = 0;
+			for (size_t i = 0; i <= bucketCount; ++i) {
+				if (buckets[i] == 0 || static_cast<double>(below + buckets[i]) < rank) {
+					below += buckets[i];
+					continue;
+				}
+				double lower = i == 0 ? 0.0 : UpperBoundMs(i - 1);
+				if (i == bucketCount)
+					return lower;
+				double fraction = (rank - static_cast<double>(below)) / static_cast<double>(buckets[i]);
+				return lower + (UpperBoundMs(i) - lower) * fraction;
+			}
+			return UpperBoundMs(bucketCount - 1);
+		}
+
+		/// <summary>
+		/// Samples recorded after an earlier snapshot.
+		/// </summary>
+		Snapshot Since(const Snapshot& earlier) const {
+			Snapshot delta;
+			for (size_t i = 0; i <= bucketCount; ++i)
+				delta.buckets[i] = buckets[i] - earlier.buckets[i];
+			delta.count = count - earlier.count;
+			delta.sumNs = sumNs - earlier.sumNs;
+			return delta;
+		}
+	};
+
+	/// <summary>
+	/// Upper bound of a finite bucket: 0.25 ms * 2^(index / 4).
+	/// </summary>
+	static double UpperBoundMs(size_t index) {
+		return Bounds()[index] / 1e6;
+	}
+
+	void Record(uint64_t ns) {
+		const std::array<uint64_t, bucketCount>& bounds = Bounds();
+		size_t index = static_cast<size_t>(std::lower_bound(bounds.begin(), bounds.end(), ns) - bounds.begin());
+		buckets[index].fetch_add(1, std::memory_order_relaxed);
+		sumNs.fetch_add(ns, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Reads the buckets. The count is their total, so the snapshot is self-consistent even while
+	/// frames are being recorded; the sum may be one sample ahead or behind.
+	/// </summary>
+	Snapshot Load() const {
+		Snapshot snapshot;
+		for (size_t i = 0; i <= bucketCount; ++i) {
+			snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+			snapshot.count += snapshot.buckets[i];
+		}
+		snapshot.sumNs = sumNs.load(std::memory_order_relaxed);
+		return snapshot;
+	}
+
+private:
+	static const std::array<uint64_t, bucketCount>& Bounds() {
+		static const std::array<uint64_t, bucketCount> bounds = [] {
+			std::array<uint64_t, bucketCount> result = {};
+			for (size_t i = 0; i < bucketCount; ++i)
+				result[i] = static_cast<uint64_t>(std::llround(250000.0 * std::exp2(i / 4.0)));
+			return result;
+		}();
+		return bounds;
+	}
+
+	std::array<std::atomic<uint64_t>, bucketCount + 1> buckets = {};
+	std::atomic<uint64_t> sumNs = 0;
+};
+
+/// <summary>
+/// Appends metric families in the Prometheus text exposition format (version 0.0.4).
+/// </summary>
+class WBPrometheusWriter {
+public:
+	explicit WBPrometheusWriter(std::string& out) : out(out) {}
+
+	/// <summary>
+	/// Starts a metric family. Call once before its samples.
+	/// </summary>
+	/// <param name="type">counter, gauge or histogram</param>
+	void Family(const char* name, const char* type, const char* help) {
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		out += help;
+		out += "\n# TYPE ";
+		out += name;
+		out += ' ';
+		out += type;
+		out += '\n';
+	}
+
+	/// <summary>
+	/// Writes one sample. labels is the inside of the braces, e.g. quantile="0.5", or nullptr.
+	/// </summary>
+	void Sample(const char* name, double value, const char* labels = nullptr) {
+		out += name;
+		if (labels) {
+			out += '{';
+			out += labels;
+			out += '}';
+		}
+		out += ' ';
+		AppendNumber(value);
+		out += '\n';
+	}
+
+	void Sample(const char* name, uint64_t value, const char* labels = nullptr) {
+		char digits[24];
+		snprintf(digits, sizeof(digits), " %llu\n", static_cast<unsigned long long>(value));
+		out += name;
+		if (labels) {
+			out += '{';
+			out += labels;
+			out += '}';
+		}
+		out += digits;
+	}
+
+	void Counter(const char* name, const char* help, uint64_t value) {
+		Family(name, "counter", help);
+		Sample(name, value);
+	}
+
+	void Gauge(const char* name, const char* help, double value) {
+		Family(name, "gauge", help);
+		Sample(name, value);
+	}
+
+	/// <summary>
+	/// Writes a histogram in seconds: cumulative _bucket samples, _sum and _count.
+	/// </summary>
+	void Histogram(const char* name, const char* help, const WBFrameTimeHistogram::Snapshot& snapshot) {
+		Family(name, "histogram", help);
+		std::string series(name);
+		const std::string bucket = series + "_bucket";
+		uint64_t cumulative = 0;
+		char label[48];
+		for (size_t i = 0; i < WBFrameTimeHistogram::bucketCount; ++i) {
+			cumulative += snapshot.buckets[i];
+			snprintf(label, sizeof(label), "le=\"%.9g\"", WBFrameTimeHistogram::UpperBoundMs(i) / 1000.0);
+			Sample(bucket.c_str(), cumulative, label);
+		}
+		Sample(bucket.c_str(), snapshot.count, "le=\"+Inf\"");
+		Sample((series + "_sum").c_str(), static_cast<double>(snapshot.sumNs) / 1e9);
+		Sample((series + "_count").c_str(), snapshot.count);
+	}
+
+private:
+	void AppendNumber(double value) {
+		if (std::isnan(value)) {
+			out += "NaN";
+			return;
+		}
+		if (std::isinf(value)) {
+			out += value > 0 ? "+Inf" : "-Inf";
+			return;
+		}
+		char digits[32];
+		snprintf(digits, sizeof(digits), "%.9g", value);
+		out += digits;
+	}
+
+	std::string& out;
+};
+
+/// <summary>
+/// Runtime counters of a window. The render thread updates them through the methods below, the
+/// exporter reads them with Write().
+/// </summary>
+struct WBMetrics {
+	WBMetricCounter framesRendered;   // Frames that went through the render loop
+	WBMetricCounter framesSkipped;    // Rendered frames that did not reach the screen (occluded, unchanged)
+	WBMetricCounter presents;         // Frames shown
+	WBMetricCounter resizes;
+	WBMetricCounter messages;         // Window messages dispatched by Show()
+	WBMetricGauge texturesResident;   // Texture cache
+	WBMetricGauge textureBytesResident;
+	WBMetricGauge renderLayers;
+	WBFrameTimeHistogram frameTime;   // Time between the ends of consecutive frames
+
+	// Read at scrape time on the exporter thread, e.g. the process-wide tracker counters
+	std::function<void(WBPrometheusWriter&)> collectExtra;
+
+	/// <summary>
+	/// Counts a finished frame and records the time since the previous one. Render thread only.
+	/// </summary>
+	/// <param name="presented">False if the frame did not reach the screen</param>
+	void FrameFinished(bool presented) {
+		auto now = std::chrono::steady_clock::now();
+		if (lastFrame != std::chrono::steady_clock::time_point())
+			frameTime.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastFrame).count()));
+		lastFrame = now;
+		framesRendered.Add();
+		if (presented)
+			presents.Add();
+		else
+			framesSkipped.Add();
+	}
+
+	/// <summary>
+	/// Writes every metric. Frame time quantiles cover the frames since the previous Write, so
+	/// they follow what the overlay is doing now rather than since it started. Exporter side,
+	/// one call at a time.
+	/// </summary>
+	void Write(WBPrometheusWriter& out) {
+		out.Counter("wb_frames_rendered_total", "Frames that went through the render loop.", framesRendered.Load());
+		out.Counter("wb_frames_skipped_total", "Rendered frames that did not reach the screen.", framesSkipped.Load());
+		out.Counter("wb_presents_total", "Frames shown.", presents.Load());
+		out.Counter("wb_resizes_total", "WM_SIZE messages received.", resizes.Load());
+		out.Counter("wb_messages_total", "Window messages dispatched by the message loop.", messages.Load());
+		out.Gauge("wb_textures_resident", "Textures resident in the texture cache.", static_cast<double>(texturesResident.Load()));
+		out.Gauge("wb_texture_bytes_resident", "GPU bytes held by the texture cache.", static_cast<double>(textureBytesResident.Load()));
+		out.Gauge("wb_render_layers", "Retained render layers, one texture each.", static_cast<double>(renderLayers.Load()));
+
+		WBFrameTimeHistogram::Snapshot frames = frameTime.Load();
+		out.Histogram("wb_frame_time_seconds", "Time between consecutive frames.", frames);
+
+		WBFrameTimeHistogram::Snapshot recent = frames.Since(previousFrames);
+		previousFrames = frames;
+		out.Family("wb_frame_time_recent_seconds", "gauge", "Frame time quantiles since the previous scrape.");
+		for (double quantile : { 0.5, 0.9, 0.99 }) {
+			char label[24];
+			snprintf(label, sizeof(label), "quantile=\"%g\"", quantile);
+			out.Sample("wb_frame_time_recent_seconds", recent.Quantile(quantile) / 1000.0, label);
+		}
+
+		if (collectExtra)
+			collectExtra(out);
+	}
+
+private:
+	std::chrono::steady_clock::time_point lastFrame;
+	WBFrameTimeHistogram::Snapshot previousFrames;
+};
+
+/// <summary>
+/// Serves text produced by a callback to local clients: plain HTTP on a loopback TCP port
+/// (GET /metrics) and/or a local pipe, a named pipe on Windows and a Unix domain socket elsewhere,
+/// which hands every connection the text and closes it. Each listener has its own thread, and a
+/// scrape only ever waits on other scrapes. A client that stops reading is dropped after
+/// ioTimeoutMs, and Stop() drops the clients being served at once.
+/// </summary>
+class WBMetricsExporter {
+public:
+	using Collect = std::function<void(std::string&)>;
+
+	static constexpr int ioTimeoutMs = 1000; // Per blocking send or receive of a client
+
+	explicit WBMetricsExporter(Collect collect) : collect(std::move(collect)) {}
+	WBMetricsExporter(const WBMetricsExporter&) = delete;
+	WBMetricsExporter& operator=(const WBMetricsExporter&) = delete;
+
+	~WBMetricsExporter() {
+		Stop();
+	}
+
+	/// <summary>
+	/// Listens on 127.0.0.1. Port 0 takes any free port, see Port().
+	/// </summary>
+	/// <returns>False if the port could not be bound.</returns>
+	bool ListenTcp(uint16_t port) {
+		if (!StartupSockets())
+			return false;
+		Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+		if (listener == invalidSocket)
+			return false;
+		int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		socklen_t length = sizeof(address);
+		if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0
+			|| getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+			CloseSocket(listener);
+			return false;
+		}
+		tcpPort = ntohs(address.sin_port);
+		tcpListener = listener;
+		tcpThread = std::thread(&WBMetricsExporter::ServeSocket, this, listener, true);
+		return true;
+	}
+
+	/// <summary>
+	/// Listens on \\.\pipe\name on Windows, or on a Unix domain socket at the path name elsewhere.
+	/// </summary>
+	/// <returns>False if the pipe could not be created.</returns>
+	bool ListenPipe(const std::string& name) {
+#ifdef _WIN32
+		pipeName = "\\\\.\\pipe\\" + name;
+		HANDLE first = CreatePipeInstance();
+		if (first == INVALID_HANDLE_VALUE)
+			return false;
+		stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (!stopEvent) {
+			CloseHandle(first);
+			return false;
+		}
+		pipeThread = std::thread(&WBMetricsExporter::ServePipe, this, first);
+		return true;
+#else
+		sockaddr_un address = {};
+		if (name.size() >= sizeof(address.sun_path))
+			return false;
+		Socket listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener == invalidSocket)
+			return false;
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, name.c_str(), name.size() + 1);
+		unlink(name.c_str());
+		if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0) {
+			CloseSocket(listener);
+			return false;
+		}
+		pipeName = name;
+		pipeListener = listener;
+		pipeThread = std::thread(&WBMetricsExporter::ServeSocket, this, listener, false);
+		return true;
+#endif
+	}
+
+	/// <summary>
+	/// Stops listening and joins the threads. Clients being served are disconnected.
+	/// </summary>
+	void Stop() {
+		stopping = true;
+		{
+			// Wakes a thread blocked sending to a client that does not read
+			std::lock_guard<std::mutex> lock(clientMutex);
+			for (Socket client : clients)
+				if (client != invalidSocket)
+					shutdown(client, shutdownBoth);
+		}
+		if (tcpThread.joinable()) {
+			WakeAndJoin(tcpListener, tcpThread);
+			tcpListener = invalidSocket;
+		}
+		if (pipeThread.joinable()) {
+#ifdef _WIN32
+			SetEvent(stopEvent); // Wakes the pipe thread out of a pending connect or write
+			pipeThread.join();
+			CloseHandle(stopEvent);
+			stopEvent = nullptr;
+#else
+			WakeAndJoin(pipeListener, pipeThread);
+			pipeListener = invalidSocket;
+			unlink(pipeName.c_str());
+#endif
+		}
+		stopping = false;
+	}
+
+	/// <summary>
+	/// Gets the bound TCP port, or 0 when not listening.
+	/// </summary>
+	uint16_t Port() const { return tcpPort; }
+
+	/// <summary>
+	/// Number of times the text was served.
+	/// </summary>
+	uint64_t Scrapes() const { return scrapes.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Produces the text the way a scrape does.
+	/// </summary>
+	std::string Render() {
+		std::string text;
+		std::lock_guard<std::mutex> lock(collectMutex);
+		collect(text);
+		scrapes.fetch_add(1, std::memory_order_relaxed);
+		return text;
+	}
+
+private:
+#ifdef _WIN32
+	using Socket = SOCKET;
+	static constexpr Socket invalidSocket = INVALID_SOCKET;
+	static constexpr int shutdownBoth = SD_BOTH;
+	static void CloseSocket(Socket s) { closesocket(s); }
+	static bool StartupSockets() {
+		static const bool started = [] {
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return started;
+	}
+#else
+	using Socket = int;
+	static constexpr Socket invalidSocket = -1;
+	static constexpr int shutdownBoth = SHUT_RDWR;
+	static void CloseSocket(Socket s) { close(s); }
+	static bool StartupSockets() { return true; }
+#endif
+
+	// A blocked accept returns when its socket is closed (Windows) or shut down (POSIX, where
+	// closing it under another thread could hand the descriptor number to someone else)
+	static void WakeAndJoin(Socket listener, std::thread& thread) {
+#ifdef _WIN32
+		CloseSocket(listener);
+		thread.join();
+#else
+		shutdown(listener, SHUT_RDWR);
+		thread.join();
+		CloseSocket(listener);
+#endif
+	}
+
+	void ServeSocket(Socket listener, bool http) {
+		while (!stopping) {
+			Socket client = accept(listener, nullptr, nullptr);
+			if (client == invalidSocket) {
+				if (!stopping)
+					std::this_thread::sleep_for(std::chrono::milliseconds(10)); // e.g. out of descriptors
+				continue;
+			}
+			SetTimeouts(client);
+			if (Serving(http, client)) {
+				if (http)
+					ServeHttp(client);
+				else
+					SendAll(client, Render());
+			}
+			Serving(http, invalidSocket);
+			CloseSocket(client);
+		}
+	}
+
+	// Publishes the client a listener thread is serving so Stop() can shut it down. Returns false
+	// once stopping, so a client accepted after Stop() looked is not served at all.
+	bool Serving(bool http, Socket client) {
+		std::lock_guard<std::mutex> lock(clientMutex);
+		clients[http ? 0 : 1] = client;
+		return !stopping;
+	}
+
+	// A client that never finishes its request or never reads the answer times out
+	static void SetTimeouts(Socket client) {
+#ifdef _WIN32
+		DWORD timeout = ioTimeoutMs;
+#else
+		timeval timeout = { ioTimeoutMs / 1000, (ioTimeoutMs % 1000) * 1000 };
+#endif
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+
+	// One request per connection
+	void ServeHttp(Socket client) {
+		char request[2048];
+		size_t used = 0;
+		request[0] = '\0';
+		while (used < sizeof(request) - 1 && !strstr(request, "\r\n\r\n")) {
+			int received = static_cast<int>(recv(client, request + used, static_cast<int>(sizeof(request) - 1 - used), 0));
+			if (received <= 0)
+				break;
+			used += static_cast<size_t>(received);
+			request[used] = '\0';
+		}
+
+		const bool found = strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0;
+		std::string body = found ? Render() : "Not found\n";
+		std::string response = found ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n";
+		response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ";
+		response += std::to_string(body.size());
+		response += "\r\nConnection: close\r\n\r\n";
+		response += body;
+		SendAll(client, response);
+	}
+
+	static void SendAll(Socket client, const std::string& data) {
+		size_t sent = 0;
+		while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+			const int flags = MSG_NOSIGNAL; // A client that hung up must not kill the process
+#else
+			const int flags = 0;
+#endif
+			int n = static_cast<int>(send(client, data.data() + sent, static_cast<int>(data.size() - sent), flags));
+			if (n <= 0)
+				return;
+			sent += static_cast<size_t>(n);
+		}
+	}
+
+#ifdef _WIN32
+	HANDLE CreatePipeInstance() {
+		return CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+			PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, 64 * 1024, 0, 0, nullptr);
+	}
+
+	// Waits for an overlapped operation on the pipe until it completes, Stop() is called or the
+	// timeout passes. Anything unfinished is cancelled, and waited for so the OVERLAPPED can go.
+	bool Complete(HANDLE pipe, OVERLAPPED& overlapped, DWORD timeoutMs) {
+		HANDLE events[2] = { overlapped.hEvent, stopEvent };
+		DWORD done = 0;
+		if (WaitForMultipleObjects(2, events, FALSE, timeoutMs) == WAIT_OBJECT_0)
+			return GetOverlappedResult(pipe, &overlapped, &done, FALSE) != FALSE;
+		CancelIoEx(pipe, &overlapped);
+		GetOverlappedResult(pipe, &overlapped, &done, TRUE);
+		return false;
+	}
+
+	void ServePipe(HANDLE pipe) {
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		while (!stopping && pipe != INVALID_HANDLE_VALUE && overlapped.hEvent) {
+			ResetEvent(overlapped.hEvent);
+			BOOL connected = ConnectNamedPipe(pipe, &overlapped);
+			if (!connected) {
+				const DWORD error = GetLastError();
+				connected = error == ERROR_PIPE_CONNECTED || (error == ERROR_IO_PENDING && Complete(pipe, overlapped, INFINITE));
+			}
+
+			bool delivered = false;
+			if (connected && !stopping) {
+				std::string text = Render();
+				ResetEvent(overlapped.hEvent);
+				DWORD written = 0;
+				delivered = WriteFile(pipe, text.data(), static_cast<DWORD>(text.size()), &written, &overlapped)
+					|| (GetLastError() == ERROR_IO_PENDING && Complete(pipe, overlapped, ioTimeoutMs));
+			}
+
+			// Once the text is in the pipe buffer, closing the handle leaves it to the client to read,
+			// where DisconnectNamedPipe would discard it. That is what FlushFileBuffers waited for,
+			// with no way to give up on a client that does not read.
+			if (!delivered)
+				DisconnectNamedPipe(pipe);
+			CloseHandle(pipe);
+			pipe = stopping ? INVALID_HANDLE_VALUE : CreatePipeInstance();
+		}
+		if (pipe != INVALID_HANDLE_VALUE)
+			CloseHandle(pipe);
+		if (overlapped.hEvent)
+			CloseHandle(overlapped.hEvent);
+	}
+#endif
+
+	Collect collect;
+	std::mutex collectMutex; // Serializes scrapes from the two listeners
+	std::mutex clientMutex;  // Guards clients against being closed while Stop() shuts them down
+	Socket clients[2] = { invalidSocket, invalidSocket }; // Being served by the TCP and the pipe thread
+	std::atomic<bool> stopping = false;
+	std::atomic<uint64_t> scrapes = 0;
+	Socket tcpListener = invalidSocket;
+	Socket pipeListener = invalidSocket;
+	uint16_t tcpPort = 0;
+	std::string pipeName;
+	std::thread tcpThread;
+	std::thread pipeThread;
+#ifdef _WIN32
+	HANDLE stopEvent = nullptr; // Set by Stop() for the pipe thread
+#endif
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// Sub-allocator for a persistent GPU buffer written with NO_OVERWRITE. Allocations are
+/// contiguous and tagged with the fence of the frame that made them; space is only handed out
+/// again once Retire() reports that fence as completed, so the GPU never reads a region that
+/// is being rewritten. Units are whatever the caller counts in (vertices, indices, bytes).
+/// </summary>
+class WBRingAllocator {
+public:
+	static constexpr size_t invalid = SIZE_MAX;
+
+	explicit WBRingAllocator(size_t capacity = 0) {
+		Reset(capacity);
+	}
+
+	/// <summary>
+	/// Forgets every allocation, e.g. after the backing buffer was replaced by a larger one.
+	/// </summary>
+	void Reset(size_t newCapacity) {
+		capacity = newCapacity;
+		head = tail = used = pending = 0;
+		frames.clear();
+	}
+
+	/// <summary>
+	/// Allocates count contiguous units for the current frame.
+	/// </summary>
+	/// <returns>The offset, or invalid when the free space is too small or fragmented by the wrap.</returns>
+	size_t Allocate(size_t count) {
+		if (count == 0 || count > capacity - used)
+			return count == 0 ? head : invalid;
+
+		if (used == 0)
+			head = tail = 0;
+
+		size_t offset;
+		if (head >= tail) {
+			// Free space is [head, capacity) and [0, tail)
+			if (capacity - head >= count) {
+				offset = head;
+			}
+			else if (tail >= count) {
+				// Skip the end of the buffer, it is released together with this frame
+				size_t skipped = capacity - head;
+				used += skipped;
+				pending += skipped;
+				offset = 0;
+			}
+			else {
+				return invalid;
+			}
+		}
+		else {
+			if (tail - head < count)
+				return invalid;
+			offset = head;
+		}
+
+		head = offset + count;
+		used += count;
+		pending += count;
+		return offset;
+	}
+
+	/// <summary>
+	/// Closes the current frame. Its allocations stay reserved until Retire(fence).
+	/// </summary>
+	void EndFrame(uint64_t fence) {
+		if (pending == 0)
+			return;
+		frames.push_back({ fence, head, pending });
+		pending = 0;
+	}
+
+	/// <summary>
+	/// Releases the allocations of every frame whose fence is at or before completedFence.
+	/// </summary>
+	void Retire(uint64_t completedFence) {
+		while (!frames.empty() && frames.front().fence <= completedFence) {
+			tail = frames.front().end;
+			used -= frames.front().size;
+			frames.pop_front();
+		}
+	}
+
+	size_t GetCapacity() const { return capacity; }
+	size_t GetUsed() const { return used; }
+	size_t GetFramesInFlight() const { return frames.size(); }
+
+private:
+	struct Frame {
+		uint64_t fence;
+		size_t end;  // head after the frame's last allocation
+		size_t size; // Units released when the frame retires, including skipped space
+	};
+
+	size_t capacity = 0;
+	size_t head = 0;
+	size_t tail = 0;
+	size_t used = 0;
+	size_t pending = 0;
+	std::deque<Frame> frames;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+// Shared SIMD plumbing for the software paths (rasterizer, frame diffing, pixel conversion).
+// SSE2 is part of the x64 baseline and used unconditionally when available. AVX2 kernels are
+// compiled with WB_TARGET_AVX2 and selected at runtime through WBCpuHasAVX2().
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define WB_HAS_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define WB_HAS_SSE2 0
+#endif
+
+#if WB_HAS_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define WB_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define WB_TARGET_AVX2
+#endif
+
+/// <summary>
+/// Checks whether the CPU and OS support AVX2. The result is computed once.
+/// </summary>
+inline bool WBCpuHasAVX2() {
+#if !WB_HAS_SSE2
+	return false;
+#elif defined(_MSC_VER)
+	static const bool supported = [] {
+		int info[4] = {};
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return supported;
+#else
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+#endif
+}
+
+/// <summary>
+/// Divides a value in [0, 65535 - 383] by 255 with correct rounding, matching the SIMD kernels.
+/// </summary>
+inline unsigned WBDiv255(unsigned x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
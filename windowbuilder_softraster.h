@@ -0,0 +1,553 @@
+#pragma once
+
+#include <imgui.h>
+
+#include <unordered_map>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "windowbuilder_simd.h"
+
+// CPU renderer for ImDrawData. Only depends on imgui.h, so it works without a GPU:
+// headless performance runs, golden-image tests in CI and remote sessions.
+
+/// <summary>
+/// A texture the software rasterizer can sample. RGBA8, tightly packed, not owned.
+/// </summary>
+struct WBSoftTexture {
+	int width = 0;
+	int height = 0;
+	const uint8_t* pixels = nullptr;
+};
+
+/// <summary>
+/// Counters of the last WBSoftRasterizer::Render call.
+/// </summary>
+struct WBSoftRasterStats {
+	uint64_t quads = 0;        // Axis-aligned quads taken by the fast path
+	uint64_t triangles = 0;    // Triangles taken by the general path
+	uint64_t pixels = 0;       // Pixels covered (and blended) across all primitives
+	double milliseconds = 0.0; // Wall time of Render()
+};
+
+/// <summary>
+/// Result of WBCompareImages.
+/// </summary>
+struct WBImageDiff {
+	int maxDelta = 0;        // Largest per-channel difference
+	size_t pixelsOver = 0;   // Pixels with any channel differing by more than the tolerance
+};
+
+/// <summary>
+/// Compares two RGBA8 images of the same size, e.g. a software frame against a GPU readback.
+/// </summary>
+inline WBImageDiff WBCompareImages(const uint8_t* a, const uint8_t* b, int width, int height, int tolerance) {
+	WBImageDiff diff;
+	for (size_t i = 0, count = static_cast<size_t>(width) * height; i < count; ++i) {
+		int worst = 0;
+		for (int c = 0; c < 4; ++c)
+			worst = std::max(worst, std::abs(a[i * 4 + c] - b[i * 4 + c]));
+		diff.maxDelta = std::max(diff.maxDelta, worst);
+		if (worst > tolerance)
+			++diff.pixelsOver;
+	}
+	return diff;
+}
+
+/// <summary>
+/// Rasterizes ImDrawData into an RGBA8 buffer, with the blend state of the DX11 backend
+/// (straight alpha, SRC_ALPHA / INV_SRC_ALPHA). Axis-aligned quads, which make up most
+/// ImGui geometry, are detected and filled span by span with SSE2/AVX2; everything else
+/// goes through a half-space triangle rasterizer. The framebuffer is split into bands
+/// that are rasterized in parallel, each band replaying the primitives that touch it in order.
+/// Textures are sampled nearest at pixel centers.
+/// </summary>
+class WBSoftRasterizer {
+public:
+	static constexpr int bandHeight = 32;
+
+	/// <summary>
+	/// Creates a rasterizer.
+	/// </summary>
+	/// <param name="threadCount">Total threads used by Render, including the caller. 0 picks hardware concurrency.</param>
+	explicit WBSoftRasterizer(int threadCount = 0) {
+		if (threadCount <= 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(&WBSoftRasterizer::WorkerLoop, this);
+	}
+
+	WBSoftRasterizer(const WBSoftRasterizer&) = delete;
+	WBSoftRasterizer& operator=(const WBSoftRasterizer&) = delete;
+
+	~WBSoftRasterizer() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobStart.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	/// <summary>
+	/// Resizes the framebuffer. Contents are undefined until the next Clear.
+	/// </summary>
+	void Resize(int newWidth, int newHeight) {
+		width = std::max(0, newWidth);
+		height = std::max(0, newHeight);
+		pixels.resize(static_cast<size_t>(width) * height * 4);
+	}
+
+	/// <summary>
+	/// Clears the framebuffer, taking the same float color as WindowConfig::clearColor.
+	/// </summary>
+	void Clear(const std::array<float, 4>& color) {
+		uint8_t rgba[4];
+		for (int c = 0; c < 4; ++c)
+			rgba[c] = static_cast<uint8_t>(std::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+		uint32_t value;
+		memcpy(&value, rgba, 4);
+		std::fill(reinterpret_cast<uint32_t*>(pixels.data()),
+			reinterpret_cast<uint32_t*>(pixels.data()) + static_cast<size_t>(width) * height, value);
+	}
+
+	/// <summary>
+	/// Registers a texture under an ImTextureID. The pixels must outlive the registration.
+	/// </summary>
+	void SetTexture(ImTextureID id, const WBSoftTexture& texture) {
+		textures[id] = texture;
+	}
+
+	/// <summary>
+	/// Builds the font atlas as RGBA32, assigns it an id and registers it.
+	/// </summary>
+	void SetFontAtlas(ImFontAtlas* atlas, ImTextureID id) {
+		unsigned char* data = nullptr;
+		int atlasWidth = 0, atlasHeight = 0;
+		atlas->GetTexDataAsRGBA32(&data, &atlasWidth, &atlasHeight);
+		atlas->SetTexID(id);
+		SetTexture(id, { atlasWidth, atlasHeight, data });
+	}
+
+	/// <summary>
+	/// Rasterizes a frame of draw data on top of the current framebuffer contents.
+	/// </summary>
+	void Render(const ImDrawData* drawData) {
+		auto start = std::chrono::steady_clock::now();
+		stats = {};
+
+		Prepare(drawData);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			nextBand = 0;
+			pendingWorkers = static_cast<int>(workers.size());
+			++generation;
+		}
+		jobStart.notify_all();
+		RasterizeBands();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDone.wait(lock, [&] { return pendingWorkers == 0; });
+		}
+
+		stats.pixels = coveredPixels.exchange(0);
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const uint8_t* GetPixels() const { return pixels.data(); }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const WBSoftRasterStats& GetStats() const { return stats; }
+
+	/// <summary>
+	/// Blends a constant straight-alpha color over a span of RGBA8 pixels. Exposed for testing.
+	/// </summary>
+	static void BlendSpan(uint8_t* dst, int count, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+		if (a == 0 || count <= 0)
+			return;
+		if (a == 255) {
+			uint32_t value = r | g << 8 | b << 16 | 0xFF000000u;
+			std::fill(reinterpret_cast<uint32_t*>(dst), reinterpret_cast<uint32_t*>(dst) + count, value);
+			return;
+		}
+
+		int done = 0;
+#if WB_HAS_SSE2
+		if (WBCpuHasAVX2())
+			done = BlendSpanAVX2(dst, count, r, g, b, a);
+		else
+			done = BlendSpanSSE2(dst, count, r, g, b, a);
+#endif
+		for (int i = done; i < count; ++i)
+			BlendPixel(dst + i * 4, r, g, b, a);
+	}
+
+private:
+	enum class PrimKind : uint8_t { Quad, Triangle };
+
+	struct Vertex {
+		float x, y, u, v;
+		uint32_t col;
+	};
+
+	struct Prim {
+		PrimKind kind;
+		const WBSoftTexture* texture;
+		int clipX0, clipY0, clipX1, clipY1; // Pixel bounds, exclusive max, already clamped to the framebuffer
+		uint32_t v0, v1, v2;                // Vertex indices; for quads v0 and v2 are opposite corners
+	};
+
+	static void BlendPixel(uint8_t* d, unsigned r, unsigned g, unsigned b, unsigned a) {
+		if (a == 0)
+			return;
+		unsigned inv = 255 - a;
+		d[0] = static_cast<uint8_t>(WBDiv255(r * a + d[0] * inv));
+		d[1] = static_cast<uint8_t>(WBDiv255(g * a + d[1] * inv));
+		d[2] = static_cast<uint8_t>(WBDiv255(b * a + d[2] * inv));
+		d[3] = static_cast<uint8_t>(WBDiv255(a * 255 + d[3] * inv));
+	}
+
+#if WB_HAS_SSE2
+	// dst = div255(src * a + dst * (255 - a)) on 16-bit lanes, four pixels at a time
+	static int BlendSpanSSE2(uint8_t* dst, int count, unsigned r, unsigned g, unsigned b, unsigned a) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i src = _mm_setr_epi16(
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255),
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255));
+		const __m128i inv = _mm_set1_epi16(static_cast<short>(255 - a));
+		const __m128i bias = _mm_set1_epi16(128);
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), src), bias);
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), src), bias);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+		}
+		return i;
+	}
+
+	WB_TARGET_AVX2 static int BlendSpanAVX2(uint8_t* dst, int count, unsigned r, unsigned g, unsigned b, unsigned a) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i src = _mm256_setr_epi16(
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255),
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255),
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255),
+			static_cast<short>(r * a), static_cast<short>(g * a), static_cast<short>(b * a), static_cast<short>(a * 255));
+		const __m256i inv = _mm256_set1_epi16(static_cast<short>(255 - a));
+		const __m256i bias = _mm256_set1_epi16(128);
+
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i * 4));
+			__m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv), src), bias);
+			__m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv), src), bias);
+			lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+			hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_packus_epi16(lo, hi));
+		}
+		return i + BlendSpanSSE2(dst + i * 4, count - i, r, g, b, a);
+	}
+#endif
+
+	static const uint8_t* Sample(const WBSoftTexture* texture, float u, float v) {
+		static const uint8_t white[4] = { 255, 255, 255, 255 };
+		if (!texture || !texture->pixels)
+			return white;
+		int x = std::clamp(static_cast<int>(u * texture->width), 0, texture->width - 1);
+		int y = std::clamp(static_cast<int>(v * texture->height), 0, texture->height - 1);
+		return texture->pixels + (static_cast<size_t>(y) * texture->width + x) * 4;
+	}
+
+	static void Modulate(const uint8_t* texel, uint32_t col, unsigned out[4]) {
+		for (int c = 0; c < 4; ++c)
+			out[c] = WBDiv255(texel[c] * ((col >> (c * 8)) & 0xFF));
+	}
+
+	// Flattens the draw lists into transformed vertices and primitives, then bins primitives by band
+	void Prepare(const ImDrawData* drawData) {
+		vertices.clear();
+		prims.clear();
+		bands.resize((height + bandHeight - 1) / bandHeight);
+		for (auto& band : bands)
+			band.clear();
+		if (!drawData || width == 0 || height == 0)
+			return;
+
+		const ImVec2 offset = drawData->DisplayPos;
+		const ImVec2 scale = drawData->FramebufferScale;
+
+		for (int n = 0; n < drawData->CmdListsCount; ++n) {
+			const ImDrawList* list = drawData->CmdLists[n];
+			const uint32_t base = static_cast<uint32_t>(vertices.size());
+			for (int i = 0; i < list->VtxBuffer.Size; ++i) {
+				const ImDrawVert& vert = list->VtxBuffer[i];
+				vertices.push_back({ (vert.pos.x - offset.x) * scale.x, (vert.pos.y - offset.y) * scale.y,
+					vert.uv.x, vert.uv.y, vert.col });
+			}
+
+			for (int c = 0; c < list->CmdBuffer.Size; ++c) {
+				const ImDrawCmd* cmd = &list->CmdBuffer[c];
+				if (cmd->UserCallback) {
+					if (cmd->UserCallback != ImDrawCallback_ResetRenderState)
+						cmd->UserCallback(list, cmd);
+					continue;
+				}
+
+				// Same truncation as the DX11 backend's scissor rect
+				Prim prim = {};
+				prim.clipX0 = std::max(0, static_cast<int>((cmd->ClipRect.x - offset.x) * scale.x));
+				prim.clipY0 = std::max(0, static_cast<int>((cmd->ClipRect.y - offset.y) * scale.y));
+				prim.clipX1 = std::min(width, static_cast<int>((cmd->ClipRect.z - offset.x) * scale.x));
+				prim.clipY1 = std::min(height, static_cast<int>((cmd->ClipRect.w - offset.y) * scale.y));
+				if (prim.clipX0 >= prim.clipX1 || prim.clipY0 >= prim.clipY1)
+					continue;
+
+				auto texture = textures.find(cmd->GetTexID());
+				prim.texture = texture != textures.end() ? &texture->second : nullptr;
+
+				const ImDrawIdx* idx = list->IdxBuffer.Data + cmd->IdxOffset;
+				const uint32_t vtx = base + cmd->VtxOffset;
+				for (unsigned i = 0; i + 3 <= cmd->ElemCount; i += 3) {
+					if (i + 6 <= cmd->ElemCount && IsQuad(idx + i, vtx)) {
+						prim.kind = PrimKind::Quad;
+						prim.v0 = vtx + idx[i];
+						prim.v1 = vtx + idx[i + 1];
+						prim.v2 = vtx + idx[i + 2];
+						AddPrim(prim);
+						i += 3;
+						++stats.quads;
+						continue;
+					}
+					prim.kind = PrimKind::Triangle;
+					prim.v0 = vtx + idx[i];
+					prim.v1 = vtx + idx[i + 1];
+					prim.v2 = vtx + idx[i + 2];
+					AddPrim(prim);
+					++stats.triangles;
+				}
+			}
+		}
+	}
+
+	// ImGui emits rectangles as (a, b, c) (a, c, d) with a/c opposite corners, one color and an axis-aligned uv mapping
+	bool IsQuad(const ImDrawIdx* idx, uint32_t vtx) const {
+		if (idx[3] != idx[0] || idx[4] != idx[2])
+			return false;
+		const Vertex& a = vertices[vtx + idx[0]];
+		const Vertex& b = vertices[vtx + idx[1]];
+		const Vertex& c = vertices[vtx + idx[2]];
+		const Vertex& d = vertices[vtx + idx[5]];
+		return a.col == b.col && a.col == c.col && a.col == d.col
+			&& a.y == b.y && b.x == c.x && c.y == d.y && d.x == a.x
+			&& a.v == b.v && b.u == c.u && c.v == d.v && d.u == a.u;
+	}
+
+	void AddPrim(const Prim& prim) {
+		const Vertex& a = vertices[prim.v0];
+		const Vertex& b = vertices[prim.v1];
+		const Vertex& c = vertices[prim.v2];
+		float minY = std::min({ a.y, b.y, c.y });
+		float maxY = std::max({ a.y, b.y, c.y });
+		int y0 = std::max(prim.clipY0, static_cast<int>(std::ceil(minY - 0.5f)));
+		int y1 = std::min(prim.clipY1, static_cast<int>(std::ceil(maxY - 0.5f)));
+		if (y0 >= y1)
+			return;
+
+		uint32_t index = static_cast<uint32_t>(prims.size());
+		prims.push_back(prim);
+		for (int band = y0 / bandHeight; band <= (y1 - 1) / bandHeight; ++band)
+			bands[band].push_back(index);
+	}
+
+	void RasterizeBands() {
+		uint64_t covered = 0;
+		for (;;) {
+			int band = nextBand.fetch_add(1);
+			if (band >= static_cast<int>(bands.size()))
+				break;
+			int rowStart = band * bandHeight;
+			int rowEnd = std::min(height, rowStart + bandHeight);
+			for (uint32_t index : bands[band]) {
+				const Prim& prim = prims[index];
+				covered += prim.kind == PrimKind::Quad
+					? RasterizeQuad(prim, rowStart, rowEnd)
+					: RasterizeTriangle(prim, rowStart, rowEnd);
+			}
+		}
+		coveredPixels.fetch_add(covered);
+	}
+
+	uint64_t RasterizeQuad(const Prim& prim, int rowStart, int rowEnd) {
+		const Vertex& a = vertices[prim.v0];
+		const Vertex& c = vertices[prim.v2];
+		float left = std::min(a.x, c.x), right = std::max(a.x, c.x);
+		float top = std::min(a.y, c.y), bottom = std::max(a.y, c.y);
+
+		// Pixels whose centers are inside [left, right) x [top, bottom)
+		int x0 = std::max(prim.clipX0, static_cast<int>(std::ceil(left - 0.5f)));
+		int x1 = std::min(prim.clipX1, static_cast<int>(std::ceil(right - 0.5f)));
+		int y0 = std::max({ prim.clipY0, rowStart, static_cast<int>(std::ceil(top - 0.5f)) });
+		int y1 = std::min({ prim.clipY1, rowEnd, static_cast<int>(std::ceil(bottom - 0.5f)) });
+		if (x0 >= x1 || y0 >= y1)
+			return 0;
+
+		unsigned color[4];
+		if (a.u == c.u && a.v == c.v) {
+			// Solid fill (untextured rects sample the atlas' white pixel)
+			Modulate(Sample(prim.texture, a.u, a.v), a.col, color);
+			for (int y = y0; y < y1; ++y)
+				BlendSpan(Row(y) + x0 * 4, x1 - x0, static_cast<uint8_t>(color[0]), static_cast<uint8_t>(color[1]),
+					static_cast<uint8_t>(color[2]), static_cast<uint8_t>(color[3]));
+			return static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+		}
+
+		// Textured quad: uv is linear in x and y separately, so each row reads a single texel row
+		const WBSoftTexture* texture = prim.texture;
+		if (!texture || !texture->pixels) {
+			Modulate(Sample(nullptr, 0.0f, 0.0f), a.col, color);
+			for (int y = y0; y < y1; ++y)
+				BlendSpan(Row(y) + x0 * 4, x1 - x0, static_cast<uint8_t>(color[0]), static_cast<uint8_t>(color[1]),
+					static_cast<uint8_t>(color[2]), static_cast<uint8_t>(color[3]));
+			return static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+		}
+
+		const unsigned tint[4] = { a.col & 0xFF, (a.col >> 8) & 0xFF, (a.col >> 16) & 0xFF, a.col >> 24 };
+		const float texelsPerPixelU = (c.u - a.u) / (c.x - a.x) * texture->width;
+		const float texelsPerPixelV = (c.v - a.v) / (c.y - a.y) * texture->height;
+		const float texelU0 = a.u * texture->width + (x0 + 0.5f - a.x) * texelsPerPixelU;
+		for (int y = y0; y < y1; ++y) {
+			int ty = std::clamp(static_cast<int>(a.v * texture->height + (y + 0.5f - a.y) * texelsPerPixelV), 0, texture->height - 1);
+			const uint8_t* texels = texture->pixels + static_cast<size_t>(ty) * texture->width * 4;
+			uint8_t* dst = Row(y) + x0 * 4;
+			float texelU = texelU0;
+			for (int x = x0; x < x1; ++x, dst += 4, texelU += texelsPerPixelU) {
+				const uint8_t* texel = texels + std::clamp(static_cast<int>(texelU), 0, texture->width - 1) * 4;
+				unsigned alpha = WBDiv255(texel[3] * tint[3]);
+				if (alpha == 0)
+					continue;
+				BlendPixel(dst, WBDiv255(texel[0] * tint[0]), WBDiv255(texel[1] * tint[1]), WBDiv255(texel[2] * tint[2]), alpha);
+			}
+		}
+		return static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+	}
+
+	uint64_t RasterizeTriangle(const Prim& prim, int rowStart, int rowEnd) {
+		const Vertex* a = &vertices[prim.v0];
+		const Vertex* b = &vertices[prim.v1];
+		const Vertex* c = &vertices[prim.v2];
+		auto edge = [](const Vertex& p, const Vertex& q, float x, float y) {
+			return (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x);
+		};
+
+		float area = edge(*a, *b, c->x, c->y);
+		if (area == 0.0f)
+			return 0;
+		if (area < 0.0f) {
+			std::swap(b, c);
+			area = -area;
+		}
+
+		int x0 = std::max(prim.clipX0, static_cast<int>(std::ceil(std::min({ a->x, b->x, c->x }) - 0.5f)));
+		int x1 = std::min(prim.clipX1, static_cast<int>(std::ceil(std::max({ a->x, b->x, c->x }) - 0.5f)) + 1);
+		int y0 = std::max({ prim.clipY0, rowStart, static_cast<int>(std::ceil(std::min({ a->y, b->y, c->y }) - 0.5f)) });
+		int y1 = std::min({ prim.clipY1, rowEnd, static_cast<int>(std::ceil(std::max({ a->y, b->y, c->y }) - 0.5f)) + 1 });
+		if (x0 >= x1 || y0 >= y1)
+			return 0;
+
+		// Tie-break rule so that pixels on an edge shared by two triangles are blended exactly once
+		auto owns = [](const Vertex& p, const Vertex& q) {
+			float dx = q.x - p.x, dy = q.y - p.y;
+			return dy > 0.0f || (dy == 0.0f && dx < 0.0f);
+		};
+		const bool own0 = owns(*b, *c), own1 = owns(*c, *a), own2 = owns(*a, *b);
+		const float step0 = -(c->y - b->y), step1 = -(a->y - c->y), step2 = -(b->y - a->y);
+		const float invArea = 1.0f / area;
+
+		float ca[4], cb[4], cc[4];
+		for (int ch = 0; ch < 4; ++ch) {
+			ca[ch] = static_cast<float>((a->col >> (ch * 8)) & 0xFF);
+			cb[ch] = static_cast<float>((b->col >> (ch * 8)) & 0xFF);
+			cc[ch] = static_cast<float>((c->col >> (ch * 8)) & 0xFF);
+		}
+
+		uint64_t covered = 0;
+		for (int y = y0; y < y1; ++y) {
+			float py = y + 0.5f, px = x0 + 0.5f;
+			float w0 = edge(*b, *c, px, py), w1 = edge(*c, *a, px, py), w2 = edge(*a, *b, px, py);
+			uint8_t* dst = Row(y) + x0 * 4;
+			for (int x = x0; x < x1; ++x, dst += 4, w0 += step0, w1 += step1, w2 += step2) {
+				if (!(w0 > 0.0f || (w0 == 0.0f && own0)) || !(w1 > 0.0f || (w1 == 0.0f && own1))
+					|| !(w2 > 0.0f || (w2 == 0.0f && own2)))
+					continue;
+
+				float l0 = w0 * invArea, l1 = w1 * invArea, l2 = 1.0f - l0 - l1;
+				const uint8_t* texel = Sample(prim.texture, l0 * a->u + l1 * b->u + l2 * c->u,
+					l0 * a->v + l1 * b->v + l2 * c->v);
+				unsigned color[4];
+				for (int ch = 0; ch < 4; ++ch) {
+					unsigned vertexColor = static_cast<unsigned>(l0 * ca[ch] + l1 * cb[ch] + l2 * cc[ch] + 0.5f);
+					color[ch] = WBDiv255(texel[ch] * std::min(vertexColor, 255u));
+				}
+				BlendPixel(dst, color[0], color[1], color[2], color[3]);
+				++covered;
+			}
+		}
+		return covered;
+	}
+
+	uint8_t* Row(int y) {
+		return pixels.data() + static_cast<size_t>(y) * width * 4;
+	}
+
+	void WorkerLoop() {
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			jobStart.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			lock.unlock();
+
+			RasterizeBands();
+
+			lock.lock();
+			if (--pendingWorkers == 0)
+				jobDone.notify_one();
+		}
+	}
+
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+	std::unordered_map<ImTextureID, WBSoftTexture> textures;
+
+	std::vector<Vertex> vertices;
+	std::vector<Prim> prims;
+	std::vector<std::vector<uint32_t>> bands; // Primitive indices per band, in submission order
+	WBSoftRasterStats stats;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobStart;
+	std::condition_variable jobDone;
+	uint64_t generation = 0;
+	int pendingWorkers = 0;
+	bool stopping = false;
+	std::atomic<int> nextBand = 0;
+	std::atomic<uint64_t> coveredPixels = 0;
+};
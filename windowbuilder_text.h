@@ -0,0 +1,688 @@
+#pragma once
+
+#include <unordered_map>
+#include <condition_variable>
+#include <string_view>
+#include <string>
+#include <mutex>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "windowbuilder_textures.h"
+
+// Platform independent text subsystem: signed distance field glyph generation, a shelf-packed
+// atlas with LRU eviction and a cache of laid out runs. A WBGlyphSource supplies metrics and
+// coverage bitmaps (GDI on Windows); the renderer uploads the atlas and draws the glyph quads.
+
+// Bits of the string hash used as the run cache key. Colliding strings are told apart by their
+// text, so this only changes how often that happens; tests lower it to exercise the collision path.
+#ifndef WB_TEXT_RUN_KEY_BITS
+#define WB_TEXT_RUN_KEY_BITS 64
+#endif
+
+/// <summary>
+/// A glyph rendered as 8-bit coverage, top-down. left/top place the bitmap relative to the pen
+/// position on the baseline (top is measured upwards), in the pixels of the requested size.
+/// </summary>
+struct WBGlyphBitmap {
+	int width = 0;
+	int height = 0;
+	float left = 0.0f;
+	float top = 0.0f;
+	std::vector<uint8_t> coverage;
+};
+
+/// <summary>
+/// Supplies glyph metrics and bitmaps for one font. Rasterize is called from worker threads,
+/// Advance and the line metrics from the render thread.
+/// </summary>
+class WBGlyphSource {
+public:
+	virtual ~WBGlyphSource() = default;
+
+	/// <summary>
+	/// Horizontal advance of a glyph in pixels at the given size.
+	/// </summary>
+	virtual float Advance(uint32_t codepoint, int pixelSize) = 0;
+
+	/// <summary>
+	/// Distance between baselines in pixels at the given size.
+	/// </summary>
+	virtual float LineHeight(int pixelSize) = 0;
+
+	/// <summary>
+	/// Distance from the top of a line to its baseline in pixels at the given size.
+	/// </summary>
+	virtual float Ascent(int pixelSize) = 0;
+
+	/// <summary>
+	/// Renders a glyph. Returns false for glyphs without an outline (e.g. space).
+	/// </summary>
+	virtual bool Rasterize(uint32_t codepoint, int pixelSize, WBGlyphBitmap& out) = 0;
+};
+
+/// <summary>
+/// Converts a coverage bitmap into a signed distance field with exact Euclidean distances
+/// (Felzenszwalb-Huttenlocher), then downsamples it.
+/// </summary>
+/// <param name="bitmap">Antialiased coverage rendered at downscale times the output resolution.</param>
+/// <param name="downscale">Ratio between the bitmap and the output resolution.</param>
+/// <param name="spread">Distance in output pixels mapped to the full 0..255 range around the 128 edge.</param>
+/// <param name="outWidth">Receives the output width, including spread padding on both sides.</param>
+/// <param name="outHeight">Receives the output height, including spread padding on both sides.</param>
+/// <returns>Distance field, 128 on the edge and larger inside.</returns>
+inline std::vector<uint8_t> WBGenerateSDF(const WBGlyphBitmap& bitmap, int downscale, int spread, int& outWidth, int& outHeight) {
+	const int pad = spread * downscale;
+	const int w = bitmap.width + pad * 2;
+	const int h = bitmap.height + pad * 2;
+	const float inf = 1e20f;
+
+	// inside holds squared distances to the shape, outside to the background. Partially covered
+	// samples seed both with the sub-sample offset of the edge implied by their coverage.
+	std::vector<float> inside(size_t(w) * h, inf), outside(size_t(w) * h, 0.0f);
+	for (int y = 0; y < bitmap.height; ++y) {
+		for (int x = 0; x < bitmap.width; ++x) {
+			uint8_t coverage = bitmap.coverage[size_t(y) * bitmap.width + x];
+			if (coverage == 0)
+				continue;
+			size_t i = size_t(y + pad) * w + x + pad;
+			if (coverage == 255) {
+				inside[i] = 0.0f;
+				outside[i] = inf;
+			}
+			else {
+				float d = 0.5f - coverage / 255.0f;
+				inside[i] = d > 0.0f ? d * d : 0.0f;
+				outside[i] = d < 0.0f ? d * d : 0.0f;
+			}
+		}
+	}
+
+	// 1D squared distance transform of a line, in place. Only finite samples become parabolas,
+	// so lines without features are skipped and far-away infinities never enter the envelope.
+	std::vector<float> f(std::max(w, h)), z(std::max(w, h) + 1);
+	std::vector<int> v(std::max(w, h));
+	auto transform1D = [&](float* data, int n, size_t stride) {
+		int k = -1;
+		for (int q = 0; q < n; ++q) {
+			f[q] = data[q * stride];
+			if (f[q] >= inf)
+				continue;
+			if (k < 0) {
+				k = 0;
+				v[0] = q;
+				z[0] = -inf;
+				z[1] = inf;
+				continue;
+			}
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+			while (s <= z[k]) {
+				--k;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+			}
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = inf;
+		}
+		if (k < 0)
+			return;
+		k = 0;
+		for (int q = 0; q < n; ++q) {
+			while (z[k + 1] < q)
+				++k;
+			float dq = float(q - v[k]);
+			data[q * stride] = dq * dq + f[v[k]];
+		}
+	};
+	auto transform2D = [&](std::vector<float>& grid) {
+		for (int x = 0; x < w; ++x)
+			transform1D(grid.data() + x, h, w);
+		for (int y = 0; y < h; ++y)
+			transform1D(grid.data() + size_t(y) * w, w, 1);
+	};
+	transform2D(inside);
+	transform2D(outside);
+
+	outWidth = (w + downscale - 1) / downscale;
+	outHeight = (h + downscale - 1) / downscale;
+	auto signedDistance = [&](int x, int y) {
+		size_t i = size_t(std::min(y, h - 1)) * w + std::min(x, w - 1);
+		return std::sqrt(outside[i]) - std::sqrt(inside[i]);
+	};
+	std::vector<uint8_t> sdf(size_t(outWidth) * outHeight);
+	const int half = std::max(1, downscale / 2);
+	for (int oy = 0; oy < outHeight; ++oy) {
+		for (int ox = 0; ox < outWidth; ++ox) {
+			// The output sample center falls between the four middle input samples of its block
+			int sx = ox * downscale + half, sy = oy * downscale + half;
+			float distance = downscale > 1
+				? (signedDistance(sx - 1, sy - 1) + signedDistance(sx, sy - 1) + signedDistance(sx - 1, sy) + signedDistance(sx, sy)) * 0.25f
+				: signedDistance(ox, oy);
+			float value = 128.0f + distance / downscale / spread * 127.0f;
+			sdf[size_t(oy) * outWidth + ox] = static_cast<uint8_t>(std::clamp(value, 0.0f, 255.0f));
+		}
+	}
+	return sdf;
+}
+
+/// <summary>
+/// Shelf packer for a fixed-size atlas. Shelf heights are rounded up to multiples of 4 so
+/// glyphs of similar height share shelves. When the atlas is full, whole shelves are
+/// reclaimed least recently used first; shelves filled in the current frame are never
+/// reclaimed, so a burst of new glyphs can't push out each other or the ones in use.
+/// </summary>
+class WBShelfAtlas {
+public:
+	struct Rect {
+		int x = 0, y = 0, w = 0, h = 0;
+	};
+
+	WBShelfAtlas(int width, int height) : width(width), height(height) {}
+
+	/// <summary>
+	/// Allocates a rectangle without evicting anything.
+	/// </summary>
+	/// <param name="frame">The current frame.</param>
+	/// <param name="lastUsed">Frame the content was last asked for, which ages the shelf.</param>
+	/// <returns>The shelf index, or -1 if nothing fits.</returns>
+	int Allocate(int w, int h, uint64_t frame, uint64_t lastUsed, Rect& out) {
+		int shelfHeight = (h + 3) & ~3;
+		int best = -1;
+		for (int i = 0; i < static_cast<int>(shelves.size()); ++i) {
+			const Shelf& shelf = shelves[i];
+			if (shelf.height >= shelfHeight && shelf.height <= shelfHeight + shelfHeight / 4 + 4 && shelf.x + w <= width
+				&& (best < 0 || shelf.height < shelves[best].height))
+				best = i;
+		}
+		if (best < 0 && nextY + shelfHeight <= height) {
+			shelves.push_back({ nextY, shelfHeight, 0, lastUsed, frame });
+			nextY += shelfHeight;
+			best = static_cast<int>(shelves.size()) - 1;
+		}
+		if (best < 0)
+			return -1;
+
+		Shelf& shelf = shelves[best];
+		out = { shelf.x, shelf.y, w, h };
+		shelf.x += w + 1;
+		shelf.lastUsed = std::max(shelf.lastUsed, lastUsed);
+		shelf.lastFilled = frame;
+		return best;
+	}
+
+	/// <summary>
+	/// Empties the least recently used shelf that is tall enough for h and was neither used nor filled
+	/// in frame or later.
+	/// </summary>
+	/// <returns>The shelf index, or -1 if every candidate is in use.</returns>
+	int EvictLeastRecentlyUsed(int h, uint64_t frame) {
+		int shelfHeight = (h + 3) & ~3;
+		int victim = -1;
+		for (int i = 0; i < static_cast<int>(shelves.size()); ++i) {
+			const Shelf& shelf = shelves[i];
+			if (shelf.height >= shelfHeight && shelf.lastUsed < frame && shelf.lastFilled < frame && (victim < 0 || shelf.lastUsed < shelves[victim].lastUsed))
+				victim = i;
+		}
+		if (victim >= 0) {
+			shelves[victim].x = 0;
+			shelves[victim].lastUsed = 0;
+		}
+		return victim;
+	}
+
+	void Touch(int shelf, uint64_t frame) {
+		shelves[shelf].lastUsed = std::max(shelves[shelf].lastUsed, frame);
+	}
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+private:
+	struct Shelf {
+		int y;
+		int height;
+		int x;
+		uint64_t lastUsed;
+		uint64_t lastFilled;
+	};
+
+	int width;
+	int height;
+	int nextY = 0;
+	std::vector<Shelf> shelves;
+};
+
+/// <summary>
+/// Tuning for WBTextSystem.
+/// </summary>
+struct WBTextConfig {
+	int atlasSize = 1024;   // Square R8 atlas
+	int glyphSize = 32;     // Pixel size the distance fields are built for, any size is drawn from it
+	int spread = 4;         // Distance field range in pixels at glyphSize
+	int oversample = 2;     // Glyphs are rasterized at glyphSize * oversample before the transform
+	size_t maxRuns = 4096;  // Cached laid out strings
+	int workerThreads = 2;  // Distance field generation threads
+	int retryFrames = 30;   // Frames before a glyph that found no room in the atlas is generated again
+};
+
+/// <summary>
+/// Snapshot of the text counters.
+/// </summary>
+struct WBTextStats {
+	uint64_t runHits = 0;
+	uint64_t runMisses = 0;
+	uint64_t glyphHits = 0;        // Glyph draws served from the atlas
+	uint64_t glyphMisses = 0;      // Glyph draws skipped because the glyph was still generating
+	uint64_t glyphsGenerated = 0;
+	double generationSeconds = 0;  // Worker time spent rasterizing and transforming
+	uint64_t evictedShelves = 0;
+	uint64_t evictedGlyphs = 0;
+	uint64_t unplacedGlyphs = 0;   // Generated glyphs dropped because every shelf was in use this frame
+
+	double RunHitRate() const { return runHits + runMisses ? double(runHits) / double(runHits + runMisses) : 0.0; }
+	double GlyphHitRate() const { return glyphHits + glyphMisses ? double(glyphHits) / double(glyphHits + glyphMisses) : 0.0; }
+	// Generation throughput of one worker thread
+	double GlyphsPerSecond() const { return generationSeconds > 0 ? glyphsGenerated / generationSeconds : 0.0; }
+};
+
+/// <summary>
+/// A glyph quad ready to draw, in screen pixels and atlas uv.
+/// </summary>
+struct WBGlyphQuad {
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+};
+
+/// <summary>
+/// Distance field text. Strings are laid out once per (font, string) and the run is cached,
+/// so drawing a repeated label is a lookup plus one quad per glyph. Glyph fields are generated
+/// on worker threads and placed into the atlas by Update(); until then the glyph is skipped.
+/// A glyph that finds no room because the whole atlas is in use this frame is dropped and
+/// generated again after retryFrames.
+/// Call Update() once per frame on the render thread, before drawing, and upload the dirty rows.
+/// </summary>
+class WBTextSystem {
+public:
+	using FontId = uint32_t;
+
+	explicit WBTextSystem(WBTextConfig config = {})
+		: config(config), atlas(config.atlasSize, config.atlasSize),
+		atlasPixels(size_t(config.atlasSize) * config.atlasSize, 0)
+	{
+		for (int i = 0; i < std::max(1, config.workerThreads); ++i)
+			workers.emplace_back(&WBTextSystem::WorkerLoop, this);
+	}
+
+	WBTextSystem(const WBTextSystem&) = delete;
+	WBTextSystem& operator=(const WBTextSystem&) = delete;
+
+	~WBTextSystem() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	/// <summary>
+	/// Registers a font.
+	/// </summary>
+	/// <returns>Id used with Draw and Measure.</returns>
+	FontId AddFont(std::unique_ptr<WBGlyphSource> source) {
+		fonts.push_back(std::move(source));
+		return static_cast<FontId>(fonts.size() - 1);
+	}
+
+	bool HasFonts() const { return !fonts.empty(); }
+
+	/// <summary>
+	/// Places finished glyphs into the atlas. Render thread, once per frame.
+	/// </summary>
+	void Update() {
+		++frame;
+		// Update runs before this frame's Draw calls, so the glyphs in use are the ones drawn last frame
+		const uint64_t inUse = frame - 1;
+		std::deque<Finished> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.swap(finished);
+		}
+
+		for (Finished& done : ready) {
+			Glyph& glyph = glyphs[done.glyph];
+			if (done.sdf.empty()) {
+				glyph.state = GlyphState::Empty;
+				continue;
+			}
+
+			WBShelfAtlas::Rect rect;
+			int shelf = atlas.Allocate(done.width, done.height, frame, glyph.lastRequested, rect);
+			while (shelf < 0) {
+				int victim = atlas.EvictLeastRecentlyUsed(done.height, inUse);
+				if (victim < 0)
+					break;
+				EvictShelf(victim);
+				shelf = atlas.Allocate(done.width, done.height, frame, glyph.lastRequested, rect);
+			}
+			if (shelf < 0) {
+				// Atlas too small for this frame's working set. Wait before generating it again, or a
+				// glyph that never fits would be rasterized every frame.
+				glyph.state = GlyphState::Missing;
+				glyph.retryFrame = frame + std::max(1, config.retryFrames);
+				++stats.unplacedGlyphs;
+				continue;
+			}
+
+			for (int y = 0; y < done.height; ++y)
+				memcpy(atlasPixels.data() + size_t(rect.y + y) * config.atlasSize + rect.x,
+					done.sdf.data() + size_t(y) * done.width, done.width);
+			MarkDirty(rect.y, rect.y + rect.h);
+
+			glyph.state = GlyphState::Resident;
+			glyph.shelf = shelf;
+			glyph.rect = rect;
+			glyph.left = done.left;
+			glyph.top = done.top;
+			shelfGlyphs.resize(std::max(shelfGlyphs.size(), size_t(shelf) + 1));
+			shelfGlyphs[shelf].push_back(done.glyph);
+		}
+	}
+
+	/// <summary>
+	/// Lays out (or fetches the cached layout of) a UTF-8 string and emits one quad per resident glyph.
+	/// </summary>
+	/// <param name="font">Font id from AddFont.</param>
+	/// <param name="text">UTF-8 text, '\n' starts a new line.</param>
+	/// <param name="x">Left edge of the text.</param>
+	/// <param name="y">Top of the first line.</param>
+	/// <param name="pixelSize">Size to draw at.</param>
+	/// <param name="emit">Called with each WBGlyphQuad.</param>
+	template<typename Emit>
+	void Draw(FontId font, std::string_view text, float x, float y, float pixelSize, Emit&& emit) {
+		const Run& run = GetRun(font, text);
+		const float scale = pixelSize / config.glyphSize;
+		const float invAtlas = 1.0f / config.atlasSize;
+		const float baseline = y + run.ascent * scale;
+
+		for (const RunGlyph& placed : run.glyphs) {
+			Glyph& glyph = glyphs[placed.glyph];
+			if (glyph.state != GlyphState::Resident) {
+				if (glyph.state == GlyphState::Missing && frame >= glyph.retryFrame)
+					Request(placed.glyph);
+				if (glyph.state != GlyphState::Empty)
+					++stats.glyphMisses;
+				continue;
+			}
+			++stats.glyphHits;
+			atlas.Touch(glyph.shelf, frame);
+
+			WBGlyphQuad quad;
+			quad.x0 = x + (placed.x + glyph.left - config.spread) * scale;
+			quad.y0 = baseline + (placed.y - glyph.top - config.spread) * scale;
+			quad.x1 = quad.x0 + glyph.rect.w * scale;
+			quad.y1 = quad.y0 + glyph.rect.h * scale;
+			quad.u0 = glyph.rect.x * invAtlas;
+			quad.v0 = glyph.rect.y * invAtlas;
+			quad.u1 = (glyph.rect.x + glyph.rect.w) * invAtlas;
+			quad.v1 = (glyph.rect.y + glyph.rect.h) * invAtlas;
+			emit(quad);
+		}
+	}
+
+	/// <summary>
+	/// Measures a UTF-8 string, sharing the run cache with Draw.
+	/// </summary>
+	/// <returns>Width and height in pixels at pixelSize.</returns>
+	std::pair<float, float> Measure(FontId font, std::string_view text, float pixelSize) {
+		const Run& run = GetRun(font, text);
+		const float scale = pixelSize / config.glyphSize;
+		return { run.width * scale, run.height * scale };
+	}
+
+	/// <summary>
+	/// The atlas contents, R8, atlasSize * atlasSize.
+	/// </summary>
+	const uint8_t* GetAtlasPixels() const { return atlasPixels.data(); }
+	int GetAtlasSize() const { return config.atlasSize; }
+
+	/// <summary>
+	/// Rows changed since the last ClearDirty, as [begin, end). Empty when begin == end.
+	/// </summary>
+	std::pair<int, int> GetDirtyRows() const { return { dirtyBegin, dirtyEnd }; }
+	void ClearDirty() { dirtyBegin = dirtyEnd = 0; }
+
+	/// <summary>
+	/// Gets a snapshot of the text counters.
+	/// </summary>
+	WBTextStats GetStats() const {
+		WBTextStats result = stats;
+		std::lock_guard<std::mutex> lock(mutex);
+		result.glyphsGenerated = generated;
+		result.generationSeconds = generationSeconds;
+		return result;
+	}
+
+private:
+	enum class GlyphState : uint8_t { Missing, Pending, Resident, Empty };
+
+	struct Glyph {
+		FontId font = 0;
+		uint32_t codepoint = 0;
+		GlyphState state = GlyphState::Missing;
+		uint64_t lastRequested = 0;
+		uint64_t retryFrame = 0;   // Not requested again before this frame after failing to find room
+		int shelf = -1;
+		WBShelfAtlas::Rect rect;
+		float left = 0.0f;  // Bitmap offset from the pen, in pixels at glyphSize
+		float top = 0.0f;
+	};
+
+	struct RunGlyph {
+		uint32_t glyph; // Index into glyphs, stable for the lifetime of the system
+		float x;        // Pen position in pixels at glyphSize
+		float y;        // Baseline offset of the line
+	};
+
+	struct Run {
+		FontId font = 0;
+		std::string text;
+		std::vector<RunGlyph> glyphs;
+		float width = 0.0f;
+		float height = 0.0f;
+		float ascent = 0.0f;
+		std::list<uint64_t>::iterator lruPosition;
+	};
+
+	struct Job {
+		uint32_t glyph;
+		WBGlyphSource* source;
+		uint32_t codepoint;
+	};
+
+	struct Finished {
+		uint32_t glyph;
+		int width = 0;
+		int height = 0;
+		float left = 0.0f;
+		float top = 0.0f;
+		std::vector<uint8_t> sdf;
+	};
+
+	static uint32_t DecodeUTF8(std::string_view text, size_t& i) {
+		uint8_t c = static_cast<uint8_t>(text[i++]);
+		if (c < 0x80) return c;
+		int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+		uint32_t codepoint = c & (0x3F >> extra);
+		for (int k = 0; k < extra && i < text.size(); ++k)
+			codepoint = codepoint << 6 | (static_cast<uint8_t>(text[i++]) & 0x3F);
+		return extra ? codepoint : 0xFFFD;
+	}
+
+	const Run& GetRun(FontId font, std::string_view text) {
+		uint64_t key = WBHashBytes(text.data(), text.size(), 14695981039346656037ull ^ (uint64_t(font) * 0x9E3779B97F4A7C15ull))
+			>> (64 - WB_TEXT_RUN_KEY_BITS);
+		auto it = runs.find(key);
+		if (it != runs.end() && it->second.font == font && it->second.text == text) {
+			++stats.runHits;
+			runLru.splice(runLru.end(), runLru, it->second.lruPosition);
+			return it->second;
+		}
+		++stats.runMisses;
+
+		if (it == runs.end()) {
+			if (runs.size() >= config.maxRuns) {
+				runs.erase(runLru.front());
+				runLru.pop_front();
+			}
+			it = runs.emplace(key, Run()).first;
+			it->second.lruPosition = runLru.insert(runLru.end(), key);
+		}
+		else {
+			runLru.splice(runLru.end(), runLru, it->second.lruPosition);
+		}
+
+		// Lay out: advances from the source, lines stacked by its line height
+		Run& run = it->second;
+		WBGlyphSource* source = fonts[font].get();
+		run.font = font;
+		run.text.assign(text);
+		run.glyphs.clear();
+		run.ascent = source->Ascent(config.glyphSize);
+		const float lineHeight = source->LineHeight(config.glyphSize);
+		float penX = 0.0f, penY = 0.0f, width = 0.0f;
+		for (size_t i = 0; i < text.size(); ) {
+			uint32_t codepoint = DecodeUTF8(text, i);
+			if (codepoint == '\n') {
+				width = std::max(width, penX);
+				penX = 0.0f;
+				penY += lineHeight;
+				continue;
+			}
+			uint32_t glyph = GetGlyph(font, codepoint);
+			run.glyphs.push_back({ glyph, penX, penY });
+			penX += source->Advance(codepoint, config.glyphSize);
+		}
+		run.width = std::max(width, penX);
+		run.height = penY + lineHeight;
+		return run;
+	}
+
+	uint32_t GetGlyph(FontId font, uint32_t codepoint) {
+		uint64_t key = uint64_t(font) << 32 | codepoint;
+		auto [it, inserted] = glyphIndex.try_emplace(key, static_cast<uint32_t>(glyphs.size()));
+		if (inserted) {
+			Glyph glyph;
+			glyph.font = font;
+			glyph.codepoint = codepoint;
+			glyphs.push_back(glyph);
+			Request(it->second);
+		}
+		return it->second;
+	}
+
+	void Request(uint32_t index) {
+		Glyph& glyph = glyphs[index];
+		// Glyphs that were evicted while still in use go ahead of first-time requests
+		bool evicted = glyph.state == GlyphState::Missing && glyph.lastRequested != 0;
+		glyph.state = GlyphState::Pending;
+		glyph.lastRequested = frame;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (evicted)
+			jobs.push_front({ index, fonts[glyph.font].get(), glyph.codepoint });
+		else
+			jobs.push_back({ index, fonts[glyph.font].get(), glyph.codepoint });
+		jobAvailable.notify_one();
+	}
+
+	void EvictShelf(int shelf) {
+		++stats.evictedShelves;
+		if (shelf >= static_cast<int>(shelfGlyphs.size()))
+			return;
+		for (uint32_t index : shelfGlyphs[shelf]) {
+			Glyph& glyph = glyphs[index];
+			if (glyph.state == GlyphState::Resident && glyph.shelf == shelf) {
+				glyph.state = GlyphState::Missing;
+				glyph.shelf = -1;
+				++stats.evictedGlyphs;
+			}
+		}
+		shelfGlyphs[shelf].clear();
+	}
+
+	void MarkDirty(int begin, int end) {
+		if (dirtyBegin == dirtyEnd) {
+			dirtyBegin = begin;
+			dirtyEnd = end;
+			return;
+		}
+		dirtyBegin = std::min(dirtyBegin, begin);
+		dirtyEnd = std::max(dirtyEnd, end);
+	}
+
+	void WorkerLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			jobAvailable.wait(lock, [&] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+			Job job = jobs.front();
+			jobs.pop_front();
+			lock.unlock();
+
+			auto start = std::chrono::steady_clock::now();
+			Finished done;
+			done.glyph = job.glyph;
+			WBGlyphBitmap bitmap;
+			if (job.source->Rasterize(job.codepoint, config.glyphSize * config.oversample, bitmap)
+				&& bitmap.width > 0 && bitmap.height > 0) {
+				done.sdf = WBGenerateSDF(bitmap, config.oversample, config.spread, done.width, done.height);
+				done.left = bitmap.left / config.oversample;
+				done.top = bitmap.top / config.oversample;
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			lock.lock();
+			generationSeconds += seconds;
+			++generated;
+			finished.push_back(std::move(done));
+		}
+	}
+
+	WBTextConfig config;
+	std::vector<std::unique_ptr<WBGlyphSource>> fonts;
+
+	// Render thread state
+	uint64_t frame = 1;
+	WBShelfAtlas atlas;
+	std::vector<uint8_t> atlasPixels;
+	int dirtyBegin = 0;
+	int dirtyEnd = 0;
+	std::vector<Glyph> glyphs;
+	std::unordered_map<uint64_t, uint32_t> glyphIndex;
+	std::vector<std::vector<uint32_t>> shelfGlyphs;
+	std::unordered_map<uint64_t, Run> runs;
+	std::list<uint64_t> runLru;
+	WBTextStats stats;
+
+	// Shared with the workers
+	mutable std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+	std::deque<Job> jobs;
+	std::deque<Finished> finished;
+	uint64_t generated = 0;
+	double generationSeconds = 0.0;
+};
@@ -0,0 +1,453 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <mutex>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+// Platform independent texture cache. Decoding, reference counting and the memory
+// budget live here; the GPU side is supplied through WBTextureBackend.
+
+/// <summary>
+/// A decoded image, always tightly packed RGBA8.
+/// </summary>
+struct WBImage {
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+
+	size_t Bytes() const { return static_cast<size_t>(width) * height * 4; }
+};
+
+/// <summary>
+/// Decodes an encoded image into RGBA8. Called from worker threads.
+/// </summary>
+using WBImageDecoder = std::function<bool(const std::vector<uint8_t>& data, WBImage& out)>;
+
+/// <summary>
+/// Built-in decoder for uncompressed 24/32-bit BMP files, including 32-bit BI_BITFIELDS with any
+/// channel masks. Windows builds use WIC instead.
+/// </summary>
+/// <param name="data">The encoded file contents.</param>
+/// <param name="out">Receives the decoded image.</param>
+/// <returns>True on success.</returns>
+inline bool WBDecodeBMP(const std::vector<uint8_t>& data, WBImage& out) {
+	auto u16 = [&](size_t at) { return static_cast<uint32_t>(data[at] | data[at + 1] << 8); };
+	auto u32 = [&](size_t at) { return u16(at) | u16(at + 2) << 16; };
+
+	if (data.size() < 54 || data[0] != 'B' || data[1] != 'M')
+		return false;
+
+	uint32_t offset = u32(10);
+	uint32_t headerSize = u32(14);
+	int32_t width = static_cast<int32_t>(u32(18));
+	int32_t height = static_cast<int32_t>(u32(22));
+	uint32_t bpp = u16(28);
+	uint32_t compression = u32(30);
+	const bool bitfields = compression == 3;
+	if (width <= 0 || height == 0 || height == INT32_MIN || (bpp != 24 && bpp != 32) || (compression != 0 && !bitfields)
+		|| (bitfields && bpp != 32))
+		return false;
+
+	// Channel masks follow a 40-byte header, or are part of the larger ones; alpha only in the V4/V5 headers.
+	// BI_RGB stores 32-bit pixels as BGRX, and X is usually 0, so it is never alpha.
+	uint32_t masks[4] = { 0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0 };
+	if (bitfields) {
+		if (data.size() < 66)
+			return false;
+		for (int c = 0; c < 3; ++c)
+			masks[c] = u32(54 + c * 4);
+		masks[3] = headerSize >= 56 && data.size() >= 70 ? u32(66) : 0;
+	}
+	struct Channel { uint32_t mask = 0; int shift = 0; uint32_t max = 0; };
+	Channel channels[4];
+	for (int c = 0; c < 4; ++c) {
+		uint32_t mask = masks[c];
+		if (!mask)
+			continue;
+		int shift = 0;
+		while (!(mask >> shift & 1))
+			++shift;
+		uint32_t bits = mask >> shift;
+		if (bits & (bits + 1))
+			return false; // Not a contiguous run of bits
+		channels[c] = { mask, shift, bits };
+	}
+
+	bool bottomUp = height > 0;
+	height = bottomUp ? height : -height;
+	size_t stride = (static_cast<size_t>(width) * bpp / 8 + 3) & ~size_t(3);
+	if (offset > data.size() || static_cast<size_t>(height) > (data.size() - offset) / stride)
+		return false;
+
+	out.width = width;
+	out.height = height;
+	out.pixels.resize(out.Bytes());
+	for (int y = 0; y < height; ++y) {
+		const uint8_t* src = data.data() + offset + stride * (bottomUp ? height - 1 - y : y);
+		uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * width * 4;
+		for (int x = 0; x < width; ++x, src += bpp / 8, dst += 4) {
+			if (!bitfields) {
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = 255;
+				continue;
+			}
+			uint32_t pixel = src[0] | src[1] << 8 | src[2] << 16 | static_cast<uint32_t>(src[3]) << 24;
+			for (int c = 0; c < 4; ++c) {
+				const Channel& channel = channels[c];
+				dst[c] = channel.mask
+					? static_cast<uint8_t>((static_cast<uint64_t>((pixel & channel.mask) >> channel.shift) * 255 + channel.max / 2) / channel.max)
+					: 255;
+			}
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// 64-bit FNV-1a hash, used for content keys.
+/// </summary>
+inline uint64_t WBHashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/// <summary>
+/// GPU side of the texture cache. Only called from the render thread.
+/// </summary>
+class WBTextureBackend {
+public:
+	virtual ~WBTextureBackend() = default;
+
+	/// <summary>
+	/// Creates a GPU texture from an image.
+	/// </summary>
+	/// <returns>An opaque handle (e.g. a shader resource view), or nullptr on failure.</returns>
+	virtual void* Upload(const WBImage& image) = 0;
+
+	/// <summary>
+	/// Destroys a texture created by Upload.
+	/// </summary>
+	virtual void Release(void* handle) = 0;
+};
+
+/// <summary>
+/// Tuning for WBTextureCache.
+/// </summary>
+struct WBTextureCacheConfig {
+	size_t budgetBytes = 256 * 1024 * 1024; // Resident GPU bytes before unreferenced textures are evicted
+	int uploadsPerFrame = 4;                // Upper bound of uploads done by each Update()
+	int workerThreads = 2;                  // Decode threads
+	uint32_t placeholderColor = 0x00000000; // Packed like WBRGBA (R in the low byte), handed out while a texture is loading
+	int retryFailedMs = 5000;               // Acquire starts a failed load again once it is this old
+};
+
+/// <summary>
+/// Snapshot of the texture cache counters.
+/// </summary>
+struct WBTextureStats {
+	uint64_t hits = 0;       // Acquire calls that found an existing entry
+	uint64_t misses = 0;     // Acquire calls that started a decode
+	uint64_t uploads = 0;    // Textures created on the GPU
+	uint64_t evictions = 0;  // Textures dropped to stay within the budget
+	uint64_t failures = 0;   // Loads that could not be read or decoded
+	size_t residentBytes = 0;
+	size_t residentTextures = 0;
+	size_t pendingUploads = 0;
+};
+
+/// <summary>
+/// Reference counted texture cache keyed by file path or content hash.
+/// Images are decoded on worker threads and uploaded from Update() on the render thread,
+/// at most uploadsPerFrame at a time. Get() returns a placeholder until the upload is done.
+/// Unreferenced textures stay resident until the budget is exceeded, then the least
+/// recently used ones are evicted.
+/// </summary>
+class WBTextureCache {
+public:
+	using Key = uint64_t;
+
+	WBTextureCache(std::unique_ptr<WBTextureBackend> backend, WBTextureCacheConfig config = {},
+		WBImageDecoder decoder = WBDecodeBMP)
+		: backend(std::move(backend)), config(config), decoder(std::move(decoder))
+	{
+		WBImage placeholderImage;
+		placeholderImage.width = placeholderImage.height = 1;
+		placeholderImage.pixels = {
+			static_cast<uint8_t>(config.placeholderColor), static_cast<uint8_t>(config.placeholderColor >> 8),
+			static_cast<uint8_t>(config.placeholderColor >> 16), static_cast<uint8_t>(config.placeholderColor >> 24) };
+		placeholder = this->backend->Upload(placeholderImage);
+
+		for (int i = 0; i < std::max(1, config.workerThreads); ++i)
+			workers.emplace_back(&WBTextureCache::WorkerLoop, this);
+	}
+
+	WBTextureCache(const WBTextureCache&) = delete;
+	WBTextureCache& operator=(const WBTextureCache&) = delete;
+
+	~WBTextureCache() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+
+		for (auto& [key, entry] : entries)
+			if (entry.handle) backend->Release(entry.handle);
+		if (placeholder) backend->Release(placeholder);
+	}
+
+	/// <summary>
+	/// Acquires a reference to the texture stored at a path, starting a load if needed.
+	/// </summary>
+	/// <param name="path">Path of the image file.</param>
+	/// <returns>Key used with Get and Release.</returns>
+	Key Acquire(const std::string& path) {
+		Key key = WBHashBytes(path.data(), path.size(), pathSeed);
+		return AcquireKey(key, [&](Job& job) { job.path = path; });
+	}
+
+	/// <summary>
+	/// Acquires a reference to a texture decoded from memory, keyed by its content hash.
+	/// </summary>
+	/// <param name="data">The encoded image.</param>
+	/// <returns>Key used with Get and Release.</returns>
+	Key Acquire(std::vector<uint8_t> data) {
+		Key key = WBHashBytes(data.data(), data.size());
+		return AcquireKey(key, [&](Job& job) { job.data = std::move(data); });
+	}
+
+	/// <summary>
+	/// Releases a reference. The texture stays cached until the budget needs its memory; a failed
+	/// load is forgotten with its last reference, so the next Acquire tries again.
+	/// </summary>
+	void Release(Key key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(key);
+		if (it == entries.end() || it->second.refs == 0)
+			return;
+		if (--it->second.refs == 0 && it->second.state == State::Failed)
+			entries.erase(it);
+	}
+
+	/// <summary>
+	/// Gets the GPU handle of a texture, or the placeholder while it is loading or after it failed.
+	/// Render thread only.
+	/// </summary>
+	void* Get(Key key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(key);
+		if (it == entries.end() || it->second.state != State::Resident)
+			return placeholder;
+		lru.splice(lru.end(), lru, it->second.lruPosition);
+		return it->second.handle;
+	}
+
+	/// <summary>
+	/// Checks whether a texture has been uploaded.
+	/// </summary>
+	bool IsReady(Key key) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(key);
+		return it != entries.end() && it->second.state == State::Resident;
+	}
+
+	/// <summary>
+	/// Gets the placeholder texture handle.
+	/// </summary>
+	void* GetPlaceholder() const {
+		return placeholder;
+	}
+
+	/// <summary>
+	/// Uploads decoded images and enforces the budget. Call once per frame on the render thread.
+	/// </summary>
+	void Update() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (int i = 0; i < config.uploadsPerFrame && !decoded.empty(); ++i) {
+			Key key = decoded.front().first;
+			WBImage image = std::move(decoded.front().second);
+			decoded.pop_front();
+
+			auto it = entries.find(key);
+			if (it == entries.end() || it->second.state != State::Decoded)
+				continue;
+
+			// Uploading can be slow, don't hold up workers or Acquire in the meantime
+			lock.unlock();
+			void* handle = backend->Upload(image);
+			lock.lock();
+
+			it = entries.find(key);
+			Entry& entry = it->second;
+			if (!handle) {
+				Fail(entry);
+				if (entry.refs == 0)
+					entries.erase(it);
+				continue;
+			}
+			entry.handle = handle;
+			entry.bytes = image.Bytes();
+			entry.state = State::Resident;
+			entry.lruPosition = lru.insert(lru.end(), key);
+			stats.residentBytes += entry.bytes;
+			++stats.uploads;
+		}
+
+		for (auto it = lru.begin(); it != lru.end() && stats.residentBytes > config.budgetBytes; ) {
+			auto entryIt = entries.find(*it);
+			if (entryIt->second.refs > 0) {
+				++it;
+				continue;
+			}
+			backend->Release(entryIt->second.handle);
+			stats.residentBytes -= entryIt->second.bytes;
+			++stats.evictions;
+			entries.erase(entryIt);
+			it = lru.erase(it);
+		}
+	}
+
+	/// <summary>
+	/// Gets a snapshot of the cache counters.
+	/// </summary>
+	WBTextureStats GetStats() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		WBTextureStats result = stats;
+		result.residentTextures = lru.size();
+		result.pendingUploads = decoded.size();
+		return result;
+	}
+
+	/// <summary>
+	/// Like GetStats, but gives up instead of waiting while a worker holds the lock.
+	/// </summary>
+	/// <returns>False if the counters could not be read without blocking.</returns>
+	bool TryGetStats(WBTextureStats& result) const {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+			return false;
+		result = stats;
+		result.residentTextures = lru.size();
+		result.pendingUploads = decoded.size();
+		return true;
+	}
+
+private:
+	static constexpr uint64_t pathSeed = 0x9E3779B97F4A7C15ull;
+
+	enum class State { Decoding, Decoded, Resident, Failed };
+
+	struct Entry {
+		State state = State::Decoding;
+		int refs = 0;
+		void* handle = nullptr;
+		size_t bytes = 0;
+		std::list<Key>::iterator lruPosition;
+		std::chrono::steady_clock::time_point failedAt;
+	};
+
+	struct Job {
+		Key key = 0;
+		std::string path;
+		std::vector<uint8_t> data;
+	};
+
+	template<typename Fill>
+	Key AcquireKey(Key key, Fill&& fill) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto [it, inserted] = entries.try_emplace(key);
+		Entry& entry = it->second;
+		++entry.refs;
+		bool retry = entry.state == State::Failed
+			&& std::chrono::steady_clock::now() - entry.failedAt >= std::chrono::milliseconds(config.retryFailedMs);
+		if (!inserted && !retry) {
+			++stats.hits;
+			return key;
+		}
+
+		++stats.misses;
+		entry.state = State::Decoding;
+		Job job;
+		job.key = key;
+		fill(job);
+		jobs.push_back(std::move(job));
+		jobAvailable.notify_one();
+		return key;
+	}
+
+	void Fail(Entry& entry) {
+		entry.state = State::Failed;
+		entry.failedAt = std::chrono::steady_clock::now();
+		++stats.failures;
+	}
+
+	void WorkerLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			jobAvailable.wait(lock, [&] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+
+			Job job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+
+			if (!job.path.empty()) {
+				std::ifstream file(job.path, std::ios::binary);
+				job.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			WBImage image;
+			bool ok = !job.data.empty() && decoder(job.data, image) && image.pixels.size() == image.Bytes();
+
+			lock.lock();
+			auto it = entries.find(job.key);
+			if (it == entries.end())
+				continue;
+			if (!ok) {
+				Fail(it->second);
+				if (it->second.refs == 0)
+					entries.erase(it); // Nobody is waiting for it any more
+				continue;
+			}
+			it->second.state = State::Decoded;
+			decoded.emplace_back(job.key, std::move(image));
+		}
+	}
+
+	std::unique_ptr<WBTextureBackend> backend;
+	WBTextureCacheConfig config;
+	WBImageDecoder decoder;
+	void* placeholder = nullptr;
+
+	mutable std::mutex mutex; // Guards everything below
+	std::condition_variable jobAvailable;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+	std::unordered_map<Key, Entry> entries;
+	std::deque<Job> jobs;
+	std::deque<std::pair<Key, WBImage>> decoded;
+	std::list<Key> lru; // Resident textures, least recently used first
+	WBTextureStats stats;
+};
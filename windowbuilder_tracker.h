@@ -0,0 +1,261 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// This header is platform independent so the scheduling logic can be exercised
+// without a window system. windowbuilder.h supplies the Win32 poll callbacks.
+
+/// <summary>
+/// Result of polling a tracked target once.
+/// </summary>
+enum class WBTrackResult {
+	Unchanged, // Target is where it was last time
+	Moved,     // Target moved or resized since the last poll
+	Gone       // Target no longer exists, the tracker drops the registration
+};
+
+/// <summary>
+/// Snapshot of the tracker counters.
+/// </summary>
+struct WBTrackerStats {
+	uint64_t wakeups = 0; // Times the tracker thread woke up
+	uint64_t polls = 0;   // Poll callbacks invoked
+	uint64_t moves = 0;   // Polls that reported a move
+	size_t targets = 0;   // Currently registered targets
+};
+
+/// <summary>
+/// Process-wide tracker that multiplexes every overlay target onto a single thread.
+/// Targets live in a hashed timer wheel and are polled when their deadline expires.
+/// The poll interval of a target snaps back to its base interval whenever it moves
+/// and backs off geometrically while it stays put, so idle targets cost almost nothing.
+/// The thread is started by the first registration and joined when the last one leaves.
+/// </summary>
+class WBTracker {
+public:
+	using Handle = uint64_t;
+	using PollFn = std::function<WBTrackResult()>;
+
+	static constexpr int tickMs = 4;              // Wheel resolution
+	static constexpr size_t wheelSlots = 64;      // 64 * 4 ms = 256 ms per revolution
+	static constexpr int defaultIntervalMs = 16;  // Matches the old per-window thread
+	static constexpr int maxIntervalMs = 250;     // Back-off ceiling for idle targets
+
+	WBTracker() = default;
+	WBTracker(const WBTracker&) = delete;
+	WBTracker& operator=(const WBTracker&) = delete;
+
+	~WBTracker() {
+		std::unique_lock<std::mutex> lifecycle(lifecycleMutex);
+		StopWorker(lifecycle);
+	}
+
+	/// <summary>
+	/// Gets the process-wide tracker instance.
+	/// </summary>
+	static WBTracker& Instance() {
+		static WBTracker tracker;
+		return tracker;
+	}
+
+	/// <summary>
+	/// Registers a target. The callback runs on the tracker thread and must not call Unregister;
+	/// return WBTrackResult::Gone instead to drop the registration. Every target shares that thread,
+	/// so a slow callback delays the polls of all the others: hand real work to the owning window.
+	/// </summary>
+	/// <param name="poll">Callback that checks the target once.</param>
+	/// <param name="intervalMs">Poll interval used while the target is moving.</param>
+	/// <returns>Handle used to unregister the target.</returns>
+	Handle Register(PollFn poll, int intervalMs = defaultIntervalMs) {
+		std::lock_guard<std::mutex> lifecycle(lifecycleMutex);
+		Handle handle = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			handle = ++lastHandle;
+
+			Entry& entry = entries[handle];
+			entry.poll = std::move(poll);
+			entry.baseTicks = std::max(1, (std::clamp(intervalMs, tickMs, maxIntervalMs) + tickMs - 1) / tickMs);
+			entry.intervalTicks = entry.baseTicks;
+			Schedule(handle, entry, CurrentTick());
+		}
+
+		if (!worker.joinable()) {
+			stopping = false;
+			worker = std::thread(&WBTracker::Run, this);
+		}
+		else {
+			wake.notify_one();
+		}
+		return handle;
+	}
+
+	/// <summary>
+	/// Unregisters a target. Once this returns the poll callback will not run again.
+	/// Stops the tracker thread when the last target leaves.
+	/// </summary>
+	/// <param name="handle">Handle returned by Register.</param>
+	void Unregister(Handle handle) {
+		std::unique_lock<std::mutex> lifecycle(lifecycleMutex);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [&] { return polling != handle; });
+			entries.erase(handle);
+			if (!entries.empty())
+				return;
+		}
+		StopWorker(lifecycle);
+	}
+
+	/// <summary>
+	/// Gets a snapshot of the tracker counters.
+	/// </summary>
+	WBTrackerStats GetStats() const {
+		WBTrackerStats stats;
+		stats.wakeups = wakeups.load(std::memory_order_relaxed);
+		stats.polls = polls.load(std::memory_order_relaxed);
+		stats.moves = moves.load(std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.targets = entries.size();
+		return stats;
+	}
+
+private:
+	struct Entry {
+		PollFn poll;
+		uint64_t deadlineTick = 0;
+		int baseTicks = 1;
+		int intervalTicks = 1;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	uint64_t CurrentTick() const {
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - epoch);
+		return static_cast<uint64_t>(elapsed.count()) / tickMs;
+	}
+
+	void Schedule(Handle handle, Entry& entry, uint64_t now) {
+		entry.deadlineTick = now + entry.intervalTicks;
+		wheel[entry.deadlineTick % wheelSlots].push_back(handle);
+	}
+
+	// Intervals never exceed one revolution, so the first slot holding a live entry
+	// whose deadline matches that slot is the next one due.
+	uint64_t NextDeadline() const {
+		for (uint64_t tick = processedTick + 1; tick <= processedTick + wheelSlots; ++tick) {
+			for (Handle handle : wheel[tick % wheelSlots]) {
+				auto it = entries.find(handle);
+				if (it != entries.end() && it->second.deadlineTick == tick)
+					return tick;
+			}
+		}
+		return processedTick + wheelSlots;
+	}
+
+	void Run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		processedTick = CurrentTick();
+
+		while (!stopping) {
+			uint64_t next = NextDeadline();
+			wake.wait_until(lock, epoch + std::chrono::milliseconds(next * tickMs));
+			if (stopping)
+				break;
+			wakeups.fetch_add(1, std::memory_order_relaxed);
+
+			uint64_t now = CurrentTick();
+			for (; processedTick < now && !stopping; ) {
+				uint64_t tick = ++processedTick;
+				std::vector<Handle>& slot = wheel[tick % wheelSlots];
+
+				due.clear();
+				size_t kept = 0;
+				for (Handle handle : slot) {
+					auto it = entries.find(handle);
+					if (it == entries.end())
+						continue; // Unregistered
+					if (it->second.deadlineTick == tick)
+						due.push_back(handle);
+					else if (it->second.deadlineTick > tick)
+						slot[kept++] = handle;
+				}
+				slot.resize(kept);
+
+				for (Handle handle : due)
+					PollOne(lock, handle, now);
+			}
+		}
+	}
+
+	void PollOne(std::unique_lock<std::mutex>& lock, Handle handle, uint64_t now) {
+		auto it = entries.find(handle);
+		if (it == entries.end())
+			return;
+
+		// References into unordered_map survive rehashing, and Unregister waits for
+		// 'polling' to clear before erasing, so the entry stays valid while unlocked.
+		Entry& entry = it->second;
+		polling = handle;
+		lock.unlock();
+		WBTrackResult result = entry.poll();
+		lock.lock();
+		polling = 0;
+		idle.notify_all();
+		polls.fetch_add(1, std::memory_order_relaxed);
+
+		switch (result) {
+		case WBTrackResult::Gone:
+			entries.erase(handle);
+			return;
+		case WBTrackResult::Moved:
+			moves.fetch_add(1, std::memory_order_relaxed);
+			entry.intervalTicks = entry.baseTicks;
+			break;
+		case WBTrackResult::Unchanged:
+			entry.intervalTicks = std::min(entry.intervalTicks + std::max(1, entry.intervalTicks / 2),
+				maxIntervalMs / tickMs);
+			break;
+		}
+		Schedule(handle, entry, now);
+	}
+
+	void StopWorker(std::unique_lock<std::mutex>&) {
+		if (!worker.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	std::mutex lifecycleMutex; // Serializes thread start/stop
+	mutable std::mutex mutex;  // Guards everything below
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::thread worker;
+	bool stopping = false;
+
+	std::unordered_map<Handle, Entry> entries;
+	std::vector<Handle> wheel[wheelSlots];
+	std::vector<Handle> due;
+	uint64_t processedTick = 0;
+	Handle lastHandle = 0;
+	Handle polling = 0;
+	const Clock::time_point epoch = Clock::now();
+
+	std::atomic<uint64_t> wakeups = 0;
+	std::atomic<uint64_t> polls = 0;
+	std::atomic<uint64_t> moves = 0;
+};